@@ -20,8 +20,24 @@ LOCAL_CFLAGS += \
 LOCAL_STATIC_LIBRARIES += libgpuperfcnt
 
 LOCAL_SRC_FILES := \
+  gputop/buffer.c \
   gputop/debugfs.c \
-  gputop/top.c
+  gputop/flight.c \
+  gputop/fmt.c \
+  gputop/history.c \
+  gputop/layout.c \
+  gputop/loop.c \
+  gputop/output.c \
+  gputop/procs.c \
+  gputop/report.c \
+  gputop/screen.c \
+  gputop/serve.c \
+  gputop/shm.c \
+  gputop/stats.c \
+  gputop/subscribe.c \
+  gputop/top.c \
+  gputop/trace.c \
+  gputop/trace_event.c
 
 LOCAL_VENDOR_MODULE  := true
 LOCAL_MODULE_TAGS    := optional
@@ -0,0 +1,168 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "buffer.h"
+
+int
+buf_init(struct gtop_buf *buf, size_t size)
+{
+	memset(buf, 0, sizeof(*buf));
+
+	buf->data = malloc(size);
+	if (!buf->data)
+		return -1;
+
+	buf->size = size;
+	return 0;
+}
+
+void
+buf_free(struct gtop_buf *buf)
+{
+	free(buf->data);
+	memset(buf, 0, sizeof(*buf));
+}
+
+void
+buf_reset(struct gtop_buf *buf)
+{
+	buf->len = 0;
+	buf->truncated = false;
+}
+
+char *
+buf_reserve(struct gtop_buf *buf, size_t len)
+{
+	if (buf->len + len > buf->size) {
+		size_t size = buf->size ? buf->size : 4096;
+		char *data;
+
+		while (size < buf->len + len)
+			size *= 2;
+
+		data = realloc(buf->data, size);
+		if (!data) {
+			buf->truncated = true;
+			return NULL;
+		}
+
+		buf->data = data;
+		buf->size = size;
+	}
+
+	return buf->data + buf->len;
+}
+
+void
+buf_commit(struct gtop_buf *buf, size_t len)
+{
+	buf->len += len;
+}
+
+void
+buf_append(struct gtop_buf *buf, const char *data, size_t len)
+{
+	char *dst = buf_reserve(buf, len);
+
+	if (!dst)
+		return;
+
+	memcpy(dst, data, len);
+	buf->len += len;
+}
+
+void
+buf_puts(struct gtop_buf *buf, const char *str)
+{
+	buf_append(buf, str, strlen(str));
+}
+
+void
+buf_putc(struct gtop_buf *buf, char c)
+{
+	buf_append(buf, &c, 1);
+}
+
+void
+buf_vprintf(struct gtop_buf *buf, const char *fmt, va_list ap)
+{
+	size_t avail = buf->size - buf->len;
+	va_list again;
+	int len;
+
+	va_copy(again, ap);
+	len = vsnprintf(buf->data + buf->len, avail, fmt, ap);
+
+	/* didn't fit, grow and try again */
+	if (len >= 0 && (size_t) len >= avail) {
+		if (buf_reserve(buf, len + 1))
+			len = vsnprintf(buf->data + buf->len, len + 1, fmt, again);
+		else
+			len = -1;
+	}
+	va_end(again);
+
+	if (len < 0)
+		return;
+
+	buf->len += len;
+}
+
+void
+buf_printf(struct gtop_buf *buf, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	buf_vprintf(buf, fmt, ap);
+	va_end(ap);
+}
+
+ssize_t
+buf_write(struct gtop_buf *buf, int fd)
+{
+	size_t written = 0;
+
+	/* only partial writes or signals would make us loop */
+	while (written < buf->len) {
+		ssize_t nr = write(fd, buf->data + written, buf->len - written);
+
+		if (nr < 0) {
+			if (errno == EINTR)
+				continue;
+			buf_reset(buf);
+			return -1;
+		}
+
+		written += nr;
+	}
+
+	buf_reset(buf);
+	return written;
+}
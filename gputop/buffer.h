@@ -0,0 +1,105 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_BUFFER_H
+#define __GPUTOP_BUFFER_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * gtop_buf:
+ *
+ * Growable output buffer. Allocate it once with enough room for a whole
+ * window, fill it and then hand it over with a single write().
+ */
+struct gtop_buf {
+	char *data;
+	size_t len;
+	size_t size;
+
+	/* set if we failed to grow the buffer and lost data */
+	bool truncated;
+};
+
+/**
+ * buf_init:
+ *
+ * Allocate size bytes upfront. Returns -1 if we couldn't allocate.
+ */
+int
+buf_init(struct gtop_buf *buf, size_t size);
+
+void
+buf_free(struct gtop_buf *buf);
+
+/**
+ * buf_reset:
+ *
+ * Discard the contents, keeps the allocation.
+ */
+void
+buf_reset(struct gtop_buf *buf);
+
+/**
+ * buf_reserve:
+ *
+ * Make sure there's room for another len bytes. Returns a pointer to where
+ * they should be written, or NULL. Callers need to use buf_commit() to
+ * account for what they have written.
+ */
+char *
+buf_reserve(struct gtop_buf *buf, size_t len);
+
+void
+buf_commit(struct gtop_buf *buf, size_t len);
+
+void
+buf_append(struct gtop_buf *buf, const char *data, size_t len);
+
+void
+buf_puts(struct gtop_buf *buf, const char *str);
+
+void
+buf_putc(struct gtop_buf *buf, char c);
+
+void
+buf_printf(struct gtop_buf *buf, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+void
+buf_vprintf(struct gtop_buf *buf, const char *fmt, va_list ap)
+	__attribute__((format(printf, 2, 0)));
+
+/**
+ * buf_write:
+ *
+ * Write out the contents to fd, then reset the buffer. Returns -1 if write
+ * failed.
+ */
+ssize_t
+buf_write(struct gtop_buf *buf, int fd);
+
+#endif
@@ -226,6 +226,226 @@ debugfs_get_current_ctx(struct debugfs_client *client, const char *path)
 	return 0;
 }
 
+/*
+ * FNV-1a, debugfs files have neither a size nor a modification time telling
+ * us they changed
+ */
+static uint64_t
+debugfs_hash(const char *buf, size_t len)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) buf[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static struct debugfs_ctx_entry *
+debugfs_ctx_index_slot(const struct debugfs_ctx_index *idx, uint32_t ctx)
+{
+	size_t mask = idx->size - 1;
+	size_t i = (ctx * 0x9e3779b1U) & mask;
+
+	while (idx->entries[i].ctx && idx->entries[i].ctx != ctx)
+		i = (i + 1) & mask;
+
+	return &idx->entries[i];
+}
+
+static void
+debugfs_ctx_index_clear(struct debugfs_ctx_index *idx)
+{
+	for (size_t i = 0; i < idx->size; i++)
+		free(idx->entries[i].name);
+
+	memset(idx->entries, 0, idx->size * sizeof(*idx->entries));
+	idx->nr = 0;
+}
+
+static int
+debugfs_ctx_index_add(struct debugfs_ctx_index *idx, uint32_t ctx,
+		      uint32_t pid, const char *name)
+{
+	struct debugfs_ctx_entry *entry;
+
+	/* keep it at most half full */
+	if ((idx->nr + 1) * 2 > idx->size) {
+		struct debugfs_ctx_index old = *idx;
+		size_t size = idx->size ? idx->size * 2 : 64;
+
+		idx->entries = calloc(size, sizeof(*idx->entries));
+		if (!idx->entries) {
+			*idx = old;
+			return -1;
+		}
+
+		idx->size = size;
+		idx->nr = 0;
+
+		for (size_t i = 0; i < old.size; i++) {
+			if (!old.entries[i].ctx)
+				continue;
+
+			*debugfs_ctx_index_slot(idx, old.entries[i].ctx) = old.entries[i];
+			idx->nr++;
+		}
+
+		free(old.entries);
+	}
+
+	entry = debugfs_ctx_index_slot(idx, ctx);
+	if (entry->ctx) {
+		/* seen twice, the last one wins like with the other readers */
+		free(entry->name);
+	} else {
+		idx->nr++;
+	}
+
+	entry->ctx = ctx;
+	entry->pid = pid;
+	entry->name = strdup(name);
+
+	return entry->name ? 0 : -1;
+}
+
+/*
+ * reads file in idx->buf, which is always NUL terminated afterwards
+ */
+static size_t
+debugfs_read_all(struct debugfs_ctx_index *idx, FILE *file)
+{
+	size_t len = 0;
+
+	for (;;) {
+		/* room left for the NUL */
+		if (len + 1 >= idx->buf_size) {
+			size_t size = idx->buf_size ? idx->buf_size * 2 : 4096;
+			char *buf = realloc(idx->buf, size);
+
+			if (!buf)
+				break;
+
+			idx->buf = buf;
+			idx->buf_size = size;
+		}
+
+		size_t nr = fread(idx->buf + len, 1, idx->buf_size - len - 1, file);
+		if (!nr)
+			break;
+
+		len += nr;
+	}
+
+	if (idx->buf)
+		idx->buf[len] = '\0';
+
+	return len;
+}
+
+int
+debugfs_ctx_index_update(struct debugfs_ctx_index *idx, const char *path)
+{
+	FILE *file;
+	size_t len;
+	uint64_t hash;
+	uint32_t pid = 0;
+	char name[512];
+	char *line, *end;
+
+	if (!path) {
+		file = debugfs_fopen("database", "r");
+	} else {
+		file = fopen(path, "r");
+	}
+
+	if (!file)
+		return -1;
+
+	len = debugfs_read_all(idx, file);
+	fclose(file);
+
+	hash = debugfs_hash(idx->buf, len);
+	if (idx->generation && hash == idx->hash)
+		return 0;
+
+	if (idx->size)
+		debugfs_ctx_index_clear(idx);
+
+	memset(name, 0, sizeof(name));
+
+	for (line = idx->buf; line < idx->buf + len; line = end + 1) {
+		end = memchr(line, '\n', idx->buf + len - line);
+		if (!end)
+			end = idx->buf + len;
+
+		/* the sscanf() below stop at the end of the line */
+		*end = '\0';
+
+		if (strncmp(line, "Process:", 8) == 0) {
+			if (sscanf(line, "Process: %u   %511[a-zA-Z0-9-]", &pid, name) != 2)
+				pid = 0;
+			continue;
+		}
+
+		/* contexts before any process, or of one we couldn't read */
+		if (!pid)
+			continue;
+
+		if (!strncmp(line, "Context", 7)) {
+			char *str = line + 7;
+			uint32_t no = 0;
+
+			/* same layout as debugfs_get_contexts() expects */
+			while (*str == ' ' || *str == '\t')
+				str++;
+
+			if (*str == '0' || *str == '1')
+				str++;
+
+			while (*str == ' ' || *str == '\t')
+				str++;
+
+			sscanf(str, "%x", &no);
+
+			if (no && debugfs_ctx_index_add(idx, no, pid, name) < 0)
+				break;
+		}
+	}
+
+	idx->hash = hash;
+	/* never 0, that one means never built */
+	if (++idx->generation == 0)
+		idx->generation = 1;
+
+	return 1;
+}
+
+const struct debugfs_ctx_entry *
+debugfs_ctx_index_find(const struct debugfs_ctx_index *idx, uint32_t ctx)
+{
+	const struct debugfs_ctx_entry *entry;
+
+	if (!ctx || !idx->size)
+		return NULL;
+
+	entry = debugfs_ctx_index_slot(idx, ctx);
+	return entry->ctx ? entry : NULL;
+}
+
+void
+debugfs_ctx_index_free(struct debugfs_ctx_index *idx)
+{
+	if (idx->size)
+		debugfs_ctx_index_clear(idx);
+
+	free(idx->entries);
+	free(idx->buf);
+	memset(idx, 0, sizeof(*idx));
+}
+
 int
 debugfs_get_vid_mem(struct debugfs_vid_mem_client *client, pid_t pid)
 {
@@ -86,6 +86,43 @@ struct debugfs_govern {
 	uint32_t shader_core_freq;
 };
 
+/**
+ * debugfs_ctx_index:
+ *
+ * Maps a context to the process owning it, as found in the database. Kept
+ * across calls of debugfs_ctx_index_update(), which parses the database again
+ * only when its contents changed since.
+ */
+struct debugfs_ctx_entry {
+	uint32_t ctx;
+	uint32_t pid;
+	char *name;
+};
+
+struct debugfs_ctx_index {
+	/** open addressed, size is a power of two, ctx 0 marks a free slot */
+	struct debugfs_ctx_entry *entries;
+	size_t size;
+	size_t nr;
+
+	/** bumped each time the index is built again */
+	uint32_t generation;
+
+	/** hash of the database the index was built from */
+	uint64_t hash;
+
+	/** raw database, kept to not allocate on each update */
+	char *buf;
+	size_t buf_size;
+};
+
+/**
+ * \brief: helper macro for iterating over the contexts of an index
+ */
+#define ctx_index_for_each(entry, idx)						\
+	for (entry = (idx)->entries; entry < (idx)->entries + (idx)->size; entry++)	\
+		if (entry->ctx)
+
 /**
  * \brief: helper macro for iterating over clients list
  */
@@ -129,6 +166,26 @@ debugfs_get_contexts(struct debugfs_client *clients, const char *path);
 void
 debugfs_print_contexts(struct debugfs_client *clients);
 
+/**
+ * debugfs_ctx_index_update:
+ *
+ * Reads the database and builds the index again if it changed. Returns 1 if
+ * it was built again, 0 if unchanged and -1 if the database can't be read.
+ */
+int
+debugfs_ctx_index_update(struct debugfs_ctx_index *idx, const char *path);
+
+/**
+ * debugfs_ctx_index_find:
+ *
+ * Looks up the process owning ctx, NULL if none does.
+ */
+const struct debugfs_ctx_entry *
+debugfs_ctx_index_find(const struct debugfs_ctx_index *idx, uint32_t ctx);
+
+void
+debugfs_ctx_index_free(struct debugfs_ctx_index *idx);
+
 int
 debugfs_get_vid_mem(struct debugfs_vid_mem_client *client, pid_t pid);
 
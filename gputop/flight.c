@@ -0,0 +1,392 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "flight.h"
+
+/*
+ * where row n of the ring is, n = 0 being the oldest one
+ */
+static uint64_t *
+flight_row(const struct flight *f, uint32_t n)
+{
+	uint32_t slot = (f->head + f->nr_rows - f->count + n) % f->nr_rows;
+
+	return f->ring + (size_t) slot * f->nr_columns;
+}
+
+static int
+flight_write(struct flight *f, unsigned int no)
+{
+	struct trace_writer w;
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	int err = 0;
+
+	snprintf(path, sizeof(path), "%s.%u", f->path, no);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	if (trace_writer_open(&w, tmp, &f->chip, f->columns, f->nr_columns) < 0)
+		return -1;
+
+	/* relative times count from the oldest window we have */
+	if (f->nr_dump)
+		err = trace_writer_set_start(&w, f->dump[TRACE_COL_TIMESTAMP]);
+
+	for (uint32_t r = 0; r < f->nr_dump && !err; r++)
+		err = trace_writer_append(&w, f->dump + (size_t) r * f->nr_columns);
+
+	if (trace_writer_close(&w) < 0)
+		err = -1;
+
+	/* readers only ever see complete dumps */
+	if (!err)
+		err = rename(tmp, path);
+	else
+		unlink(tmp);
+
+	return err;
+}
+
+static void *
+flight_writer(void *data)
+{
+	struct flight *f = data;
+
+	pthread_mutex_lock(&f->lock);
+
+	while (true) {
+		unsigned int no;
+
+		while (!f->pending && !f->stop)
+			pthread_cond_wait(&f->cond, &f->lock);
+
+		if (!f->pending)
+			break;
+
+		no = f->dump_no;
+		pthread_mutex_unlock(&f->lock);
+
+		if (flight_write(f, no) < 0)
+			fprintf(stderr, "Failed to write %s.%u: %s\n", f->path, no,
+				strerror(errno));
+
+		pthread_mutex_lock(&f->lock);
+		f->pending = false;
+	}
+
+	pthread_mutex_unlock(&f->lock);
+	return NULL;
+}
+
+int
+flight_open(struct flight *f, const char *path, uint64_t length_ns,
+	    uint64_t period_ns, const struct trace_chip *chip,
+	    const struct trace_column *columns, uint32_t nr_columns)
+{
+	size_t size;
+
+	memset(f, 0, sizeof(*f));
+
+	f->chip = *chip;
+	f->nr_columns = nr_columns;
+	f->length_ns = length_ns;
+	/* windows never come faster than period_ns */
+	f->nr_rows = length_ns / (period_ns ? period_ns : 1) + 1;
+	size = (size_t) f->nr_rows * nr_columns * sizeof(uint64_t);
+
+	f->columns = malloc(nr_columns * sizeof(*columns));
+	f->path = strdup(path);
+	f->ring = malloc(size);
+	f->dump = malloc(size);
+	if (!f->columns || !f->path || !f->ring || !f->dump) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	memcpy(f->columns, columns, nr_columns * sizeof(*columns));
+
+	/* touch it now rather than in the sampling loop */
+	memset(f->ring, 0, size);
+	memset(f->dump, 0, size);
+
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->cond, NULL);
+
+	if (pthread_create(&f->thread, NULL, flight_writer, f)) {
+		pthread_cond_destroy(&f->cond);
+		pthread_mutex_destroy(&f->lock);
+		errno = EAGAIN;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	free(f->columns);
+	free(f->path);
+	free(f->ring);
+	free(f->dump);
+	memset(f, 0, sizeof(*f));
+	return -1;
+}
+
+/*
+ * <group>.<name>, dma columns being dma.<table>.<state>
+ */
+static int
+flight_find_column(const struct flight *f, const char *name, size_t len)
+{
+	for (uint32_t c = 0; c < f->nr_columns; c++) {
+		const struct trace_column *col = &f->columns[c];
+		char full[TRACE_NAME_LEN + TRACE_DESC_LEN + 16];
+
+		if (col->group == TRACE_GROUP_DMA)
+			snprintf(full, sizeof(full), "dma.%s.%s", col->desc, col->name);
+		else
+			snprintf(full, sizeof(full), "%s.%s",
+				 trace_group_name(col->group), col->name);
+
+		if (strlen(full) == len && !strncmp(full, name, len))
+			return c;
+	}
+
+	return -1;
+}
+
+int
+flight_trigger_add(struct flight *f, const char *expr)
+{
+	struct flight_trigger *t;
+	const char *p = expr, *name;
+	char *end;
+	size_t len;
+	int c;
+
+	if (f->nr_triggers == FLIGHT_MAX_TRIGGERS)
+		return -1;
+	t = &f->triggers[f->nr_triggers];
+	memset(t, 0, sizeof(*t));
+
+	while (isspace((unsigned char) *p))
+		p++;
+	name = p;
+	while (*p && !isspace((unsigned char) *p) && *p != '<' && *p != '>')
+		p++;
+	len = p - name;
+
+	if ((c = flight_find_column(f, name, len)) < 0)
+		return -1;
+	t->column = c;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (*p == '>')
+		t->op = (p[1] == '=') ? FLIGHT_OP_GE : FLIGHT_OP_GT;
+	else if (*p == '<')
+		t->op = (p[1] == '=') ? FLIGHT_OP_LE : FLIGHT_OP_LT;
+	else
+		return -1;
+	p += (p[1] == '=') ? 2 : 1;
+
+	errno = 0;
+	t->value = strtod(p, &end);
+	if (errno || end == p)
+		return -1;
+	p = end;
+
+	if (*p == '%') {
+		uint32_t group = f->columns[c].group;
+
+		if (group != TRACE_GROUP_OCCUPANCY && group != TRACE_GROUP_DMA)
+			return -1;
+		t->percent = true;
+		p++;
+	} else if (!strncmp(p, "MB", 2)) {
+		if (f->columns[c].group != TRACE_GROUP_MEMORY)
+			return -1;
+		t->value *= 1024;
+		p += 2;
+	}
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (!strncmp(p, "for", 3) && isspace((unsigned char) p[3])) {
+		double secs;
+
+		p += 3;
+		errno = 0;
+		secs = strtod(p, &end);
+		if (errno || end == p || secs < 0)
+			return -1;
+		p = end;
+
+		if (!strncmp(p, "ms", 2)) {
+			secs /= 1000;
+			p += 2;
+		} else if (*p == 's') {
+			p++;
+		}
+		t->for_ns = secs * 1000000000.0;
+
+		while (isspace((unsigned char) *p))
+			p++;
+	}
+
+	if (*p)
+		return -1;
+
+	t->expr = strdup(expr);
+	if (!t->expr)
+		return -1;
+
+	f->nr_triggers++;
+	return 0;
+}
+
+static bool
+flight_trigger_holds(const struct flight_trigger *t, const uint64_t *row)
+{
+	double value = row[t->column];
+
+	if (t->percent)
+		value = row[TRACE_COL_SAMPLES] ?
+			100.0 * value / row[TRACE_COL_SAMPLES] : 0;
+
+	switch (t->op) {
+	case FLIGHT_OP_GT:
+		return value > t->value;
+	case FLIGHT_OP_GE:
+		return value >= t->value;
+	case FLIGHT_OP_LT:
+		return value < t->value;
+	case FLIGHT_OP_LE:
+		return value <= t->value;
+	}
+
+	return false;
+}
+
+const struct flight_trigger *
+flight_push(struct flight *f, const uint64_t *row)
+{
+	const struct flight_trigger *fired = NULL;
+	uint64_t ts = row[TRACE_COL_TIMESTAMP];
+
+	memcpy(f->ring + (size_t) f->head * f->nr_columns, row,
+	       f->nr_columns * sizeof(uint64_t));
+	f->head = (f->head + 1) % f->nr_rows;
+	if (f->count < f->nr_rows)
+		f->count++;
+
+	for (size_t i = 0; i < f->nr_triggers; i++) {
+		struct flight_trigger *t = &f->triggers[i];
+
+		if (!flight_trigger_holds(t, row)) {
+			t->since_ns = 0;
+			t->fired = false;
+			continue;
+		}
+
+		/* the window ends at ts, it started holding before that */
+		if (!t->since_ns)
+			t->since_ns = ts - row[TRACE_COL_WINDOW];
+
+		if (!t->fired && ts - t->since_ns >= t->for_ns) {
+			t->fired = true;
+			if (!fired)
+				fired = t;
+		}
+	}
+
+	return fired;
+}
+
+int
+flight_dump(struct flight *f)
+{
+	uint64_t from;
+	uint32_t first = 0;
+	int no;
+
+	pthread_mutex_lock(&f->lock);
+
+	if (f->pending) {
+		pthread_mutex_unlock(&f->lock);
+		errno = EBUSY;
+		return -1;
+	}
+
+	/* only the last length_ns, the ring being sized for the worst case */
+	if (f->count) {
+		uint64_t last = flight_row(f, f->count - 1)[TRACE_COL_TIMESTAMP];
+
+		from = (last > f->length_ns) ? last - f->length_ns : 0;
+		while (first < f->count &&
+		       flight_row(f, first)[TRACE_COL_TIMESTAMP] < from)
+			first++;
+	}
+
+	f->nr_dump = f->count - first;
+	for (uint32_t r = 0; r < f->nr_dump; r++)
+		memcpy(f->dump + (size_t) r * f->nr_columns, flight_row(f, first + r),
+		       f->nr_columns * sizeof(uint64_t));
+
+	no = f->dump_no = f->nr_dumps++;
+	f->pending = true;
+	pthread_cond_signal(&f->cond);
+
+	pthread_mutex_unlock(&f->lock);
+	return no;
+}
+
+void
+flight_close(struct flight *f)
+{
+	if (!f->ring)
+		return;
+
+	pthread_mutex_lock(&f->lock);
+	f->stop = true;
+	pthread_cond_signal(&f->cond);
+	pthread_mutex_unlock(&f->lock);
+
+	pthread_join(f->thread, NULL);
+	pthread_cond_destroy(&f->cond);
+	pthread_mutex_destroy(&f->lock);
+
+	for (size_t i = 0; i < f->nr_triggers; i++)
+		free(f->triggers[i].expr);
+
+	free(f->columns);
+	free(f->path);
+	free(f->ring);
+	free(f->dump);
+	memset(f, 0, sizeof(*f));
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_FLIGHT_H
+#define __GPUTOP_FLIGHT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+#define FLIGHT_MAX_TRIGGERS	8
+
+enum flight_op {
+	FLIGHT_OP_GT,
+	FLIGHT_OP_GE,
+	FLIGHT_OP_LT,
+	FLIGHT_OP_LE,
+};
+
+/**
+ * flight_trigger:
+ *
+ * <group>.<column> <op> <value>[%|MB] [for <duration>], e.g.
+ *
+ * 	occupancy.PE > 95% for 2s
+ * 	memory.total_kb > 512MB
+ *
+ * % being relative to the samples of the window and MB converting to the KiB
+ * of the memory columns. A trigger fires once the condition has held for
+ * duration, then again only once it stopped holding.
+ */
+struct flight_trigger {
+	char *expr;
+	uint32_t column;
+	enum flight_op op;
+	double value;
+	bool percent;
+	uint64_t for_ns;
+
+	/* first window the condition held in, 0 if it doesn't */
+	uint64_t since_ns;
+	bool fired;
+};
+
+/**
+ * flight:
+ *
+ * Flight recorder, keeps the last length_ns of windows in a ring allocated
+ * upfront. Dumping copies the ring to a second buffer, which a thread of its
+ * own writes to a trace, so that the sampler never waits for the disk.
+ */
+struct flight {
+	struct trace_chip chip;
+	struct trace_column *columns;
+	uint32_t nr_columns;
+
+	uint64_t *ring;
+	uint32_t nr_rows;
+	/* next row to write, rows in the ring */
+	uint32_t head;
+	uint32_t count;
+	uint64_t length_ns;
+
+	/* dumps are written to <path>.<n> */
+	char *path;
+	unsigned int nr_dumps;
+
+	/* what the thread writes, and what it's busy with */
+	uint64_t *dump;
+	uint32_t nr_dump;
+	unsigned int dump_no;
+	bool pending;
+	bool stop;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct flight_trigger triggers[FLIGHT_MAX_TRIGGERS];
+	size_t nr_triggers;
+};
+
+/**
+ * flight_open:
+ *
+ * Room for length_ns of windows, period_ns being the least time between two
+ * of them. Returns -1 and sets errno on failure.
+ */
+int
+flight_open(struct flight *f, const char *path, uint64_t length_ns,
+	    uint64_t period_ns, const struct trace_chip *chip,
+	    const struct trace_column *columns, uint32_t nr_columns);
+
+/**
+ * flight_trigger_add:
+ *
+ * Returns -1 if expr can't be parsed or names an unknown column.
+ */
+int
+flight_trigger_add(struct flight *f, const char *expr);
+
+/**
+ * flight_push:
+ *
+ * Keep row, overwriting the oldest one once the ring is full. Returns the
+ * trigger that fired with it, if any.
+ */
+const struct flight_trigger *
+flight_push(struct flight *f, const uint64_t *row);
+
+/**
+ * flight_dump:
+ *
+ * Hand the windows of the last length_ns over to the writer thread. Returns
+ * the number of the dump, or -1 with errno EBUSY if the previous one is still
+ * being written.
+ */
+int
+flight_dump(struct flight *f);
+
+/**
+ * flight_close:
+ *
+ * Waits for a dump being written.
+ */
+void
+flight_close(struct flight *f);
+
+#endif
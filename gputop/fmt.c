@@ -0,0 +1,239 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "fmt.h"
+
+static const char fmt_digits[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const uint64_t fmt_pow10[] = {
+	1ULL,
+	10ULL,
+	100ULL,
+	1000ULL,
+	10000ULL,
+	100000ULL,
+	1000000ULL,
+	10000000ULL,
+	100000000ULL,
+	1000000000ULL,
+	10000000000ULL,
+	100000000000ULL,
+	1000000000000ULL,
+	10000000000000ULL,
+	100000000000000ULL,
+	1000000000000000ULL,
+	10000000000000000ULL,
+	100000000000000000ULL,
+	1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+#define FMT_MAX_DIGITS	(sizeof(fmt_pow10) / sizeof(fmt_pow10[0]))
+
+static unsigned
+fmt_nr_digits(uint64_t value)
+{
+	unsigned n = 1;
+
+	while (n < FMT_MAX_DIGITS && value >= fmt_pow10[n])
+		n++;
+
+	return n;
+}
+
+/*
+ * the last one or two digits of value, which is less than 100, before p
+ */
+static char *
+fmt_put_small(char *p, unsigned value)
+{
+	if (value < 10) {
+		*--p = '0' + value;
+	} else {
+		*--p = fmt_digits[value * 2 + 1];
+		*--p = fmt_digits[value * 2];
+	}
+
+	return p;
+}
+
+size_t
+fmt_u64(char *out, uint64_t value)
+{
+	size_t len = fmt_nr_digits(value);
+	char *p = out + len;
+
+	*p = '\0';
+
+	while (value >= 100) {
+		unsigned i = (value % 100) * 2;
+
+		value /= 100;
+		*--p = fmt_digits[i + 1];
+		*--p = fmt_digits[i];
+	}
+	fmt_put_small(p, value);
+
+	return len;
+}
+
+size_t
+fmt_u64_grouped(char *out, uint64_t value)
+{
+	unsigned digits = fmt_nr_digits(value);
+	size_t len = digits + (digits - 1) / 3;
+	char *p = out + len;
+
+	*p = '\0';
+
+	while (value >= 1000) {
+		unsigned group = value % 1000;
+
+		value /= 1000;
+		*--p = '0' + group % 10;
+		group = (group / 10) * 2;
+		*--p = fmt_digits[group + 1];
+		*--p = fmt_digits[group];
+		*--p = ',';
+	}
+
+	/* the leading group, one to three digits */
+	if (value >= 100) {
+		*--p = '0' + value % 10;
+		value /= 10;
+	}
+	fmt_put_small(p, value);
+
+	return len;
+}
+
+size_t
+fmt_fixed2(char *out, int64_t hundredths)
+{
+	uint64_t value = hundredths < 0 ? -(uint64_t) hundredths : (uint64_t) hundredths;
+	unsigned cents = value % 100;
+	size_t len = 0;
+
+	if (hundredths < 0)
+		out[len++] = '-';
+
+	len += fmt_u64(out + len, value / 100);
+	out[len++] = '.';
+	out[len++] = fmt_digits[cents * 2];
+	out[len++] = fmt_digits[cents * 2 + 1];
+	out[len] = '\0';
+
+	return len;
+}
+
+int64_t
+fmt_percent_of(uint64_t part, uint64_t whole)
+{
+	if (!whole)
+		return 0;
+
+	/* would overflow, doubles are precise enough there */
+	if (part > (UINT64_MAX - whole / 2) / 10000)
+		return fmt_hundredths(100.0 * (double) part / (double) whole);
+
+	return (part * 10000 + whole / 2) / whole;
+}
+
+int64_t
+fmt_hundredths(double value)
+{
+	/* NaN fails both */
+	if (!(value < FMT_FIXED2_MAX && value > -FMT_FIXED2_MAX))
+		return 0;
+
+	value *= 100.0;
+	return (int64_t) (value < 0 ? value - 0.5 : value + 0.5);
+}
+
+/*
+ * room for len chars right aligned to width, and the NUL fmt_*() put after
+ */
+static char *
+fmt_buf_reserve(struct gtop_buf *buf, size_t len, int width, size_t *total)
+{
+	size_t pad = width > 0 && (size_t) width > len ? (size_t) width - len : 0;
+	char *p = buf_reserve(buf, pad + len + 1);
+
+	if (!p)
+		return NULL;
+
+	memset(p, ' ', pad);
+	*total = pad + len;
+
+	return p + pad;
+}
+
+void
+fmt_buf_u64(struct gtop_buf *buf, uint64_t value, int width, bool grouped)
+{
+	unsigned digits = fmt_nr_digits(value);
+	size_t len = grouped ? digits + (digits - 1) / 3 : digits;
+	size_t total;
+	char *p;
+
+	p = fmt_buf_reserve(buf, len, width, &total);
+	if (!p)
+		return;
+
+	if (grouped)
+		fmt_u64_grouped(p, value);
+	else
+		fmt_u64(p, value);
+	buf_commit(buf, total);
+}
+
+void
+fmt_buf_fixed2(struct gtop_buf *buf, int64_t hundredths, int width)
+{
+	uint64_t value = hundredths < 0 ? -(uint64_t) hundredths : (uint64_t) hundredths;
+	size_t len = (hundredths < 0) + fmt_nr_digits(value / 100) + 3;
+	size_t total;
+	char *p;
+
+	p = fmt_buf_reserve(buf, len, width, &total);
+	if (!p)
+		return;
+
+	fmt_fixed2(p, hundredths);
+	buf_commit(buf, total);
+}
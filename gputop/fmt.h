@@ -0,0 +1,90 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_FMT_H
+#define __GPUTOP_FMT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+/*
+ * Number formatting for the pages, stdio-free: digits are taken two at a
+ * time out of a table and written from the end. Buffers are to be at least
+ * FMT_U64_LEN long, the results are NUL terminated and the length returned.
+ */
+
+/* 20 digits, 6 separators and the NUL */
+#define FMT_U64_LEN	27
+
+size_t
+fmt_u64(char *out, uint64_t value);
+
+/**
+ * fmt_u64_grouped:
+ *
+ * Thousands separated by ',', i.e. 1,234,567.
+ */
+size_t
+fmt_u64_grouped(char *out, uint64_t value);
+
+/**
+ * fmt_fixed2:
+ *
+ * A value in hundredths with two decimals, i.e. 1234 as 12.34.
+ */
+size_t
+fmt_fixed2(char *out, int64_t hundredths);
+
+/**
+ * fmt_percent_of:
+ *
+ * part of whole as a percentage in hundredths, rounded. 0 if whole is.
+ */
+int64_t
+fmt_percent_of(uint64_t part, uint64_t whole);
+
+/* doubles from which on fmt_hundredths() gives up */
+#define FMT_FIXED2_MAX	9e16
+
+/**
+ * fmt_hundredths:
+ *
+ * value rounded to hundredths, for what is computed with doubles. 0 if it
+ * is NaN or not within FMT_FIXED2_MAX.
+ */
+int64_t
+fmt_hundredths(double value);
+
+/*
+ * Straight into the buffer, right aligned in width columns at least.
+ */
+void
+fmt_buf_u64(struct gtop_buf *buf, uint64_t value, int width, bool grouped);
+
+void
+fmt_buf_fixed2(struct gtop_buf *buf, int64_t hundredths, int width);
+
+#endif
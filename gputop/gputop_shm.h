@@ -0,0 +1,269 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_SHM_READER_H
+#define __GPUTOP_SHM_READER_H
+
+/*
+ * Reader of the windows gputop --shm publishes, to be copied or included as
+ * is: it only needs a C99 compiler with the __atomic builtins (gcc, clang).
+ *
+ * The segment has a fixed layout, all values being native endian:
+ *
+ * 	struct gputop_shm_header	at offset 0
+ * 	struct gputop_shm_column	nr_columns of them, at columns_offset
+ * 	uint64_t			nr_columns values, at values_offset
+ *
+ * The columns are the ones of a recording (see gputop(8), Recording traces),
+ * named within their group: the window group comes first with timestamp_ns
+ * (CLOCK_REALTIME, end of the window), flags, window_ns and samples, modules
+ * of the occupancy group are busy for so many of these samples. The values
+ * are updated in place after each window under a seqlock, seq being odd while
+ * they are written, so that a reader takes a consistent snapshot without any
+ * syscall and without the sampler ever waiting for it.
+ *
+ * 	struct gputop_shm shm;
+ * 	uint64_t values[...];
+ *
+ * 	gputop_shm_open("/gputop", &shm);
+ * 	fe = gputop_shm_column(&shm, GPUTOP_SHM_GROUP_OCCUPANCY, "FE");
+ * 	if (gputop_shm_read(&shm, values, NULL) == 0)
+ * 		busy = 100.0 * values[fe] / values[GPUTOP_SHM_COL_SAMPLES];
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define GPUTOP_SHM_MAGIC	0x4d485347	/* GSHM */
+#define GPUTOP_SHM_VERSION	1
+
+#define GPUTOP_SHM_NAME_LEN	64
+#define GPUTOP_SHM_DESC_LEN	128
+
+enum gputop_shm_group {
+	GPUTOP_SHM_GROUP_WINDOW,
+	GPUTOP_SHM_GROUP_PART1,
+	GPUTOP_SHM_GROUP_PART2,
+	GPUTOP_SHM_GROUP_OCCUPANCY,
+	GPUTOP_SHM_GROUP_DMA,
+	GPUTOP_SHM_GROUP_MEMORY,
+};
+
+enum gputop_shm_std_column {
+	GPUTOP_SHM_COL_TIMESTAMP,
+	GPUTOP_SHM_COL_FLAGS,
+	GPUTOP_SHM_COL_WINDOW,
+	GPUTOP_SHM_COL_SAMPLES,
+};
+
+/* the writer being preempted in the middle of an update is unlikely */
+#define GPUTOP_SHM_RETRIES	1000
+
+struct gputop_shm_header {
+	uint32_t magic;
+	uint32_t version;
+	/* of the whole segment */
+	uint32_t size;
+	uint32_t nr_columns;
+	uint32_t columns_offset;
+	uint32_t values_offset;
+
+	/* 0 until the first window, odd while the values are being updated */
+	uint64_t seq;
+
+	/* gputop publishing, so that readers can tell it went away */
+	uint32_t pid;
+
+	/* the GPU, as in recordings */
+	uint32_t model;
+	uint32_t revision;
+	/* 3D, 2D, VG */
+	uint32_t cores[3];
+	int32_t drv_major;
+	int32_t drv_minor;
+	int32_t drv_patch;
+	int32_t drv_build;
+};
+
+struct gputop_shm_column {
+	char name[GPUTOP_SHM_NAME_LEN];
+	char desc[GPUTOP_SHM_DESC_LEN];
+	/* trace_group and id within it */
+	uint32_t group;
+	uint32_t id;
+};
+
+struct gputop_shm {
+	const struct gputop_shm_header *hdr;
+	const struct gputop_shm_column *columns;
+	const uint64_t *values;
+	size_t size;
+};
+
+static inline int
+gputop_shm_fd(const char *name, int oflag, mode_t mode)
+{
+#if defined __ANDROID__ || defined ANDROID
+	/* no POSIX shared memory, a file on a tmpfs does the same */
+	return open(name, oflag, mode);
+#else
+	return shm_open(name, oflag, mode);
+#endif
+}
+
+/*
+ * whether nr items of size from offset fit in the size bytes of the segment
+ */
+static inline int
+gputop_shm_fits(uint64_t offset, uint64_t nr, uint64_t size, uint64_t total)
+{
+	return offset <= total && nr * size <= total - offset;
+}
+
+/*
+ * map the segment name read-only, returns -1 and sets errno on failure, EAGAIN
+ * meaning gputop has yet to fill it
+ */
+static inline int
+gputop_shm_open(const char *name, struct gputop_shm *shm)
+{
+	const struct gputop_shm_header *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	memset(shm, 0, sizeof(*shm));
+
+	fd = gputop_shm_fd(name, O_RDONLY, 0);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	/* still being created */
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	hdr = map;
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != GPUTOP_SHM_MAGIC ||
+	    hdr->version != GPUTOP_SHM_VERSION || hdr->size > (size_t) st.st_size) {
+		errno = hdr->magic ? EPROTO : EAGAIN;
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	/* nothing past the segment is handed out */
+	if (!gputop_shm_fits(hdr->columns_offset, hdr->nr_columns,
+			     sizeof(struct gputop_shm_column), hdr->size) ||
+	    !gputop_shm_fits(hdr->values_offset, hdr->nr_columns,
+			     sizeof(uint64_t), hdr->size)) {
+		errno = EPROTO;
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	shm->hdr = hdr;
+	shm->columns = (const void *) ((const char *) map + hdr->columns_offset);
+	shm->values = (const void *) ((const char *) map + hdr->values_offset);
+	shm->size = st.st_size;
+	return 0;
+}
+
+static inline void
+gputop_shm_close(struct gputop_shm *shm)
+{
+	if (shm->hdr)
+		munmap((void *) shm->hdr, shm->size);
+	memset(shm, 0, sizeof(*shm));
+}
+
+/*
+ * index of the column name of group, -1 if gputop doesn't publish it
+ */
+static inline int
+gputop_shm_column(const struct gputop_shm *shm, uint32_t group,
+		  const char *name)
+{
+	for (uint32_t c = 0; c < shm->hdr->nr_columns; c++)
+		if (shm->columns[c].group == group &&
+		    !strncmp(shm->columns[c].name, name, GPUTOP_SHM_NAME_LEN))
+			return c;
+
+	return -1;
+}
+
+/*
+ * copy the latest window to values, nr_columns of them, and its sequence
+ * number to seq if not NULL, which is even and grows by 2 with each window.
+ * Returns -1 with errno EAGAIN if no window has been published yet, or if the
+ * values kept changing under us.
+ */
+static inline int
+gputop_shm_read(const struct gputop_shm *shm, uint64_t *values, uint64_t *seq)
+{
+	const struct gputop_shm_header *hdr = shm->hdr;
+
+	for (int i = 0; i < GPUTOP_SHM_RETRIES; i++) {
+		uint64_t begin, end;
+
+		begin = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+		if (!begin)
+			break;
+		if (begin & 1)
+			continue;
+
+		for (uint32_t c = 0; c < hdr->nr_columns; c++)
+			values[c] = __atomic_load_n(&shm->values[c], __ATOMIC_RELAXED);
+
+		/* the values have to be read before seq is read again */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		end = __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED);
+
+		if (begin == end) {
+			if (seq)
+				*seq = begin;
+			return 0;
+		}
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "history.h"
+
+static const char *history_blocks[HISTORY_LEVELS + 1] = {
+	" ", "▁", "▂", "▃", "▄",
+	"▅", "▆", "▇", "█",
+};
+
+static const char history_ascii[HISTORY_LEVELS + 1] = " ._-=+*#@";
+
+/* braille dots filled bottom up, for the left and the right column */
+static const uint8_t history_braille_dots[2][5] = {
+	{ 0x00, 0x40, 0x44, 0x46, 0x47 },
+	{ 0x00, 0x80, 0xa0, 0xb0, 0xb8 },
+};
+
+static uint8_t
+history_level(const struct history *h, int64_t value)
+{
+	int64_t level;
+
+	if (value <= 0 || h->scale <= 0)
+		return 0;
+	if (value >= h->scale)
+		return HISTORY_LEVELS;
+
+	/* anything but nothing shows */
+	level = (value * HISTORY_LEVELS + h->scale - 1) / h->scale;
+	return level > HISTORY_LEVELS ? HISTORY_LEVELS : (uint8_t) level;
+}
+
+void
+history_init(struct history *h, int64_t scale)
+{
+	memset(h, 0, sizeof(*h));
+
+	h->scale = scale;
+	h->fixed = scale > 0;
+}
+
+void
+history_push(struct history *h, int64_t value)
+{
+	size_t i = h->pushed % HISTORY_LEN;
+	uint64_t kept;
+
+	h->values[i] = value;
+	h->pushed++;
+
+	/* what went out of the ring might have been the peak, that's fine */
+	if (value > h->peak)
+		h->peak = value;
+
+	if (!h->fixed && value > h->scale) {
+		h->scale = value;
+
+		kept = h->pushed < HISTORY_LEN ? h->pushed : HISTORY_LEN;
+		for (size_t k = 0; k < kept; k++)
+			h->levels[k] = history_level(h, h->values[k]);
+		return;
+	}
+
+	h->levels[i] = history_level(h, value);
+}
+
+/*
+ * the level of window k, -1 if it hasn't been pushed or isn't kept anymore
+ */
+static int
+history_level_at(const struct history *h, int64_t k)
+{
+	if (k < 0 || (uint64_t) k >= h->pushed || h->pushed - k > HISTORY_LEN)
+		return -1;
+
+	return h->levels[k % HISTORY_LEN];
+}
+
+static void
+history_draw_cell(const struct history *h, struct gtop_buf *buf, int64_t cell,
+		  int per_cell, enum history_style style)
+{
+	int first = history_level_at(h, cell * per_cell);
+	int second;
+	uint8_t dots;
+
+	switch (style) {
+	case HISTORY_BLOCKS:
+		buf_puts(buf, history_blocks[first < 0 ? 0 : first]);
+		break;
+	case HISTORY_ASCII:
+		buf_putc(buf, history_ascii[first < 0 ? 0 : first]);
+		break;
+	case HISTORY_BRAILLE:
+		second = history_level_at(h, cell * per_cell + 1);
+		dots = history_braille_dots[0][first < 0 ? 0 : (first + 1) / 2] |
+		       history_braille_dots[1][second < 0 ? 0 : (second + 1) / 2];
+
+		/* U+2800 + dots */
+		buf_putc(buf, 0xe2);
+		buf_putc(buf, 0xa0 | (dots >> 6));
+		buf_putc(buf, 0x80 | (dots & 0x3f));
+		break;
+	}
+}
+
+void
+history_draw(const struct history *h, struct gtop_buf *buf, int width,
+	     enum history_style style)
+{
+	int per_cell = style == HISTORY_BRAILLE ? 2 : 1;
+	int64_t head;
+
+	if (width <= 0)
+		return;
+
+	/* no more cells than windows kept */
+	if (width > HISTORY_LEN / per_cell)
+		width = HISTORY_LEN / per_cell;
+
+	/* the cell the newest window is in */
+	head = h->pushed ? (int64_t) (h->pushed - 1) / per_cell : -1;
+
+	for (int x = 0; x < width; x++) {
+		/* the latest cell drawn in column x */
+		int64_t cell = head - ((head % width - x + width) % width);
+
+		if (head < 0 || (width > 1 && x == (head + 1) % width)) {
+			buf_putc(buf, ' ');
+			continue;
+		}
+
+		history_draw_cell(h, buf, cell, per_cell, style);
+	}
+}
+
+int
+history_style_parse(const char *str)
+{
+	if (!strcmp(str, "blocks"))
+		return HISTORY_BLOCKS;
+	if (!strcmp(str, "braille"))
+		return HISTORY_BRAILLE;
+	if (!strcmp(str, "ascii"))
+		return HISTORY_ASCII;
+
+	return -1;
+}
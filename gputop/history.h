@@ -0,0 +1,102 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_HISTORY_H
+#define __GPUTOP_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+/* windows kept per metric */
+#define HISTORY_LEN	256
+/* how high a value can be drawn, 0 is nothing */
+#define HISTORY_LEVELS	8
+
+enum history_style {
+	/* U+2581 to U+2588, one window per cell */
+	HISTORY_BLOCKS,
+	/* four dots high, two windows per cell */
+	HISTORY_BRAILLE,
+	/* for consoles without UTF-8 */
+	HISTORY_ASCII,
+};
+
+/**
+ * history:
+ *
+ * The last HISTORY_LEN windows of a metric. The level each value is drawn
+ * with is worked out when it is pushed, drawing only copies glyphs out.
+ */
+struct history {
+	int64_t values[HISTORY_LEN];
+	uint8_t levels[HISTORY_LEN];
+	/* windows pushed so far, the last one is at (pushed - 1) % HISTORY_LEN */
+	uint64_t pushed;
+
+	/* what is drawn full height, fixed or the largest value seen */
+	int64_t scale;
+	bool fixed;
+	/* largest value pushed */
+	int64_t peak;
+};
+
+/**
+ * history_init:
+ *
+ * scale is the value drawn full height, 0 to scale to the largest value
+ * seen so far.
+ */
+void
+history_init(struct history *h, int64_t scale);
+
+/**
+ * history_push:
+ *
+ * When the scale has to grow, the levels of the windows kept are worked out
+ * again, otherwise only the one of value.
+ */
+void
+history_push(struct history *h, int64_t value);
+
+/**
+ * history_draw:
+ *
+ * Draw the history in width cells, as a sweep: the newest window goes in the
+ * cell after the previous one and wraps around to the first one, followed by
+ * a blank cell. Only the cells around it change from a window to the next.
+ */
+void
+history_draw(const struct history *h, struct gtop_buf *buf, int width,
+	     enum history_style style);
+
+/**
+ * history_style_parse:
+ *
+ * blocks, braille or ascii. Returns -1 for anything else.
+ */
+int
+history_style_parse(const char *str);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+#include "layout.h"
+
+void
+layout_grid(struct layout_grid *grid, int rows, int cols, unsigned items,
+	    int fixed, int label_min, int label_max)
+{
+	unsigned columns, max_columns;
+
+	if (grid->columns && grid->rows == rows && grid->cols == cols &&
+	    grid->items == items)
+		return;
+
+	grid->rows = rows;
+	grid->cols = cols;
+	grid->items = items;
+
+	if (cols <= 0) {
+		grid->columns = 2;
+		grid->lines = (items + 1) / 2;
+		grid->label = label_max;
+		return;
+	}
+
+	/* with the labels in full, then with the shortest ones */
+	columns = cols / (fixed + label_max);
+	max_columns = cols / (fixed + label_min);
+	if (!columns)
+		columns = 1;
+	if (!max_columns)
+		max_columns = 1;
+
+	while (columns < max_columns && columns < items &&
+	       (items + columns - 1) / columns > (unsigned) rows)
+		columns++;
+
+	grid->columns = columns;
+	grid->lines = (items + columns - 1) / columns;
+	grid->label = cols / (int) columns - fixed;
+	if (grid->label > label_max)
+		grid->label = label_max;
+	if (grid->label < 0)
+		grid->label = 0;
+}
+
+int
+layout_columns(bool *shown, const int *width, const int *drop,
+	       unsigned nr, int cols, int min)
+{
+	int used = 0;
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		shown[i] = true;
+		used += width[i];
+	}
+
+	for (i = 0; i < nr && drop[i] >= 0 && cols - used < min; i++) {
+		shown[drop[i]] = false;
+		used -= width[drop[i]];
+	}
+
+	return cols - used < min ? min : cols - used;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_LAYOUT_H
+#define __GPUTOP_LAYOUT_H
+
+#include <stdbool.h>
+
+/**
+ * layout_grid:
+ *
+ * Items laid out row by row over a number of columns. Each item is made of a
+ * fixed part, the value, and a label truncated to fit.
+ */
+struct layout_grid {
+	/* what it has been laid out for */
+	int rows;
+	int cols;
+	unsigned items;
+
+	/* items per line, lines used and width of the labels */
+	unsigned columns;
+	unsigned lines;
+	int label;
+};
+
+/**
+ * layout_grid:
+ *
+ * Use as many columns as fit with the labels in full, and more, with the
+ * labels truncated down to label_min, if the items do not fit in rows. rows
+ * and cols as 0 means there's no terminal and columns default to two.
+ * Nothing is done if these are the same as last time.
+ */
+void
+layout_grid(struct layout_grid *grid, int rows, int cols, unsigned items,
+	    int fixed, int label_min, int label_max);
+
+/**
+ * layout_columns:
+ *
+ * Columns of a table, width[] wide, dropped in the order given by drop[], up
+ * to a -1, until what is left, at least min, fits in cols. shown[] is set for
+ * the columns kept. Returns the width left over, never less than min.
+ */
+int
+layout_columns(bool *shown, const int *width, const int *drop,
+	       unsigned nr, int cols, int min);
+
+#endif
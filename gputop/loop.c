@@ -0,0 +1,279 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "loop.h"
+
+#ifndef __linux__
+/* written to by the signal handlers, the signal number a byte */
+static int loop_pipe[2] = { -1, -1 };
+
+static void
+loop_signal_handler(int sig)
+{
+	unsigned char c = sig;
+	int saved = errno;
+	ssize_t nr = write(loop_pipe[1], &c, 1);
+
+	(void) nr;
+	errno = saved;
+}
+#endif
+
+static uint64_t
+loop_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned
+loop_signal_event(int sig)
+{
+	return sig == SIGWINCH ? LOOP_RESIZE : LOOP_QUIT;
+}
+
+int
+loop_init(struct loop *l, int input_fd)
+{
+	memset(l, 0, sizeof(*l));
+	l->timer_fd = -1;
+	l->input_fd = input_fd;
+
+#ifdef __linux__
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGWINCH);
+
+	/* they only come through the signalfd now */
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+		return -1;
+
+	l->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (l->signal_fd < 0)
+		return -1;
+
+	l->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (l->timer_fd < 0)
+		return -1;
+#else
+	struct sigaction sa;
+
+	if (pipe(loop_pipe) < 0)
+		return -1;
+
+	for (int i = 0; i < 2; i++) {
+		if (fcntl(loop_pipe[i], F_SETFL,
+			  fcntl(loop_pipe[i], F_GETFL) | O_NONBLOCK) < 0)
+			return -1;
+	}
+	l->signal_fd = loop_pipe[0];
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = loop_signal_handler;
+
+	if (sigaction(SIGINT, &sa, NULL) < 0 ||
+	    sigaction(SIGTERM, &sa, NULL) < 0 ||
+	    sigaction(SIGWINCH, &sa, NULL) < 0)
+		return -1;
+#endif
+
+	return 0;
+}
+
+int
+loop_tick(struct loop *l, uint64_t period_ns)
+{
+	l->period_ns = period_ns;
+	l->next_ns = loop_now_ns() + period_ns;
+
+#ifdef __linux__
+	struct itimerspec its = {
+		.it_interval = {
+			.tv_sec = period_ns / 1000000000ULL,
+			.tv_nsec = period_ns % 1000000000ULL,
+		},
+	};
+
+	its.it_value = its.it_interval;
+	return timerfd_settime(l->timer_fd, 0, &its, NULL);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * what the signals that came in are asking for
+ */
+static unsigned
+loop_read_signals(struct loop *l)
+{
+	unsigned events = 0;
+
+#ifdef __linux__
+	struct signalfd_siginfo si;
+
+	while (read(l->signal_fd, &si, sizeof(si)) == sizeof(si))
+		events |= loop_signal_event(si.ssi_signo);
+#else
+	unsigned char c;
+
+	while (read(l->signal_fd, &c, 1) == 1)
+		events |= loop_signal_event(c);
+#endif
+
+	return events;
+}
+
+/*
+ * whether a tick went by, without a timerfd now being past the deadline
+ */
+static bool
+loop_read_tick(struct loop *l, bool readable)
+{
+#ifdef __linux__
+	uint64_t expirations;
+
+	return readable && read(l->timer_fd, &expirations, sizeof(expirations)) ==
+		sizeof(expirations);
+#else
+	uint64_t now = loop_now_ns();
+
+	(void) readable;
+	if (now < l->next_ns)
+		return false;
+
+	/* ticks we missed are gone */
+	while (l->next_ns <= now)
+		l->next_ns += l->period_ns;
+	return true;
+#endif
+}
+
+int
+loop_wait(struct loop *l, unsigned events, struct pollfd *fds, size_t nr,
+	  int64_t timeout_ns)
+{
+	struct pollfd *pfds;
+	bool tick = (events & LOOP_TICK) && l->period_ns;
+	bool input = (events & LOOP_INPUT) && l->input_fd >= 0;
+	size_t n = 0, tick_at = 0, input_at = 0;
+	unsigned ret = 0;
+	int timeout_ms;
+
+	/* signals, ticks, stdin then the caller's */
+	if (3 + nr > l->pfds_size) {
+		size_t size = l->pfds_size ? l->pfds_size : 8;
+
+		while (size < 3 + nr)
+			size *= 2;
+
+		pfds = realloc(l->pfds, size * sizeof(*pfds));
+		if (!pfds)
+			return -1;
+
+		l->pfds = pfds;
+		l->pfds_size = size;
+	}
+	pfds = l->pfds;
+
+	pfds[n++] = (struct pollfd) { .fd = l->signal_fd, .events = POLLIN };
+#ifdef __linux__
+	if (tick) {
+		tick_at = n;
+		pfds[n++] = (struct pollfd) { .fd = l->timer_fd, .events = POLLIN };
+	}
+#else
+	if (tick) {
+		uint64_t now = loop_now_ns();
+		int64_t left = l->next_ns > now ? (int64_t) (l->next_ns - now) : 0;
+
+		if (timeout_ns < 0 || left < timeout_ns)
+			timeout_ns = left;
+	}
+#endif
+	if (input) {
+		input_at = n;
+		pfds[n++] = (struct pollfd) { .fd = l->input_fd, .events = POLLIN };
+	}
+	for (size_t i = 0; i < nr; i++) {
+		fds[i].revents = 0;
+		pfds[n + i] = fds[i];
+	}
+
+	/* rounded up, we'd rather not wake up before it is time */
+	timeout_ms = timeout_ns < 0 ? -1 : (int) ((timeout_ns + 999999) / 1000000);
+
+	/* interrupted by one of the other signals, SIGUSR1 say: nothing to report */
+	if (poll(pfds, n + nr, timeout_ms) < 0 && errno != EINTR)
+		return -1;
+
+	if (pfds[0].revents & POLLIN)
+		ret |= loop_read_signals(l);
+	if (tick && loop_read_tick(l, pfds[tick_at].revents & POLLIN))
+		ret |= LOOP_TICK;
+	if (input && pfds[input_at].revents)
+		ret |= LOOP_INPUT;
+
+	for (size_t i = 0; i < nr; i++) {
+		fds[i].revents = pfds[n + i].revents;
+		if (fds[i].revents)
+			ret |= LOOP_FDS;
+	}
+
+	return ret;
+}
+
+void
+loop_close(struct loop *l)
+{
+	if (l->timer_fd >= 0)
+		close(l->timer_fd);
+	if (l->signal_fd >= 0)
+		close(l->signal_fd);
+
+	l->timer_fd = l->signal_fd = -1;
+
+	free(l->pfds);
+	l->pfds = NULL;
+	l->pfds_size = 0;
+}
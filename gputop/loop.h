@@ -0,0 +1,100 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __GPUTOP_LOOP_H
+#define __GPUTOP_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <poll.h>
+
+/* what loop_wait() returns, or'ed */
+enum loop_event {
+	/* a window is due */
+	LOOP_TICK	= 1 << 0,
+	/* stdin is readable */
+	LOOP_INPUT	= 1 << 1,
+	/* SIGINT or SIGTERM */
+	LOOP_QUIT	= 1 << 2,
+	/* SIGWINCH */
+	LOOP_RESIZE	= 1 << 3,
+	/* one of the descriptors passed in has revents set */
+	LOOP_FDS	= 1 << 4,
+};
+
+/**
+ * loop:
+ *
+ * The one place we wait in: the window ticks, stdin, the signals asking us to
+ * quit or telling the terminal has been resized, and whatever descriptors the
+ * caller has. On Linux ticks come from a timerfd and signals from a signalfd.
+ * Elsewhere, i.e. QNX, ticks are deadlines on CLOCK_MONOTONIC and the signal
+ * handlers write to a pipe.
+ */
+struct loop {
+	int timer_fd;
+	/* signalfd, or the read end of the pipe */
+	int signal_fd;
+	/* -1 once it is at EOF */
+	int input_fd;
+
+	/* without a timerfd, when the next tick is due */
+	uint64_t period_ns;
+	uint64_t next_ns;
+
+	/* ours followed by the caller's, grown as needed */
+	struct pollfd *pfds;
+	size_t pfds_size;
+};
+
+/**
+ * loop_init:
+ *
+ * Takes over SIGINT, SIGTERM and SIGWINCH, do it before starting threads.
+ * Returns -1 and sets errno on failure.
+ */
+int
+loop_init(struct loop *l, int input_fd);
+
+/**
+ * loop_tick:
+ *
+ * Tick every period_ns from now on, 0 to stop ticking.
+ */
+int
+loop_tick(struct loop *l, uint64_t period_ns);
+
+/**
+ * loop_wait:
+ *
+ * Wait for the events asked for, LOOP_TICK and/or LOOP_INPUT, for the signals
+ * and for the nr fds. timeout_ns < 0 waits for as long as it takes. Returns
+ * what happened, 0 if the timeout elapsed, -1 and sets errno on error.
+ */
+int
+loop_wait(struct loop *l, unsigned events, struct pollfd *fds, size_t nr,
+	  int64_t timeout_ns);
+
+void
+loop_close(struct loop *l);
+
+#endif
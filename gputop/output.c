@@ -0,0 +1,217 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "fmt.h"
+#include "output.h"
+
+int
+output_parse_format(const char *name, enum output_format *format)
+{
+	if (!strcmp(name, "text"))
+		*format = OUTPUT_TEXT;
+	else if (!strcmp(name, "csv"))
+		*format = OUTPUT_CSV;
+	else if (!strcmp(name, "jsonl"))
+		*format = OUTPUT_JSONL;
+	else
+		return -1;
+
+	return 0;
+}
+
+void
+output_header(struct output *out)
+{
+	if (out->format == OUTPUT_CSV)
+		buf_puts(out->buf, "timestamp_ns,page,source,metric,value\n");
+}
+
+void
+output_json_str(struct gtop_buf *buf, const char *str)
+{
+	buf_putc(buf, '"');
+
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\') {
+			buf_putc(buf, '\\');
+			buf_putc(buf, c);
+		} else if (c < 0x20) {
+			buf_printf(buf, "\\u%04x", c);
+		} else {
+			buf_putc(buf, c);
+		}
+	}
+
+	buf_putc(buf, '"');
+}
+
+static void
+output_csv_str(struct gtop_buf *buf, const char *str)
+{
+	if (!strpbrk(str, ",\"\r\n")) {
+		buf_puts(buf, str);
+		return;
+	}
+
+	buf_putc(buf, '"');
+	for (; *str; str++) {
+		if (*str == '"')
+			buf_putc(buf, '"');
+		buf_putc(buf, *str);
+	}
+	buf_putc(buf, '"');
+}
+
+/*
+ * what comes before the value: the key in JSON, the whole row prefix in CSV
+ */
+static void
+output_key(struct output *out, const char *key)
+{
+	struct gtop_buf *buf = out->buf;
+
+	if (out->format == OUTPUT_JSONL) {
+		if (out->items[out->depth])
+			buf_putc(buf, ',');
+		out->items[out->depth] = true;
+
+		output_json_str(buf, key);
+		buf_putc(buf, ':');
+		return;
+	}
+
+	fmt_buf_u64(buf, out->timestamp, 0, false);
+	buf_putc(buf, ',');
+	buf_puts(buf, out->page);
+	buf_putc(buf, ',');
+	for (int i = 0; i < out->depth; i++) {
+		if (i)
+			buf_putc(buf, '.');
+		output_csv_str(buf, out->groups[i]);
+	}
+	buf_putc(buf, ',');
+	output_csv_str(buf, key);
+	buf_putc(buf, ',');
+}
+
+void
+output_begin(struct output *out, const char *page, uint64_t timestamp)
+{
+	out->page = page;
+	out->timestamp = timestamp;
+	out->depth = 0;
+	out->overflow = 0;
+
+	if (out->format == OUTPUT_JSONL) {
+		buf_printf(out->buf, "{\"timestamp_ns\":%" PRIu64 ",\"page\":", timestamp);
+		output_json_str(out->buf, page);
+		out->items[0] = true;
+	}
+}
+
+void
+output_end(struct output *out)
+{
+	if (out->format == OUTPUT_JSONL)
+		buf_puts(out->buf, "}\n");
+}
+
+void
+output_group_begin(struct output *out, const char *name)
+{
+	if (out->depth >= OUTPUT_MAX_DEPTH) {
+		out->overflow++;
+		return;
+	}
+
+	if (out->format == OUTPUT_JSONL) {
+		output_key(out, name);
+		buf_putc(out->buf, '{');
+	}
+
+	out->groups[out->depth++] = name;
+	out->items[out->depth] = false;
+}
+
+void
+output_group_end(struct output *out)
+{
+	/* nothing has been written for it */
+	if (out->overflow) {
+		out->overflow--;
+		return;
+	}
+
+	if (out->depth == 0)
+		return;
+
+	out->depth--;
+
+	if (out->format == OUTPUT_JSONL)
+		buf_putc(out->buf, '}');
+}
+
+void
+output_u64(struct output *out, const char *key, uint64_t value)
+{
+	output_key(out, key);
+	fmt_buf_u64(out->buf, value, 0, false);
+
+	if (out->format == OUTPUT_CSV)
+		buf_putc(out->buf, '\n');
+}
+
+void
+output_fixed(struct output *out, const char *key, double value)
+{
+	output_key(out, key);
+	/* JSON has no nan or inf */
+	if (out->format == OUTPUT_JSONL && !isfinite(value))
+		buf_puts(out->buf, "null");
+	else if (value < FMT_FIXED2_MAX && value > -FMT_FIXED2_MAX)
+		fmt_buf_fixed2(out->buf, fmt_hundredths(value), 0);
+	else
+		buf_printf(out->buf, "%.2f", value);
+
+	if (out->format == OUTPUT_CSV)
+		buf_putc(out->buf, '\n');
+}
+
+void
+output_str(struct output *out, const char *key, const char *value)
+{
+	output_key(out, key);
+
+	if (out->format == OUTPUT_JSONL) {
+		output_json_str(out->buf, value);
+	} else {
+		output_csv_str(out->buf, value);
+		buf_putc(out->buf, '\n');
+	}
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_OUTPUT_H
+#define __GPUTOP_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+enum output_format {
+	OUTPUT_TEXT = 0,
+	OUTPUT_CSV,
+	OUTPUT_JSONL,
+};
+
+#define OUTPUT_MAX_DEPTH	4
+
+/**
+ * output:
+ *
+ * Serializes one record per sampling window into buf.
+ *
+ * With CSV every value becomes a row of:
+ *
+ * 	timestamp_ns,page,source,metric,value
+ *
+ * source being the enclosing groups joined by '.'.
+ *
+ * With JSON Lines every window is an object on its own line, groups becoming
+ * nested objects:
+ *
+ * 	{"timestamp_ns":...,"page":"...",<groups and values>}
+ */
+struct output {
+	enum output_format format;
+	struct gtop_buf *buf;
+
+	/* current record */
+	uint64_t timestamp;
+	const char *page;
+	int depth;
+	/* groups begun past OUTPUT_MAX_DEPTH, written in the enclosing one */
+	int overflow;
+
+	/* csv: names of the enclosing groups */
+	const char *groups[OUTPUT_MAX_DEPTH];
+
+	/* json: if something has been written already at that depth */
+	bool items[OUTPUT_MAX_DEPTH + 1];
+};
+
+/**
+ * output_parse_format:
+ *
+ * Returns -1 if name is not one of text, csv or jsonl.
+ */
+int
+output_parse_format(const char *name, enum output_format *format);
+
+/**
+ * output_header:
+ *
+ * Column names, only CSV has them.
+ */
+void
+output_header(struct output *out);
+
+void
+output_begin(struct output *out, const char *page, uint64_t timestamp);
+
+void
+output_end(struct output *out);
+
+void
+output_group_begin(struct output *out, const char *name);
+
+void
+output_group_end(struct output *out);
+
+void
+output_u64(struct output *out, const char *key, uint64_t value);
+
+/**
+ * output_fixed:
+ *
+ * Values with two decimals, like percentages or MB.
+ */
+void
+output_fixed(struct output *out, const char *key, double value);
+
+void
+output_str(struct output *out, const char *key, const char *value);
+
+/**
+ * output_json_str:
+ *
+ * Quoted and escaped JSON string.
+ */
+void
+output_json_str(struct gtop_buf *buf, const char *str);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "debugfs.h"
+#include "stats.h"
+#include "procs.h"
+
+/* counter procs_sort() sorts by, qsort() has no way to pass it */
+static uint32_t procs_sort_counter;
+
+void
+procs_init(struct procs *p, uint32_t nr_counters, const char *ignore)
+{
+	memset(p, 0, sizeof(*p));
+	p->nr_counters = nr_counters;
+	p->ignore = ignore;
+}
+
+static int
+procs_ctx_cmp(const void *a, const void *b)
+{
+	const struct procs_ctx *ca = a;
+	const struct procs_ctx *cb = b;
+
+	if (ca->pid != cb->pid)
+		return ca->pid < cb->pid ? -1 : 1;
+	if (ca->ctx != cb->ctx)
+		return ca->ctx < cb->ctx ? -1 : 1;
+
+	return 0;
+}
+
+static void
+procs_ctx_free(struct procs_ctx *c)
+{
+	free(c->name);
+	free(c->events);
+	free(c->estimate);
+}
+
+static bool
+procs_match(const struct procs *p, const struct debugfs_ctx_entry *entry)
+{
+	if (p->ignore && !strcmp(entry->name, p->ignore))
+		return false;
+	if (p->name)
+		return !strcmp(entry->name, p->name);
+	if (p->pid)
+		return entry->pid == p->pid;
+
+	return true;
+}
+
+int
+procs_sync(struct procs *p, const struct debugfs_ctx_index *idx,
+	   uint32_t pid, const char *name)
+{
+	const struct debugfs_ctx_entry *entry;
+	struct procs_ctx *ctxs, *old;
+	size_t nr = 0, i;
+	uint32_t next_pid = 0, next_ctx = 0;
+
+	if (p->generation == idx->generation && p->pid == pid &&
+	    (p->name == name || (p->name && name && !strcmp(p->name, name))))
+		return 0;
+
+	p->pid = pid;
+	p->name = name;
+
+	ctxs = calloc(idx->nr ? idx->nr : 1, sizeof(*ctxs));
+	if (!ctxs)
+		return -1;
+
+	ctx_index_for_each(entry, idx) {
+		struct procs_ctx *c = &ctxs[nr];
+
+		if (!procs_match(p, entry))
+			continue;
+
+		c->ctx = entry->ctx;
+		c->pid = entry->pid;
+		c->name = strdup(entry->name);
+		c->events = calloc(p->nr_counters, sizeof(uint64_t));
+		c->estimate = calloc(p->nr_counters, sizeof(uint64_t));
+		nr++;
+
+		if (!c->name || !c->events || !c->estimate)
+			goto err;
+	}
+
+	qsort(ctxs, nr, sizeof(*ctxs), procs_ctx_cmp);
+
+	/* keep what we know of those still there */
+	for (i = 0; i < nr; i++) {
+		old = bsearch(&ctxs[i], p->ctxs, p->nr_ctxs, sizeof(*p->ctxs),
+			      procs_ctx_cmp);
+		if (!old)
+			continue;
+
+		memcpy(ctxs[i].estimate, old->estimate, p->nr_counters * sizeof(uint64_t));
+		ctxs[i].time_enabled = old->time_enabled;
+		ctxs[i].estimate_running = old->estimate_running;
+		ctxs[i].age = old->age;
+	}
+
+	/* and go on with the rotation where it was */
+	if (p->nr_ctxs) {
+		old = &p->ctxs[p->next % p->nr_ctxs];
+		next_pid = old->pid;
+		next_ctx = old->ctx;
+	}
+
+	for (i = 0; i < p->nr_ctxs; i++)
+		procs_ctx_free(&p->ctxs[i]);
+	free(p->ctxs);
+
+	p->ctxs = ctxs;
+	p->nr_ctxs = nr;
+	p->generation = idx->generation;
+
+	for (p->next = 0; p->next < nr; p->next++) {
+		if (ctxs[p->next].pid > next_pid ||
+		    (ctxs[p->next].pid == next_pid && ctxs[p->next].ctx >= next_ctx))
+			break;
+	}
+
+	/* processes are summed again at the end of the window */
+	p->nr_procs = 0;
+
+	return 0;
+
+err:
+	for (i = 0; i < nr; i++)
+		procs_ctx_free(&ctxs[i]);
+	free(ctxs);
+
+	/* try again next time */
+	p->generation = 0;
+
+	return -1;
+}
+
+struct procs_ctx *
+procs_next(struct procs *p)
+{
+	if (!p->nr_ctxs)
+		return NULL;
+
+	if (p->next >= p->nr_ctxs)
+		p->next = 0;
+
+	return &p->ctxs[p->next++];
+}
+
+void
+procs_account(struct procs *p, struct procs_ctx *c, const uint64_t *events,
+	      uint64_t running)
+{
+	for (uint32_t i = 0; i < p->nr_counters; i++)
+		c->events[i] += events[i];
+
+	c->time_running += running;
+}
+
+int
+procs_window(struct procs *p, uint64_t window_ns)
+{
+	struct procs_proc *proc = NULL;
+
+	p->nr_procs = 0;
+
+	for (size_t i = 0; i < p->nr_ctxs; i++) {
+		struct procs_ctx *c = &p->ctxs[i];
+
+		if (c->time_running) {
+			for (uint32_t k = 0; k < p->nr_counters; k++) {
+				c->estimate[k] = stats_mux_scale(c->events[k], window_ns,
+								 c->time_running);
+				c->events[k] = 0;
+			}
+
+			c->time_enabled = window_ns;
+			c->estimate_running = c->time_running;
+			c->time_running = 0;
+			c->age = 0;
+		} else {
+			c->age++;
+		}
+
+		/* sorted by pid, a new one starts a new process */
+		if (!proc || proc->pid != c->pid) {
+			if (p->nr_procs == p->procs_size) {
+				size_t size = p->procs_size ? p->procs_size * 2 : 16;
+				struct procs_proc *procs;
+
+				procs = realloc(p->procs, size * sizeof(*procs));
+				if (!procs)
+					return -1;
+
+				/* events of the new ones are allocated below */
+				memset(procs + p->procs_size, 0,
+				       (size - p->procs_size) * sizeof(*procs));
+				p->procs = procs;
+				p->procs_size = size;
+			}
+
+			proc = &p->procs[p->nr_procs];
+			if (!proc->events) {
+				proc->events = calloc(p->nr_counters, sizeof(uint64_t));
+				if (!proc->events)
+					return -1;
+			}
+			p->nr_procs++;
+
+			memset(proc->events, 0, p->nr_counters * sizeof(uint64_t));
+			proc->pid = c->pid;
+			proc->name = c->name;
+			proc->nr_ctx = 0;
+			proc->time_enabled = 0;
+			proc->time_running = 0;
+			proc->first_ctx = i;
+		}
+
+		for (uint32_t k = 0; k < p->nr_counters; k++)
+			proc->events[k] += c->estimate[k];
+
+		proc->time_enabled += c->time_enabled;
+		proc->time_running += c->estimate_running;
+		proc->nr_ctx++;
+	}
+
+	return 0;
+}
+
+static int
+procs_proc_cmp(const void *a, const void *b)
+{
+	const struct procs_proc *pa = a;
+	const struct procs_proc *pb = b;
+	uint64_t ea = pa->events[procs_sort_counter];
+	uint64_t eb = pb->events[procs_sort_counter];
+
+	if (ea != eb)
+		return ea > eb ? -1 : 1;
+	if (pa->pid != pb->pid)
+		return pa->pid < pb->pid ? -1 : 1;
+
+	return 0;
+}
+
+void
+procs_sort(struct procs *p, uint32_t counter)
+{
+	if (counter >= p->nr_counters)
+		return;
+
+	procs_sort_counter = counter;
+	qsort(p->procs, p->nr_procs, sizeof(*p->procs), procs_proc_cmp);
+}
+
+void
+procs_free(struct procs *p)
+{
+	for (size_t i = 0; i < p->nr_ctxs; i++)
+		procs_ctx_free(&p->ctxs[i]);
+	free(p->ctxs);
+
+	for (size_t i = 0; i < p->procs_size; i++)
+		free(p->procs[i].events);
+	free(p->procs);
+
+	memset(p, 0, sizeof(*p));
+}
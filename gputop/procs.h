@@ -0,0 +1,163 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_PROCS_H
+#define __GPUTOP_PROCS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "debugfs.h"
+
+/* a context needs to be primed then read at least once */
+#define PROCS_SLOT_MIN_SAMPLES	2
+
+/**
+ * procs_ctx:
+ *
+ * A context taking its turn in the rotation. What is read while it is bound
+ * is added to events, once the window ends it is scaled to the whole window
+ * in estimate. Contexts not getting a turn in a window keep the estimate of
+ * the last one they did.
+ */
+struct procs_ctx {
+	uint32_t ctx;
+	uint32_t pid;
+	char *name;
+
+	/* read in the current window, and for how long (ns) */
+	uint64_t *events;
+	uint64_t time_running;
+
+	/* scaled to the window it was last sampled in */
+	uint64_t *estimate;
+	uint64_t time_enabled;
+	uint64_t estimate_running;
+
+	/* windows since it was last sampled */
+	uint32_t age;
+};
+
+/**
+ * procs_proc:
+ *
+ * The sum of the estimates of the contexts of a process.
+ */
+struct procs_proc {
+	uint32_t pid;
+	const char *name;
+	uint32_t nr_ctx;
+
+	uint64_t *events;
+	/* over all its contexts, running below enabled means scaled */
+	uint64_t time_enabled;
+	uint64_t time_running;
+
+	/* where its contexts start in procs::ctxs */
+	size_t first_ctx;
+};
+
+struct procs {
+	uint32_t nr_counters;
+
+	/* sorted by pid then ctx, hence contexts of a process are together */
+	struct procs_ctx *ctxs;
+	size_t nr_ctxs;
+
+	struct procs_proc *procs;
+	size_t nr_procs;
+	size_t procs_size;
+
+	/* processes named so are left out */
+	const char *ignore;
+
+	/* what the contexts have been taken from */
+	uint32_t generation;
+	uint32_t pid;
+	const char *name;
+
+	/* next one to get a turn */
+	size_t next;
+};
+
+/**
+ * procs_init:
+ *
+ * nr_counters is how many counters are gathered per context, contexts of
+ * the processes named ignore are left out.
+ */
+void
+procs_init(struct procs *p, uint32_t nr_counters, const char *ignore);
+
+/**
+ * procs_sync:
+ *
+ * Take the contexts out of the index, only those of pid or of the processes
+ * named name if given, when it changed since. Contexts still there keep
+ * their estimates. Returns -1 if out of memory, the contexts being left
+ * as they were.
+ */
+int
+procs_sync(struct procs *p, const struct debugfs_ctx_index *idx,
+	   uint32_t pid, const char *name);
+
+/**
+ * procs_next:
+ *
+ * The context whose turn it is, NULL if there's none.
+ */
+struct procs_ctx *
+procs_next(struct procs *p);
+
+/**
+ * procs_account:
+ *
+ * Add what has been read in a slot of the context, running being how long
+ * the slot took.
+ */
+void
+procs_account(struct procs *p, struct procs_ctx *c, const uint64_t *events,
+	      uint64_t running);
+
+/**
+ * procs_window:
+ *
+ * Scale what the contexts sampled in the window got to the whole window, then
+ * sum the estimates per process. Returns -1 if out of memory.
+ */
+int
+procs_window(struct procs *p, uint64_t window_ns);
+
+/**
+ * procs_sort:
+ *
+ * Processes with the most events of counter first.
+ */
+void
+procs_sort(struct procs *p, uint32_t counter);
+
+void
+procs_free(struct procs *p);
+
+#endif
@@ -0,0 +1,1546 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "output.h"
+#include "stats.h"
+#include "trace.h"
+#include "report.h"
+
+#define NS_PER_SEC	1000000000.0
+
+/* blocks handed to a worker at a time */
+#define REPORT_JOB_BLOCKS	8
+#define REPORT_MAX_THREADS	64
+
+/* what relative times are relative to */
+enum report_align {
+	REPORT_ALIGN_TIME,	/* start of the recording */
+	REPORT_ALIGN_MARKER,	/* first marked window */
+};
+
+/* outliers are this many standard deviations away from the fleet median */
+#define REPORT_OUTLIER_Z	3.5
+
+struct report_range {
+	uint64_t from;
+	uint64_t to;
+
+	/* what has been touched to answer the query */
+	uint64_t first_block;
+	uint64_t nr_blocks;
+	uint64_t nr_blocks_read;
+
+	uint64_t nr_rows;
+	uint64_t first_ns;
+	uint64_t last_ns;
+};
+
+/*
+ * Per column statistics of an aggregation window. agg holds per recorded
+ * window values: events per second for counters, percentages for occupancy and
+ * DMA states.
+ */
+struct report_stat {
+	struct stats_agg agg;
+	/* scaled events, or samples spent in a state */
+	double total;
+	/* occupancy only */
+	uint64_t buckets[STATS_PERCENT_BUCKETS];
+};
+
+struct report_window {
+	uint64_t nr_rows;
+	uint64_t first_ns;
+	uint64_t last_ns;
+	uint64_t samples;
+	/* time the counter groups have been enabled, indexed by trace_group */
+	uint64_t time_enabled[TRACE_GROUP_PART2 + 1];
+
+	/* nr_columns of them */
+	struct report_stat *stats;
+};
+
+struct report_trace {
+	const char *path;
+	struct trace_reader reader;
+	struct report_range range;
+	/* --from and --to are relative to it */
+	uint64_t origin_ns;
+
+	/* aggregation windows */
+	uint64_t base_ns;
+	uint64_t window_ns;
+	uint32_t nr_windows;
+	struct report_window *windows;
+
+	/* time_enabled and time_running columns of each group */
+	int col_enabled[TRACE_GROUP_PART2 + 1];
+	int col_running[TRACE_GROUP_PART2 + 1];
+
+	/* workers merge their results under it */
+	pthread_mutex_t lock;
+};
+
+struct report_job {
+	struct report_trace *trace;
+	uint64_t first_block;
+	uint64_t nr_blocks;
+};
+
+struct report_pool {
+	pthread_mutex_t lock;
+	struct report_job *jobs;
+	size_t nr_jobs;
+	size_t next_job;
+	int err;
+};
+
+/*
+ * A metric compared across devices: events per second of a counter, mean
+ * busy percentage of a module or mean KiB of a memory type, over the range.
+ */
+struct report_metric {
+	const struct trace_column *col;
+
+	/* one per trace, present telling if the trace has it */
+	double *values;
+	bool *present;
+
+	uint32_t nr_devices;
+	double p50, p95, p99;
+	double min, max;
+	struct stats_spread spread;
+	uint32_t nr_outliers;
+};
+
+struct report_fleet {
+	struct report_trace *traces;
+	int nr_traces;
+	enum report_align align;
+	double threshold;
+
+	struct report_metric *metrics;
+	uint32_t nr_metrics;
+	/* outlying metrics of each trace */
+	uint32_t *nr_outliers;
+};
+
+static void
+report_usage(void)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "  gputop report [options] <trace> [<trace>...]\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  --from, --to  Range, seconds since the start of the recording or since\n");
+	fprintf(stderr, "                the Epoch when prefixed with @\n");
+	fprintf(stderr, "  -w, --window <secs>\n");
+	fprintf(stderr, "                Aggregate over windows of secs, the whole range otherwise\n");
+	fprintf(stderr, "  -j, --threads <nr>\n");
+	fprintf(stderr, "                Worker threads, defaults to the number of CPUs\n");
+	fprintf(stderr, "  -a, --align time|marker\n");
+	fprintf(stderr, "                Relative times count from the start of the recording\n");
+	fprintf(stderr, "                (default) or from the first marker (SIGUSR2)\n");
+	fprintf(stderr, "  -m, --merge   Compare the traces as a fleet of devices: percentiles\n");
+	fprintf(stderr, "                across devices and outlier devices\n");
+	fprintf(stderr, "  -z, --threshold <z>\n");
+	fprintf(stderr, "                Standard deviations from the median making an outlier,\n");
+	fprintf(stderr, "                defaults to %.1f\n", REPORT_OUTLIER_Z);
+	fprintf(stderr, "  --rows        Dump the windows in the range instead\n");
+	fprintf(stderr, "  -F <fmt>      text (default), csv or jsonl\n");
+	fprintf(stderr, "  -h            Show this help message\n");
+}
+
+static double
+report_secs(const struct trace_reader *r, uint64_t ns)
+{
+	return (ns - r->hdr.start_ns) / NS_PER_SEC;
+}
+
+static uint64_t
+report_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Windows in the range. Only the blocks at the edges of the range need to be
+ * looked at, the index tells how many rows the others have.
+ */
+static int
+report_count_range(struct trace_reader *r, struct report_range *range)
+{
+	uint64_t b;
+
+	range->first_block = trace_reader_seek(r, range->from);
+
+	for (b = range->first_block;
+	     b < r->nr_blocks && r->index[b].first_ns <= range->to; b++) {
+		const struct trace_index_entry *entry = &r->index[b];
+
+		range->nr_blocks++;
+
+		if (entry->first_ns >= range->from && entry->last_ns <= range->to) {
+			if (!range->nr_rows)
+				range->first_ns = entry->first_ns;
+			range->last_ns = entry->last_ns;
+			range->nr_rows += entry->nr_rows;
+			continue;
+		}
+
+		if (trace_reader_block(r, b) < 0)
+			return -1;
+		range->nr_blocks_read++;
+
+		for (uint32_t row = 0; row < r->block->nr_rows; row++) {
+			uint64_t ts = trace_value(r, TRACE_COL_TIMESTAMP, row);
+
+			if (ts < range->from || ts > range->to)
+				continue;
+
+			if (!range->nr_rows)
+				range->first_ns = ts;
+			range->last_ns = ts;
+			range->nr_rows++;
+		}
+	}
+
+	return 0;
+}
+
+static void
+report_dump_row(struct output *out, const struct trace_reader *r, uint32_t row)
+{
+	const char *group = NULL;
+
+	output_begin(out, "report", trace_value(r, TRACE_COL_TIMESTAMP, row));
+
+	for (uint32_t c = TRACE_COL_STD_NO; c < r->hdr.nr_columns; c++) {
+		const struct trace_column *col = &r->columns[c];
+		/* DMA states are grouped by their table */
+		const char *name = (col->group == TRACE_GROUP_DMA) ?
+			col->desc : trace_group_name(col->group);
+
+		if (!group || strcmp(group, name)) {
+			if (group)
+				output_group_end(out);
+			output_group_begin(out, name);
+			group = name;
+		}
+
+		output_u64(out, col->name, trace_value(r, c, row));
+	}
+
+	if (group)
+		output_group_end(out);
+
+	output_u64(out, "window_ns", trace_value(r, TRACE_COL_WINDOW, row));
+	output_u64(out, "samples", trace_value(r, TRACE_COL_SAMPLES, row));
+	output_u64(out, "flags", trace_value(r, TRACE_COL_FLAGS, row));
+
+	output_end(out);
+}
+
+static int
+report_dump_range(struct trace_reader *r, const struct report_range *range,
+		  enum output_format format)
+{
+	struct gtop_buf buf;
+	struct output out = {
+		.format = format,
+		.buf = &buf,
+	};
+	uint64_t b;
+
+	if (buf_init(&buf, 64 * 1024) < 0)
+		return -1;
+
+	output_header(&out);
+
+	for (b = range->first_block;
+	     b < r->nr_blocks && r->index[b].first_ns <= range->to; b++) {
+		if (trace_reader_block(r, b) < 0)
+			goto err;
+
+		for (uint32_t row = 0; row < r->block->nr_rows; row++) {
+			uint64_t ts = trace_value(r, TRACE_COL_TIMESTAMP, row);
+
+			if (ts < range->from || ts > range->to)
+				continue;
+
+			report_dump_row(&out, r, row);
+		}
+
+		/* one write per block */
+		if (buf_write(&buf, STDOUT_FILENO) < 0)
+			goto err;
+	}
+
+	buf_free(&buf);
+	return 0;
+
+err:
+	buf_free(&buf);
+	return -1;
+}
+
+static struct report_window *
+report_windows_create(uint32_t nr_windows, uint32_t nr_columns)
+{
+	struct report_window *windows;
+
+	windows = calloc(nr_windows, sizeof(*windows));
+	if (!windows)
+		return NULL;
+
+	for (uint32_t w = 0; w < nr_windows; w++) {
+		windows[w].stats = calloc(nr_columns, sizeof(struct report_stat));
+		if (!windows[w].stats) {
+			while (w--)
+				free(windows[w].stats);
+			free(windows);
+			return NULL;
+		}
+	}
+
+	return windows;
+}
+
+static void
+report_windows_destroy(struct report_window *windows, uint32_t nr_windows)
+{
+	if (!windows)
+		return;
+
+	for (uint32_t w = 0; w < nr_windows; w++)
+		free(windows[w].stats);
+	free(windows);
+}
+
+static void
+report_stat_merge(struct report_stat *dst, const struct report_stat *src)
+{
+	stats_agg_merge(&dst->agg, &src->agg);
+	dst->total += src->total;
+	for (int b = 0; b < STATS_PERCENT_BUCKETS; b++)
+		dst->buckets[b] += src->buckets[b];
+}
+
+static void
+report_windows_merge(struct report_window *dst, const struct report_window *src,
+		     uint32_t nr_columns)
+{
+	if (!src->nr_rows)
+		return;
+
+	if (!dst->nr_rows || src->first_ns < dst->first_ns)
+		dst->first_ns = src->first_ns;
+	if (src->last_ns > dst->last_ns)
+		dst->last_ns = src->last_ns;
+	dst->nr_rows += src->nr_rows;
+	dst->samples += src->samples;
+
+	for (int g = TRACE_GROUP_PART1; g <= TRACE_GROUP_PART2; g++)
+		dst->time_enabled[g] += src->time_enabled[g];
+
+	for (uint32_t c = 0; c < nr_columns; c++)
+		report_stat_merge(&dst->stats[c], &src->stats[c]);
+}
+
+/*
+ * aggregation window of a row, -1 if it's outside the range
+ */
+static int64_t
+report_row_window(const struct report_trace *t, uint64_t ts)
+{
+	uint64_t w;
+
+	if (ts < t->range.from || ts > t->range.to || ts < t->base_ns)
+		return -1;
+
+	w = t->window_ns ? (ts - t->base_ns) / t->window_ns : 0;
+	if (w >= t->nr_windows)
+		return -1;
+
+	return w;
+}
+
+/*
+ * a whole column of the current block
+ */
+static inline const uint64_t *
+report_column(const struct trace_reader *r, uint32_t col)
+{
+	return &r->values[(size_t) col * r->hdr.rows_per_block];
+}
+
+/*
+ * first window marked while recording, 0 if there's none
+ */
+static int
+report_find_marker(struct trace_reader *r, uint64_t *ts)
+{
+	for (uint64_t b = 0; b < r->nr_blocks; b++) {
+		const uint64_t *flags, *timestamps;
+
+		if (trace_reader_block(r, b) < 0)
+			return -1;
+
+		flags = report_column(r, TRACE_COL_FLAGS);
+		timestamps = report_column(r, TRACE_COL_TIMESTAMP);
+
+		for (uint32_t row = 0; row < r->block->nr_rows; row++) {
+			if (flags[row] & TRACE_FLAG_MARKER) {
+				*ts = timestamps[row];
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Aggregate one block into windows, the first of them being first_window. The
+ * block is column-major so go over it one column at a time.
+ */
+static void
+report_block(const struct report_trace *t, const struct trace_reader *r,
+	     struct report_window *windows, uint32_t first_window,
+	     uint32_t nr_windows, int64_t *row_window)
+{
+	const uint64_t *timestamps = report_column(r, TRACE_COL_TIMESTAMP);
+	const uint64_t *samples = report_column(r, TRACE_COL_SAMPLES);
+	uint32_t nr_rows = r->block->nr_rows;
+
+	for (uint32_t row = 0; row < nr_rows; row++) {
+		uint64_t ts = timestamps[row];
+		struct report_window *win;
+
+		row_window[row] = report_row_window(t, ts);
+		if (row_window[row] < 0)
+			continue;
+
+		/* the clock went backwards, can't tell where the row belongs */
+		row_window[row] -= first_window;
+		if (row_window[row] < 0 || row_window[row] >= nr_windows) {
+			row_window[row] = -1;
+			continue;
+		}
+
+		win = &windows[row_window[row]];
+
+		if (!win->nr_rows || ts < win->first_ns)
+			win->first_ns = ts;
+		if (ts > win->last_ns)
+			win->last_ns = ts;
+		win->nr_rows++;
+		win->samples += samples[row];
+
+		for (int g = TRACE_GROUP_PART1; g <= TRACE_GROUP_PART2; g++)
+			if (t->col_enabled[g] >= 0)
+				win->time_enabled[g] +=
+					report_column(r, t->col_enabled[g])[row];
+	}
+
+	for (uint32_t c = TRACE_COL_STD_NO; c < r->hdr.nr_columns; c++) {
+		const struct trace_column *col = &r->columns[c];
+		const uint64_t *values = report_column(r, c);
+		const uint64_t *enabled = NULL, *running = NULL;
+		struct report_stat stat = {};
+		int64_t w = -1;
+
+		if (col->group == TRACE_GROUP_PART1 || col->group == TRACE_GROUP_PART2) {
+			if (col->id >= TRACE_ID_TIME_ENABLED ||
+			    t->col_enabled[col->group] < 0 ||
+			    t->col_running[col->group] < 0)
+				continue;
+
+			enabled = report_column(r, t->col_enabled[col->group]);
+			running = report_column(r, t->col_running[col->group]);
+		}
+
+		/* rows of a block mostly end up in the same window, keep it local */
+		for (uint32_t row = 0; row < nr_rows; row++) {
+			double percent;
+			uint64_t events;
+
+			if (row_window[row] < 0)
+				continue;
+
+			if (row_window[row] != w) {
+				if (w >= 0)
+					report_stat_merge(&windows[w].stats[c], &stat);
+				memset(&stat, 0, sizeof(stat));
+				w = row_window[row];
+			}
+
+			switch (col->group) {
+			case TRACE_GROUP_PART1:
+			case TRACE_GROUP_PART2:
+				/* the same scaling as the live view */
+				events = stats_mux_scale(values[row], enabled[row], running[row]);
+				stat.total += events;
+				if (enabled[row])
+					stats_agg_add(&stat.agg, stats_rate(events, RATE_SECOND,
+									    enabled[row], 0));
+				break;
+			case TRACE_GROUP_OCCUPANCY:
+				percent = samples[row] ? 100.0 * values[row] / samples[row] : 0.0;
+				stats_agg_add(&stat.agg, percent);
+				stats_percent_bucket(stat.buckets, percent);
+				break;
+			case TRACE_GROUP_DMA:
+				stat.total += values[row];
+				stats_agg_add(&stat.agg, samples[row] ?
+					      100.0 * values[row] / samples[row] : 0.0);
+				break;
+			case TRACE_GROUP_MEMORY:
+				stats_agg_add(&stat.agg, values[row]);
+				break;
+			default:
+				break;
+			}
+		}
+
+		if (w >= 0)
+			report_stat_merge(&windows[w].stats[c], &stat);
+	}
+}
+
+static int
+report_job_run(const struct report_job *job, int64_t *row_window)
+{
+	struct report_trace *t = job->trace;
+	struct trace_reader r = t->reader;
+	const struct trace_index_entry *index = r.index;
+	uint64_t last = job->first_block + job->nr_blocks - 1;
+	int64_t first_window, last_window;
+	struct report_window *windows;
+	uint32_t nr_windows;
+	int err = 0;
+
+	/* windows the job can touch, out of the index */
+	first_window = report_row_window(t, index[job->first_block].first_ns < t->base_ns ?
+					 t->base_ns : index[job->first_block].first_ns);
+	if (first_window < 0)
+		first_window = 0;
+	last_window = report_row_window(t, index[last].last_ns > t->range.to ?
+					t->range.to : index[last].last_ns);
+	if (last_window < 0)
+		last_window = t->nr_windows - 1;
+	if (last_window < first_window)
+		return 0;
+
+	nr_windows = last_window - first_window + 1;
+	windows = report_windows_create(nr_windows, r.hdr.nr_columns);
+	if (!windows)
+		return -1;
+
+	for (uint64_t b = job->first_block; b <= last; b++) {
+		if (trace_reader_block(&r, b) < 0) {
+			err = -1;
+			break;
+		}
+		report_block(t, &r, windows, first_window, nr_windows, row_window);
+	}
+
+	if (!err) {
+		pthread_mutex_lock(&t->lock);
+		for (uint32_t w = 0; w < nr_windows; w++)
+			report_windows_merge(&t->windows[first_window + w], &windows[w],
+					     r.hdr.nr_columns);
+		pthread_mutex_unlock(&t->lock);
+	}
+
+	report_windows_destroy(windows, nr_windows);
+	return err;
+}
+
+static void *
+report_worker(void *data)
+{
+	struct report_pool *pool = data;
+	int64_t *row_window = NULL;
+	uint32_t row_window_size = 0;
+
+	while (1) {
+		struct report_job *job;
+		uint32_t rows;
+
+		pthread_mutex_lock(&pool->lock);
+		if (pool->err || pool->next_job == pool->nr_jobs) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		job = &pool->jobs[pool->next_job++];
+		pthread_mutex_unlock(&pool->lock);
+
+		rows = job->trace->reader.hdr.rows_per_block;
+		if (rows > row_window_size) {
+			int64_t *tmp = realloc(row_window, rows * sizeof(*row_window));
+			if (!tmp)
+				goto err;
+			row_window = tmp;
+			row_window_size = rows;
+		}
+
+		if (report_job_run(job, row_window) < 0)
+			goto err;
+	}
+
+	free(row_window);
+	return NULL;
+
+err:
+	pthread_mutex_lock(&pool->lock);
+	pool->err = -1;
+	pthread_mutex_unlock(&pool->lock);
+
+	free(row_window);
+	return NULL;
+}
+
+/*
+ * split the blocks of the range of every trace into jobs and let the workers
+ * loose on them
+ */
+static int
+report_aggregate(struct report_trace *traces, int nr_traces, int nr_threads)
+{
+	struct report_pool pool = {};
+	pthread_t threads[REPORT_MAX_THREADS];
+	size_t nr_jobs = 0;
+	int started = 0;
+
+	for (int i = 0; i < nr_traces; i++)
+		nr_jobs += (traces[i].range.nr_blocks + REPORT_JOB_BLOCKS - 1) /
+			REPORT_JOB_BLOCKS;
+
+	if (!nr_jobs)
+		return 0;
+
+	pool.jobs = calloc(nr_jobs, sizeof(*pool.jobs));
+	if (!pool.jobs)
+		return -1;
+
+	for (int i = 0; i < nr_traces; i++) {
+		struct report_trace *t = &traces[i];
+		uint64_t end = t->range.first_block + t->range.nr_blocks;
+
+		for (uint64_t b = t->range.first_block; b < end; b += REPORT_JOB_BLOCKS) {
+			struct report_job *job = &pool.jobs[pool.nr_jobs++];
+
+			job->trace = t;
+			job->first_block = b;
+			job->nr_blocks = (end - b < REPORT_JOB_BLOCKS) ?
+				end - b : REPORT_JOB_BLOCKS;
+		}
+	}
+
+	pthread_mutex_init(&pool.lock, NULL);
+
+	if ((size_t) nr_threads > nr_jobs)
+		nr_threads = nr_jobs;
+
+	for (started = 0; started < nr_threads; started++)
+		if (pthread_create(&threads[started], NULL, report_worker, &pool))
+			break;
+
+	/* do it ourselves if we couldn't start any thread */
+	if (!started)
+		report_worker(&pool);
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+	free(pool.jobs);
+
+	return pool.err;
+}
+
+static void
+report_display_summary(const struct report_trace *t)
+{
+	const struct trace_reader *r = &t->reader;
+	const struct trace_chip *chip = &r->hdr.chip;
+	const struct report_range *range = &t->range;
+	uint64_t nr_rows = 0;
+
+	for (uint64_t b = 0; b < r->nr_blocks; b++)
+		nr_rows += r->index[b].nr_rows;
+
+	fprintf(stdout, "Trace:    %s (version %u, %zu bytes%s)\n", t->path,
+			r->hdr.version, r->size,
+			r->index_rebuilt ? ", index rebuilt" : "");
+	fprintf(stdout, "Chip:     GC%x Rev:%x, 3D Cores:%u,2D Cores:%u,VG Cores:%u\n",
+			chip->model, chip->revision,
+			chip->cores[0], chip->cores[1], chip->cores[2]);
+	fprintf(stdout, "Galcore:  %d.%d.%d.%d\n", chip->drv_major,
+			chip->drv_minor, chip->drv_patch, chip->drv_build);
+
+	if (r->nr_blocks)
+		fprintf(stdout, "Recorded: %.3f - %.3f secs, %" PRIu64 " windows in %"
+				PRIu64 " blocks\n",
+				report_secs(r, r->index[0].first_ns),
+				report_secs(r, r->index[r->nr_blocks - 1].last_ns),
+				nr_rows, r->nr_blocks);
+
+	if (range->nr_rows)
+		fprintf(stdout, "Range:    %.3f - %.3f secs, %" PRIu64 " windows in %"
+				PRIu64 " blocks\n",
+				report_secs(r, range->first_ns),
+				report_secs(r, range->last_ns), range->nr_rows,
+				range->nr_blocks);
+	else
+		fprintf(stdout, "Range:    no windows\n");
+}
+
+static void
+report_display_window(const struct report_trace *t, const struct report_window *win)
+{
+	const struct trace_reader *r = &t->reader;
+	const char *table = NULL;
+	int group = -1;
+
+	fprintf(stdout, "\nWindow %.3f - %.3f secs, %" PRIu64 " windows\n",
+			report_secs(r, win->first_ns), report_secs(r, win->last_ns),
+			win->nr_rows);
+
+	for (uint32_t c = TRACE_COL_STD_NO; c < r->hdr.nr_columns; c++) {
+		const struct trace_column *col = &r->columns[c];
+		const struct report_stat *stat = &win->stats[c];
+
+		if ((col->group == TRACE_GROUP_PART1 || col->group == TRACE_GROUP_PART2) &&
+		    col->id >= TRACE_ID_TIME_ENABLED)
+			continue;
+
+		if ((int) col->group != group) {
+			group = col->group;
+
+			switch (col->group) {
+			case TRACE_GROUP_PART1:
+			case TRACE_GROUP_PART2:
+				fprintf(stdout, "%-40s %16s %14s %14s %14s\n",
+						col->group == TRACE_GROUP_PART1 ?
+						"PART1" : "PART2",
+						"total", "mean/s", "min/s", "max/s");
+				break;
+			case TRACE_GROUP_OCCUPANCY:
+				fprintf(stdout, "%-40s %7s %7s %7s  %s\n", "Occupancy (busy %)",
+						"mean", "min", "max",
+						"windows per 10% bucket (%)");
+				break;
+			case TRACE_GROUP_DMA:
+				fprintf(stdout, "DMA states (%% of samples)");
+				break;
+			case TRACE_GROUP_MEMORY:
+				fprintf(stdout, "%s%-40s %14s %14s %14s\n",
+						table ? "\n" : "", "Memory (KiB)",
+						"mean", "min", "max");
+				/* the DMA states line has been ended */
+				table = NULL;
+				break;
+			default:
+				break;
+			}
+		}
+
+		switch (col->group) {
+		case TRACE_GROUP_PART1:
+		case TRACE_GROUP_PART2:
+			fprintf(stdout, "  %-38.38s %16.0f %14.0f %14.0f %14.0f\n",
+					col->name, stat->total, stats_agg_mean(&stat->agg),
+					stat->agg.min, stat->agg.max);
+			break;
+		case TRACE_GROUP_OCCUPANCY:
+			fprintf(stdout, "  %-38.38s %7.2f %7.2f %7.2f ", col->desc,
+					stats_agg_mean(&stat->agg), stat->agg.min,
+					stat->agg.max);
+			for (int b = 0; b < STATS_PERCENT_BUCKETS; b++)
+				fprintf(stdout, " %3.0f", stat->agg.n ?
+						100.0 * stat->buckets[b] / stat->agg.n : 0.0);
+			fprintf(stdout, "\n");
+			break;
+		case TRACE_GROUP_DMA:
+			if (!table || strcmp(table, col->desc)) {
+				table = col->desc;
+				fprintf(stdout, "\n  %s:", table);
+			}
+			/* only the states we've been in */
+			if (stat->total)
+				fprintf(stdout, " %s %.2f%%", col->name,
+						100.0 * stat->total / win->samples);
+			break;
+		case TRACE_GROUP_MEMORY:
+			fprintf(stdout, "  %-38.38s %14.0f %14.0f %14.0f\n", col->name,
+					stats_agg_mean(&stat->agg), stat->agg.min,
+					stat->agg.max);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (table)
+		fprintf(stdout, "\n");
+}
+
+static void
+report_output_window(struct output *out, const struct report_trace *t,
+		     const struct report_window *win)
+{
+	const struct trace_reader *r = &t->reader;
+	const char *group = NULL;
+	char bucket[8];
+
+	output_begin(out, "report", win->first_ns);
+	output_str(out, "trace", t->path);
+	output_u64(out, "last_ns", win->last_ns);
+	output_u64(out, "windows", win->nr_rows);
+
+	for (uint32_t c = TRACE_COL_STD_NO; c < r->hdr.nr_columns; c++) {
+		const struct trace_column *col = &r->columns[c];
+		const struct report_stat *stat = &win->stats[c];
+		const char *name = (col->group == TRACE_GROUP_DMA) ?
+			col->desc : trace_group_name(col->group);
+
+		if ((col->group == TRACE_GROUP_PART1 || col->group == TRACE_GROUP_PART2) &&
+		    col->id >= TRACE_ID_TIME_ENABLED)
+			continue;
+
+		if (!group || strcmp(group, name)) {
+			if (group)
+				output_group_end(out);
+			output_group_begin(out, name);
+			group = name;
+		}
+
+		switch (col->group) {
+		case TRACE_GROUP_PART1:
+		case TRACE_GROUP_PART2:
+			output_group_begin(out, col->name);
+			output_fixed(out, "total", stat->total);
+			output_fixed(out, "mean_per_sec", stats_agg_mean(&stat->agg));
+			output_fixed(out, "min_per_sec", stat->agg.min);
+			output_fixed(out, "max_per_sec", stat->agg.max);
+			output_group_end(out);
+			break;
+		case TRACE_GROUP_OCCUPANCY:
+			output_group_begin(out, col->name);
+			output_fixed(out, "mean", stats_agg_mean(&stat->agg));
+			output_fixed(out, "min", stat->agg.min);
+			output_fixed(out, "max", stat->agg.max);
+			for (int b = 0; b < STATS_PERCENT_BUCKETS; b++) {
+				snprintf(bucket, sizeof(bucket), "p%d",
+					 b * (100 / STATS_PERCENT_BUCKETS));
+				output_u64(out, bucket, stat->buckets[b]);
+			}
+			output_group_end(out);
+			break;
+		case TRACE_GROUP_DMA:
+			output_fixed(out, col->name, win->samples ?
+				     100.0 * stat->total / win->samples : 0.0);
+			break;
+		case TRACE_GROUP_MEMORY:
+			output_group_begin(out, col->name);
+			output_fixed(out, "mean", stats_agg_mean(&stat->agg));
+			output_fixed(out, "min", stat->agg.min);
+			output_fixed(out, "max", stat->agg.max);
+			output_group_end(out);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (group)
+		output_group_end(out);
+
+	output_end(out);
+}
+
+static uint64_t
+report_time_ns(uint64_t origin, const struct trace_time *t, uint64_t def)
+{
+	if (!t->set)
+		return def;
+
+	return t->absolute ? t->ns : origin + t->ns;
+}
+
+static int
+report_trace_open(struct report_trace *t, const char *path,
+		  const struct trace_time *from, const struct trace_time *to,
+		  uint64_t window_ns, enum report_align align)
+{
+	struct trace_reader *r = &t->reader;
+	uint64_t end;
+	int err;
+
+	t->path = path;
+	if (trace_reader_open(r, path) < 0) {
+		fprintf(stderr, "Failed to open trace %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	pthread_mutex_init(&t->lock, NULL);
+
+	t->origin_ns = r->hdr.start_ns;
+	if (align == REPORT_ALIGN_MARKER) {
+		err = report_find_marker(r, &t->origin_ns);
+		if (err < 0) {
+			fprintf(stderr, "Failed to read trace %s: %s\n", path,
+					strerror(errno));
+			return -1;
+		}
+		if (!err) {
+			fprintf(stderr, "No marker in trace %s\n", path);
+			return -1;
+		}
+	}
+
+	/* aligned on a marker, the range starts with it */
+	t->range.from = report_time_ns(t->origin_ns, from,
+				       align == REPORT_ALIGN_MARKER ? t->origin_ns : 0);
+	t->range.to = report_time_ns(t->origin_ns, to, UINT64_MAX);
+	if (report_count_range(r, &t->range) < 0) {
+		fprintf(stderr, "Failed to read trace %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	for (int g = TRACE_GROUP_PART1; g <= TRACE_GROUP_PART2; g++) {
+		t->col_enabled[g] = trace_find_column(&r->hdr, r->columns, g,
+						      TRACE_ID_TIME_ENABLED);
+		t->col_running[g] = trace_find_column(&r->hdr, r->columns, g,
+						      TRACE_ID_TIME_RUNNING);
+	}
+
+	/* windows start with the range, or with the recording */
+	t->base_ns = (from->set || align == REPORT_ALIGN_MARKER) ?
+		t->range.from : t->range.first_ns;
+	t->window_ns = window_ns;
+	end = t->range.last_ns;
+
+	t->nr_windows = 1;
+	if (window_ns && end > t->base_ns)
+		t->nr_windows = (end - t->base_ns) / window_ns + 1;
+
+	t->windows = report_windows_create(t->nr_windows, r->hdr.nr_columns);
+	if (!t->windows) {
+		fprintf(stderr, "malloc?\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Only traces of the same GPU running the same driver can be compared.
+ */
+static int
+report_fleet_check(const struct report_trace *traces, int nr_traces)
+{
+	const struct trace_chip *ref = &traces[0].reader.hdr.chip;
+
+	for (int i = 1; i < nr_traces; i++) {
+		const struct trace_chip *chip = &traces[i].reader.hdr.chip;
+
+		if (chip->model == ref->model && chip->revision == ref->revision &&
+		    !memcmp(chip->cores, ref->cores, sizeof(ref->cores)) &&
+		    chip->drv_major == ref->drv_major &&
+		    chip->drv_minor == ref->drv_minor &&
+		    chip->drv_patch == ref->drv_patch &&
+		    chip->drv_build == ref->drv_build)
+			continue;
+
+		fprintf(stderr, "%s: GC%x Rev:%x (%u/%u/%u cores), Galcore %d.%d.%d.%d\n",
+				traces[i].path, chip->model, chip->revision,
+				chip->cores[0], chip->cores[1], chip->cores[2],
+				chip->drv_major, chip->drv_minor, chip->drv_patch,
+				chip->drv_build);
+		fprintf(stderr, "%s: GC%x Rev:%x (%u/%u/%u cores), Galcore %d.%d.%d.%d\n",
+				traces[0].path, ref->model, ref->revision,
+				ref->cores[0], ref->cores[1], ref->cores[2],
+				ref->drv_major, ref->drv_minor, ref->drv_patch,
+				ref->drv_build);
+		fprintf(stderr, "Refusing to merge traces of different hardware\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * the value a device contributes to a metric, over the whole range
+ */
+static bool
+report_fleet_value(const struct report_trace *t, const struct report_metric *m,
+		   double *value)
+{
+	const struct trace_reader *r = &t->reader;
+	const struct report_window *win = &t->windows[0];
+	const struct report_stat *stat;
+	int c;
+
+	c = trace_find_column(&r->hdr, r->columns, m->col->group, m->col->id);
+	if (c < 0 || strcmp(r->columns[c].name, m->col->name) || !win->nr_rows)
+		return false;
+
+	stat = &win->stats[c];
+
+	switch (m->col->group) {
+	case TRACE_GROUP_PART1:
+	case TRACE_GROUP_PART2:
+		if (!win->time_enabled[m->col->group])
+			return false;
+		*value = stat->total * NS_PER_SEC / win->time_enabled[m->col->group];
+		return true;
+	case TRACE_GROUP_OCCUPANCY:
+	case TRACE_GROUP_MEMORY:
+		if (!stat->agg.n)
+			return false;
+		*value = stats_agg_mean(&stat->agg);
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool
+report_fleet_outlier(const struct report_fleet *fleet,
+		     const struct report_metric *m, int i, double *z)
+{
+	/* nothing stands out of two devices */
+	if (!m->present[i] || m->nr_devices < 3)
+		return false;
+
+	*z = stats_robust_z(&m->spread, m->values[i]);
+	return *z > fleet->threshold || *z < -fleet->threshold;
+}
+
+static void
+report_fleet_destroy(struct report_fleet *fleet)
+{
+	for (uint32_t i = 0; i < fleet->nr_metrics; i++) {
+		free(fleet->metrics[i].values);
+		free(fleet->metrics[i].present);
+	}
+
+	free(fleet->metrics);
+	free(fleet->nr_outliers);
+}
+
+/*
+ * Metrics are the columns of the first trace, looked up by group, id and name
+ * in the others.
+ */
+static int
+report_fleet_create(struct report_fleet *fleet)
+{
+	const struct trace_reader *ref = &fleet->traces[0].reader;
+	int nr_traces = fleet->nr_traces;
+	double *sorted, *tmp;
+
+	fleet->metrics = calloc(ref->hdr.nr_columns, sizeof(*fleet->metrics));
+	fleet->nr_outliers = calloc(nr_traces, sizeof(*fleet->nr_outliers));
+	sorted = calloc(nr_traces, sizeof(*sorted));
+	tmp = calloc(nr_traces, sizeof(*tmp));
+	if (!fleet->metrics || !fleet->nr_outliers || !sorted || !tmp)
+		goto err;
+
+	for (uint32_t c = TRACE_COL_STD_NO; c < ref->hdr.nr_columns; c++) {
+		const struct trace_column *col = &ref->columns[c];
+		struct report_metric *m;
+		uint32_t n = 0;
+
+		switch (col->group) {
+		case TRACE_GROUP_PART1:
+		case TRACE_GROUP_PART2:
+			if (col->id >= TRACE_ID_TIME_ENABLED)
+				continue;
+			break;
+		case TRACE_GROUP_OCCUPANCY:
+		case TRACE_GROUP_MEMORY:
+			break;
+		default:
+			continue;
+		}
+
+		m = &fleet->metrics[fleet->nr_metrics++];
+		m->col = col;
+		m->values = calloc(nr_traces, sizeof(*m->values));
+		m->present = calloc(nr_traces, sizeof(*m->present));
+		if (!m->values || !m->present)
+			goto err;
+
+		for (int i = 0; i < nr_traces; i++) {
+			m->present[i] = report_fleet_value(&fleet->traces[i], m,
+							   &m->values[i]);
+			if (m->present[i])
+				sorted[n++] = m->values[i];
+		}
+
+		m->nr_devices = n;
+		if (!n)
+			continue;
+
+		stats_sort(sorted, n);
+		m->p50 = stats_percentile(sorted, n, 50.0);
+		m->p95 = stats_percentile(sorted, n, 95.0);
+		m->p99 = stats_percentile(sorted, n, 99.0);
+		m->min = sorted[0];
+		m->max = sorted[n - 1];
+		stats_spread(sorted, n, tmp, &m->spread);
+
+		for (int i = 0; i < nr_traces; i++) {
+			double z;
+
+			if (report_fleet_outlier(fleet, m, i, &z)) {
+				m->nr_outliers++;
+				fleet->nr_outliers[i]++;
+			}
+		}
+	}
+
+	free(sorted);
+	free(tmp);
+	return 0;
+
+err:
+	free(sorted);
+	free(tmp);
+	return -1;
+}
+
+static const char *
+report_metric_label(const struct report_metric *m)
+{
+	/* module names are in the descriptions */
+	return m->col->group == TRACE_GROUP_OCCUPANCY ? m->col->desc : m->col->name;
+}
+
+static void
+report_fleet_display(const struct report_fleet *fleet)
+{
+	const struct trace_chip *chip = &fleet->traces[0].reader.hdr.chip;
+	int group = -1;
+	bool outliers = false;
+
+	fprintf(stdout, "Fleet:    %d traces, GC%x Rev:%x, Galcore %d.%d.%d.%d\n",
+			fleet->nr_traces, chip->model, chip->revision,
+			chip->drv_major, chip->drv_minor, chip->drv_patch,
+			chip->drv_build);
+	fprintf(stdout, "Aligned:  on the %s\n", fleet->align == REPORT_ALIGN_MARKER ?
+			"first marker" : "start of the recordings");
+
+	for (int i = 0; i < fleet->nr_traces; i++) {
+		const struct report_trace *t = &fleet->traces[i];
+		const struct report_range *range = &t->range;
+
+		if (range->nr_rows)
+			fprintf(stdout, "  %-38.38s %8" PRIu64 " windows, %.3f - %.3f secs, "
+					"%u outlying\n", t->path, range->nr_rows,
+					(range->first_ns - t->origin_ns) / NS_PER_SEC,
+					(range->last_ns - t->origin_ns) / NS_PER_SEC,
+					fleet->nr_outliers[i]);
+		else
+			fprintf(stdout, "  %-38.38s no windows\n", t->path);
+	}
+
+	for (uint32_t i = 0; i < fleet->nr_metrics; i++) {
+		const struct report_metric *m = &fleet->metrics[i];
+		int prec = (m->col->group == TRACE_GROUP_OCCUPANCY) ? 2 : 0;
+
+		if ((int) m->col->group != group) {
+			const char *title = NULL;
+
+			group = m->col->group;
+			switch (group) {
+			case TRACE_GROUP_PART1:
+				title = "PART1 (events/s)";
+				break;
+			case TRACE_GROUP_PART2:
+				title = "PART2 (events/s)";
+				break;
+			case TRACE_GROUP_OCCUPANCY:
+				title = "Occupancy (busy %)";
+				break;
+			case TRACE_GROUP_MEMORY:
+				title = "Memory (KiB)";
+				break;
+			}
+
+			fprintf(stdout, "\n%-40s %7s %12s %12s %12s %12s %12s %8s\n",
+					title, "devices", "P50", "P95", "P99", "min",
+					"max", "outliers");
+		}
+
+		fprintf(stdout, "  %-38.38s %7u %12.*f %12.*f %12.*f %12.*f %12.*f %8u\n",
+				report_metric_label(m), m->nr_devices,
+				prec, m->p50, prec, m->p95, prec, m->p99,
+				prec, m->min, prec, m->max, m->nr_outliers);
+	}
+
+	for (int i = 0; i < fleet->nr_traces; i++) {
+		if (!fleet->nr_outliers[i])
+			continue;
+
+		if (!outliers) {
+			fprintf(stdout, "\nOutliers (more than %.1f standard deviations "
+					"from the median)\n", fleet->threshold);
+			outliers = true;
+		}
+
+		fprintf(stdout, "  %s\n", fleet->traces[i].path);
+		for (uint32_t j = 0; j < fleet->nr_metrics; j++) {
+			const struct report_metric *m = &fleet->metrics[j];
+			double z;
+
+			if (!report_fleet_outlier(fleet, m, i, &z))
+				continue;
+
+			fprintf(stdout, "    %-9s %-38.38s %14.2f  median %14.2f  z %+8.2f\n",
+					trace_group_name(m->col->group),
+					report_metric_label(m), m->values[i],
+					m->spread.median, z);
+		}
+	}
+}
+
+static void
+report_fleet_output(struct output *out, const struct report_fleet *fleet)
+{
+	const char *group = NULL;
+	uint64_t first_ns = 0;
+
+	for (int i = 0; i < fleet->nr_traces; i++) {
+		const struct report_range *range = &fleet->traces[i].range;
+
+		if (range->nr_rows && (!first_ns || range->first_ns < first_ns))
+			first_ns = range->first_ns;
+	}
+
+	output_begin(out, "fleet", first_ns);
+	output_u64(out, "devices", fleet->nr_traces);
+	output_str(out, "align", fleet->align == REPORT_ALIGN_MARKER ?
+		   "marker" : "time");
+
+	for (uint32_t i = 0; i < fleet->nr_metrics; i++) {
+		const struct report_metric *m = &fleet->metrics[i];
+		const char *name = trace_group_name(m->col->group);
+
+		if (!group || strcmp(group, name)) {
+			if (group)
+				output_group_end(out);
+			output_group_begin(out, name);
+			group = name;
+		}
+
+		output_group_begin(out, m->col->name);
+		output_u64(out, "devices", m->nr_devices);
+		output_fixed(out, "p50", m->p50);
+		output_fixed(out, "p95", m->p95);
+		output_fixed(out, "p99", m->p99);
+		output_fixed(out, "min", m->min);
+		output_fixed(out, "max", m->max);
+		output_u64(out, "outliers", m->nr_outliers);
+		output_group_end(out);
+	}
+
+	if (group)
+		output_group_end(out);
+
+	/* z-score of every outlying metric of every device */
+	output_group_begin(out, "outliers");
+	for (int i = 0; i < fleet->nr_traces; i++) {
+		if (!fleet->nr_outliers[i])
+			continue;
+
+		output_group_begin(out, fleet->traces[i].path);
+		group = NULL;
+
+		for (uint32_t j = 0; j < fleet->nr_metrics; j++) {
+			const struct report_metric *m = &fleet->metrics[j];
+			const char *name = trace_group_name(m->col->group);
+			double z;
+
+			if (!report_fleet_outlier(fleet, m, i, &z))
+				continue;
+
+			if (!group || strcmp(group, name)) {
+				if (group)
+					output_group_end(out);
+				output_group_begin(out, name);
+				group = name;
+			}
+
+			output_fixed(out, m->col->name, z);
+		}
+
+		if (group)
+			output_group_end(out);
+		output_group_end(out);
+	}
+	output_group_end(out);
+
+	output_end(out);
+}
+
+static void
+report_trace_close(struct report_trace *t)
+{
+	report_windows_destroy(t->windows, t->nr_windows);
+	t->windows = NULL;
+
+	if (t->reader.map) {
+		trace_reader_close(&t->reader);
+		pthread_mutex_destroy(&t->lock);
+	}
+}
+
+int
+report_main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{ "from",	required_argument,	NULL, 'f' },
+		{ "to",		required_argument,	NULL, 't' },
+		{ "window",	required_argument,	NULL, 'w' },
+		{ "threads",	required_argument,	NULL, 'j' },
+		{ "align",	required_argument,	NULL, 'a' },
+		{ "merge",	no_argument,		NULL, 'm' },
+		{ "threshold",	required_argument,	NULL, 'z' },
+		{ "rows",	no_argument,		NULL, 'r' },
+		{ "format",	required_argument,	NULL, 'F' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL,		0,			NULL, 0 },
+	};
+	struct trace_time from = {}, to = {}, window = {};
+	enum output_format format = OUTPUT_TEXT;
+	enum report_align align = REPORT_ALIGN_TIME;
+	struct report_fleet fleet = {
+		.threshold = REPORT_OUTLIER_Z,
+	};
+	struct report_trace *traces;
+	int nr_traces, nr_threads;
+	bool rows = false, merge = false;
+	uint64_t start;
+	int c, err = 0;
+	char *end;
+
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((c = getopt_long(argc, argv, "f:t:w:j:a:mz:rF:h", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+		case 't':
+			if (trace_parse_time(optarg, c == 'f' ? &from : &to) < 0) {
+				fprintf(stderr, "Invalid time %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'w':
+			if (trace_parse_time(optarg, &window) < 0 || window.absolute) {
+				fprintf(stderr, "Invalid window %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'j':
+			nr_threads = strtol(optarg, &end, 10);
+			if (*end || nr_threads < 1) {
+				fprintf(stderr, "Invalid number of threads %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'a':
+			if (!strcmp(optarg, "time")) {
+				align = REPORT_ALIGN_TIME;
+			} else if (!strcmp(optarg, "marker")) {
+				align = REPORT_ALIGN_MARKER;
+			} else {
+				fprintf(stderr, "Unknown alignment %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'm':
+			merge = true;
+			break;
+		case 'z':
+			fleet.threshold = strtod(optarg, &end);
+			if (*end || end == optarg || fleet.threshold <= 0.0) {
+				fprintf(stderr, "Invalid threshold %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			rows = true;
+			break;
+		case 'F':
+			if (output_parse_format(optarg, &format) < 0) {
+				fprintf(stderr, "Unknown format %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'h':
+		default:
+			report_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	nr_traces = argc - optind;
+	if (nr_traces < 1 || (rows && nr_traces != 1)) {
+		report_usage();
+		return EXIT_FAILURE;
+	}
+
+	/* devices are compared over the whole range */
+	if (merge && (rows || window.ns || nr_traces < 2)) {
+		fprintf(stderr, "--merge takes at least two traces, and no --rows or --window\n");
+		return EXIT_FAILURE;
+	}
+
+	if (nr_threads < 1)
+		nr_threads = 1;
+	if (nr_threads > REPORT_MAX_THREADS)
+		nr_threads = REPORT_MAX_THREADS;
+
+	traces = calloc(nr_traces, sizeof(*traces));
+	if (!traces) {
+		fprintf(stderr, "malloc?\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < nr_traces && !err; i++)
+		err = report_trace_open(&traces[i], argv[optind + i], &from, &to,
+					window.ns, align);
+	if (err)
+		goto out;
+
+	if (merge && report_fleet_check(traces, nr_traces) < 0) {
+		err = -1;
+		goto out;
+	}
+
+	if (rows) {
+		err = report_dump_range(&traces[0].reader, &traces[0].range,
+					format == OUTPUT_TEXT ? OUTPUT_CSV : format);
+		if (err < 0)
+			fprintf(stderr, "Failed to read trace %s: %s\n",
+					traces[0].path, strerror(errno));
+		goto out;
+	}
+
+	start = report_now_ns();
+	err = report_aggregate(traces, nr_traces, nr_threads);
+	if (err < 0) {
+		fprintf(stderr, "Failed to aggregate traces: %s\n", strerror(errno));
+		goto out;
+	}
+
+	if (merge) {
+		fleet.traces = traces;
+		fleet.nr_traces = nr_traces;
+		fleet.align = align;
+
+		err = report_fleet_create(&fleet);
+		if (err < 0) {
+			fprintf(stderr, "malloc?\n");
+			goto out;
+		}
+	}
+
+	if (format == OUTPUT_TEXT) {
+		if (merge) {
+			report_fleet_display(&fleet);
+			fprintf(stdout, "\n");
+		}
+
+		for (int i = 0; i < nr_traces && !merge; i++) {
+			report_display_summary(&traces[i]);
+
+			for (uint32_t w = 0; w < traces[i].nr_windows; w++)
+				if (traces[i].windows[w].nr_rows)
+					report_display_window(&traces[i], &traces[i].windows[w]);
+
+			fprintf(stdout, "\n");
+		}
+
+		fprintf(stdout, "Report:   %d threads, %.3f msecs\n", nr_threads,
+				(report_now_ns() - start) / 1000000.0);
+	} else {
+		struct gtop_buf buf;
+		struct output out = {
+			.format = format,
+			.buf = &buf,
+		};
+
+		if (buf_init(&buf, 64 * 1024) < 0) {
+			fprintf(stderr, "malloc?\n");
+			err = -1;
+			goto out;
+		}
+
+		output_header(&out);
+		if (merge) {
+			report_fleet_output(&out, &fleet);
+			if (buf_write(&buf, STDOUT_FILENO) < 0)
+				err = -1;
+		}
+
+		for (int i = 0; i < nr_traces && !merge; i++) {
+			for (uint32_t w = 0; w < traces[i].nr_windows; w++) {
+				if (!traces[i].windows[w].nr_rows)
+					continue;
+
+				report_output_window(&out, &traces[i], &traces[i].windows[w]);
+				if (buf_write(&buf, STDOUT_FILENO) < 0)
+					err = -1;
+			}
+		}
+
+		buf_free(&buf);
+	}
+
+out:
+	report_fleet_destroy(&fleet);
+	for (int i = 0; i < nr_traces; i++)
+		report_trace_close(&traces[i]);
+	free(traces);
+
+	return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
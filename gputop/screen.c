@@ -0,0 +1,442 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "fmt.h"
+#include "screen.h"
+
+#define ESC	0x1b
+
+int
+screen_init(struct screen *s, bool grid, int rows, int cols)
+{
+	memset(s, 0, sizeof(*s));
+
+	s->grid = grid;
+	if (buf_init(&s->text, 16 * 1024) < 0 || buf_init(&s->out, 16 * 1024) < 0) {
+		buf_free(&s->text);
+		return -1;
+	}
+
+	if (grid)
+		return screen_resize(s, rows, cols);
+
+	return 0;
+}
+
+int
+screen_resize(struct screen *s, int rows, int cols)
+{
+	struct screen_cell *cells, *prev;
+	size_t nr;
+
+	if (!s->grid)
+		return 0;
+
+	if (rows < 1)
+		rows = 1;
+	if (cols < 1)
+		cols = 1;
+	nr = (size_t) rows * cols;
+
+	cells = calloc(nr, sizeof(*cells));
+	prev = calloc(nr, sizeof(*prev));
+	if (!cells || !prev) {
+		free(cells);
+		free(prev);
+		return -1;
+	}
+
+	free(s->cells);
+	free(s->prev);
+	s->cells = cells;
+	s->prev = prev;
+	s->rows = rows;
+	s->cols = cols;
+	s->invalid = true;
+
+	return 0;
+}
+
+void
+screen_invalidate(struct screen *s)
+{
+	s->invalid = true;
+}
+
+static void
+screen_clear(struct screen *s, size_t from)
+{
+	size_t nr = (size_t) s->rows * s->cols;
+
+	for (size_t i = from; i < nr; i++) {
+		s->cells[i].ch = ' ';
+		s->cells[i].attr = 0;
+	}
+}
+
+void
+screen_begin(struct screen *s)
+{
+	buf_reset(&s->text);
+	s->x = s->y = 0;
+	s->attr = 0;
+	s->esc_len = 0;
+
+	if (s->grid)
+		screen_clear(s, 0);
+}
+
+void
+screen_puts(struct screen *s, const char *str)
+{
+	buf_puts(&s->text, str);
+}
+
+void
+screen_putc(struct screen *s, char c)
+{
+	buf_putc(&s->text, c);
+}
+
+void
+screen_printf(struct screen *s, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	buf_vprintf(&s->text, fmt, ap);
+	va_end(ap);
+}
+
+int
+screen_lines(const struct screen *s)
+{
+	const char *p = s->text.data;
+	const char *end = p + s->text.len;
+	int lines = 0;
+
+	if (!s->text.len)
+		return 0;
+
+	while ((p = memchr(p, '\n', end - p))) {
+		lines++;
+		p++;
+	}
+
+	return lines;
+}
+
+void
+screen_u64(struct screen *s, uint64_t value, int width, bool grouped)
+{
+	fmt_buf_u64(&s->text, value, width, grouped);
+}
+
+void
+screen_fixed2(struct screen *s, int64_t hundredths, int width)
+{
+	fmt_buf_fixed2(&s->text, hundredths, width);
+}
+
+/*
+ * select graphic rendition, the only escapes pages use besides clear screen
+ */
+static void
+screen_sgr(struct screen *s, const char *params)
+{
+	do {
+		int p = atoi(params);
+
+		if (p == 0)
+			s->attr = 0;
+		else if (p == 1)
+			s->attr |= SCREEN_BOLD;
+		else if (p == 4)
+			s->attr |= SCREEN_UNDERLINE;
+
+		params = strchr(params, ';');
+	} while (params++);
+}
+
+static void
+screen_escape(struct screen *s)
+{
+	char final = s->esc[s->esc_len - 1];
+
+	s->esc[s->esc_len - 1] = '\0';
+
+	switch (final) {
+	case 'm':
+		screen_sgr(s, s->esc + 2);
+		break;
+	case 'H':
+		s->x = s->y = 0;
+		break;
+	case 'J':
+		screen_clear(s, (size_t) s->y * s->cols + s->x);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * the code point of the UTF-8 sequence at str, 0 if it isn't one. len is set
+ * to how much of str it takes, at least one byte.
+ */
+static uint32_t
+screen_utf8_decode(const unsigned char *str, size_t avail, size_t *len)
+{
+	uint32_t cp;
+	size_t n, i;
+
+	*len = 1;
+
+	if (str[0] >= 0xc2 && str[0] <= 0xdf) {
+		n = 2;
+		cp = str[0] & 0x1f;
+	} else if (str[0] >= 0xe0 && str[0] <= 0xef) {
+		n = 3;
+		cp = str[0] & 0x0f;
+	} else if (str[0] >= 0xf0 && str[0] <= 0xf4) {
+		n = 4;
+		cp = str[0] & 0x07;
+	} else {
+		return 0;
+	}
+
+	if (n > avail)
+		return 0;
+
+	for (i = 1; i < n; i++) {
+		if ((str[i] & 0xc0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (str[i] & 0x3f);
+	}
+
+	/* overlong, surrogates and out of range */
+	if ((n == 3 && cp < 0x800) || (n == 4 && (cp < 0x10000 || cp > 0x10ffff)) ||
+	    (cp >= 0xd800 && cp <= 0xdfff))
+		return 0;
+
+	*len = n;
+	return cp;
+}
+
+static void
+screen_utf8_encode(struct gtop_buf *out, uint32_t cp)
+{
+	if (cp < 0x80) {
+		buf_putc(out, cp);
+	} else if (cp < 0x800) {
+		buf_putc(out, 0xc0 | (cp >> 6));
+		buf_putc(out, 0x80 | (cp & 0x3f));
+	} else if (cp < 0x10000) {
+		buf_putc(out, 0xe0 | (cp >> 12));
+		buf_putc(out, 0x80 | ((cp >> 6) & 0x3f));
+		buf_putc(out, 0x80 | (cp & 0x3f));
+	} else {
+		buf_putc(out, 0xf0 | (cp >> 18));
+		buf_putc(out, 0x80 | ((cp >> 12) & 0x3f));
+		buf_putc(out, 0x80 | ((cp >> 6) & 0x3f));
+		buf_putc(out, 0x80 | (cp & 0x3f));
+	}
+}
+
+/*
+ * lay the text of the frame out in cells, what doesn't fit is dropped
+ */
+static void
+screen_feed(struct screen *s)
+{
+	for (size_t i = 0; i < s->text.len; i++) {
+		unsigned char c = s->text.data[i];
+
+		if (s->esc_len) {
+			if (s->esc_len < sizeof(s->esc))
+				s->esc[s->esc_len++] = c;
+			/* ESC [ parameters final */
+			if (s->esc_len > 2 && c >= 0x40 && c <= 0x7e) {
+				screen_escape(s);
+				s->esc_len = 0;
+			} else if (s->esc_len == 2 && c != '[') {
+				s->esc_len = 0;
+			}
+			continue;
+		}
+
+		if (c == ESC) {
+			s->esc[s->esc_len++] = c;
+		} else if (c == '\n') {
+			s->x = 0;
+			s->y++;
+		} else if (c == '\r') {
+			s->x = 0;
+		} else {
+			uint32_t cp = c;
+			size_t len = 1;
+
+			if (c >= 0x80)
+				cp = screen_utf8_decode((const unsigned char *) s->text.data + i,
+							s->text.len - i, &len);
+			if (cp < 0x20 || cp == 0x7f || (cp >= 0x80 && cp < 0xa0))
+				cp = '?';
+			i += len - 1;
+
+			if (s->y < s->rows && s->x < s->cols) {
+				struct screen_cell *cell = &s->cells[s->y * s->cols + s->x];
+
+				cell->ch = cp;
+				cell->attr = s->attr;
+			}
+			s->x++;
+		}
+	}
+}
+
+static bool
+screen_cell_eq(const struct screen_cell *a, const struct screen_cell *b)
+{
+	return a->ch == b->ch && a->attr == b->attr;
+}
+
+static void
+screen_emit_attr(struct gtop_buf *out, uint8_t attr)
+{
+	buf_puts(out, "\033[0");
+	if (attr & SCREEN_BOLD)
+		buf_puts(out, ";1");
+	if (attr & SCREEN_UNDERLINE)
+		buf_puts(out, ";4");
+	buf_putc(out, 'm');
+}
+
+/*
+ * runs of changed cells, with the cursor moved only where needed
+ */
+static void
+screen_diff(struct screen *s)
+{
+	struct gtop_buf *out = &s->out;
+	int cx = -1, cy = -1, last = 0;
+	uint8_t attr = 0;
+
+	if (s->invalid) {
+		/* compare against a blank terminal */
+		buf_puts(out, "\033[0m\033[H\033[2J");
+		for (size_t i = 0; i < (size_t) s->rows * s->cols; i++) {
+			s->prev[i].ch = ' ';
+			s->prev[i].attr = 0;
+		}
+		cx = cy = 0;
+	}
+
+	for (int y = 0; y < s->rows; y++) {
+		const struct screen_cell *cur = &s->cells[y * s->cols];
+		const struct screen_cell *prev = &s->prev[y * s->cols];
+		int x = 0;
+
+		for (int i = 0; i < s->cols; i++)
+			if (cur[i].ch != ' ' || cur[i].attr)
+				last = y;
+
+		while (x < s->cols) {
+			int end, same;
+
+			if (screen_cell_eq(&cur[x], &prev[x])) {
+				x++;
+				continue;
+			}
+
+			/* extend the run over short stretches of unchanged cells */
+			end = x + 1;
+			same = 0;
+			while (end + same < s->cols && same <= SCREEN_MERGE_GAP) {
+				if (screen_cell_eq(&cur[end + same], &prev[end + same])) {
+					same++;
+				} else {
+					end += same + 1;
+					same = 0;
+				}
+			}
+
+			if (cy != y || cx != x)
+				buf_printf(out, "\033[%d;%dH", y + 1, x + 1);
+
+			for (; x < end; x++) {
+				if (cur[x].attr != attr) {
+					screen_emit_attr(out, cur[x].attr);
+					attr = cur[x].attr;
+				}
+				screen_utf8_encode(out, cur[x].ch);
+			}
+
+			/* the cursor is in limbo past the last column */
+			cx = (x < s->cols) ? x : -1;
+			cy = y;
+		}
+	}
+
+	if (attr)
+		buf_puts(out, "\033[0m");
+
+	/* leave the cursor below the page */
+	if (out->len && last + 1 < s->rows)
+		buf_printf(out, "\033[%d;1H", last + 2);
+}
+
+ssize_t
+screen_flush(struct screen *s, int fd)
+{
+	struct screen_cell *tmp;
+
+	if (!s->grid)
+		return buf_write(&s->text, fd);
+
+	screen_feed(s);
+	buf_reset(&s->text);
+
+	screen_diff(s);
+
+	tmp = s->prev;
+	s->prev = s->cells;
+	s->cells = tmp;
+	s->invalid = false;
+
+	return buf_write(&s->out, fd);
+}
+
+void
+screen_free(struct screen *s)
+{
+	free(s->cells);
+	free(s->prev);
+	buf_free(&s->text);
+	buf_free(&s->out);
+	memset(s, 0, sizeof(*s));
+}
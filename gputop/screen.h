@@ -0,0 +1,160 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_SCREEN_H
+#define __GPUTOP_SCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "buffer.h"
+
+/* runs of changed cells closer than that are merged, moving costs as much */
+#define SCREEN_MERGE_GAP	6
+
+enum screen_attr {
+	SCREEN_BOLD		= 1 << 0,
+	SCREEN_UNDERLINE	= 1 << 1,
+};
+
+/* a code point, text is UTF-8 and every code point takes a cell */
+struct screen_cell {
+	uint32_t ch;
+	uint8_t attr;
+};
+
+/**
+ * screen:
+ *
+ * Pages are printed in text, as they would be to a terminal: new lines, bold,
+ * underline and clear screen escapes. On a terminal the text is laid out in a
+ * grid of cells, compared with the previous frame, and only the runs of
+ * cells that changed are written out, in a single write(). Otherwise the text
+ * is written out as it is.
+ */
+struct screen {
+	bool grid;
+	int rows;
+	int cols;
+
+	/* frame being printed, and the one the terminal shows */
+	struct screen_cell *cells;
+	struct screen_cell *prev;
+	/* the terminal is to be repainted, not updated */
+	bool invalid;
+
+	/* where the text goes */
+	int x, y;
+	uint8_t attr;
+	/* partial escape sequence */
+	char esc[16];
+	size_t esc_len;
+
+	struct gtop_buf text;
+	struct gtop_buf out;
+};
+
+/**
+ * screen_init:
+ *
+ * rows and cols are only used with grid set. Returns -1 if we run out of
+ * memory.
+ */
+int
+screen_init(struct screen *s, bool grid, int rows, int cols);
+
+/**
+ * screen_resize:
+ *
+ * The next frame repaints the whole terminal.
+ */
+int
+screen_resize(struct screen *s, int rows, int cols);
+
+/**
+ * screen_invalidate:
+ *
+ * Something else has been written to the terminal, repaint it with the next
+ * frame.
+ */
+void
+screen_invalidate(struct screen *s);
+
+/**
+ * screen_begin:
+ *
+ * Start a frame, blank.
+ */
+void
+screen_begin(struct screen *s);
+
+void
+screen_puts(struct screen *s, const char *str);
+
+void
+screen_putc(struct screen *s, char c);
+
+void
+screen_printf(struct screen *s, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/**
+ * screen_u64:
+ *
+ * value right aligned in width columns, with thousands separators if
+ * grouped. Formatted straight into the frame, see fmt.h.
+ */
+void
+screen_u64(struct screen *s, uint64_t value, int width, bool grouped);
+
+/**
+ * screen_fixed2:
+ *
+ * A value in hundredths, i.e. a percentage out of fmt_percent_of(), with two
+ * decimals, right aligned in width columns.
+ */
+void
+screen_fixed2(struct screen *s, int64_t hundredths, int width);
+
+/**
+ * screen_lines:
+ *
+ * Lines printed so far in the frame, to fit what is left in the rows.
+ */
+int
+screen_lines(const struct screen *s);
+
+/**
+ * screen_flush:
+ *
+ * Write the frame, or what changed with it, to fd. Returns the number of
+ * bytes written, -1 on error.
+ */
+ssize_t
+screen_flush(struct screen *s, int fd);
+
+void
+screen_free(struct screen *s);
+
+#endif
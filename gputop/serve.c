@@ -0,0 +1,422 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+#define SERVE_BACKLOG		16
+#define SERVE_BODY_SIZE		(64 * 1024)
+/* a client not done by then is dropped */
+#define SERVE_CLIENT_TIMEOUT_MS	500
+
+#define SERVE_CONTENT_TYPE	"text/plain; version=0.0.4; charset=utf-8"
+
+static int
+serve_open_unix(struct serve *s, const char *path)
+{
+	struct sockaddr_un addr = {};
+	struct stat st;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -2;
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	s->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s->fd < 0)
+		return -1;
+
+	/* left behind by a previous instance */
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	if (bind(s->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		return -1;
+
+	s->path = strdup(path);
+	return 0;
+}
+
+static int
+serve_open_inet(struct serve *s, const char *address)
+{
+	struct addrinfo hints = {}, *res;
+	char host[256];
+	const char *port;
+	size_t len;
+	int one = 1;
+	int err;
+
+	/* the port comes after the last ':', [] around IPv6 addresses */
+	port = strrchr(address, ':');
+	if (!port || port == address || !port[1])
+		return -2;
+
+	len = port - address;
+	if (address[0] == '[' && address[len - 1] == ']') {
+		address++;
+		len -= 2;
+	}
+	if (len >= sizeof(host))
+		return -2;
+
+	memcpy(host, address, len);
+	host[len] = '\0';
+	port++;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+	if (getaddrinfo(host, port, &hints, &res))
+		return -2;
+
+	s->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (s->fd < 0) {
+		freeaddrinfo(res);
+		return -1;
+	}
+
+	setsockopt(s->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	err = bind(s->fd, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
+
+	return err;
+}
+
+int
+serve_open(struct serve *s, const char *address)
+{
+	int err;
+
+	memset(s, 0, sizeof(*s));
+	s->fd = -1;
+
+	if (!strncmp(address, "unix:", strlen("unix:")))
+		err = serve_open_unix(s, address + strlen("unix:"));
+	else
+		err = serve_open_inet(s, address);
+
+	if (err < 0)
+		goto err;
+
+	/* we only accept() once poll() told us to */
+	if (fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) | O_NONBLOCK) < 0 ||
+	    listen(s->fd, SERVE_BACKLOG) < 0) {
+		err = -1;
+		goto err;
+	}
+
+	if (buf_init(&s->body, SERVE_BODY_SIZE) < 0 ||
+	    buf_init(&s->response, SERVE_BODY_SIZE) < 0) {
+		err = -1;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	serve_close(s);
+	return err;
+}
+
+static void
+serve_client_drop(struct serve *s, size_t i)
+{
+	struct serve_client *c = &s->clients[i];
+
+	close(c->fd);
+	buf_free(&c->out);
+
+	/* the last one takes its place */
+	s->nr_clients--;
+	if (i != s->nr_clients)
+		*c = s->clients[s->nr_clients];
+}
+
+void
+serve_close(struct serve *s)
+{
+	while (s->nr_clients)
+		serve_client_drop(s, s->nr_clients - 1);
+
+	if (s->fd >= 0)
+		close(s->fd);
+	s->fd = -1;
+
+	if (s->path) {
+		unlink(s->path);
+		free(s->path);
+		s->path = NULL;
+	}
+
+	buf_free(&s->body);
+	buf_free(&s->response);
+}
+
+void
+serve_publish(struct serve *s)
+{
+	buf_reset(&s->response);
+	buf_printf(&s->response,
+		   "HTTP/1.1 200 OK\r\n"
+		   "Content-Type: " SERVE_CONTENT_TYPE "\r\n"
+		   "Content-Length: %zu\r\n"
+		   "Connection: close\r\n"
+		   "\r\n", s->body.len);
+	s->header_len = s->response.len;
+
+	buf_append(&s->response, s->body.data, s->body.len);
+	buf_reset(&s->body);
+
+	s->ready = !s->response.truncated;
+}
+
+static uint64_t
+serve_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Whatever the request asks for gets the metrics, as they are now.
+ */
+static int
+serve_client_answer(struct serve *s, struct serve_client *c)
+{
+	static const char unavailable[] =
+		"HTTP/1.1 503 Service Unavailable\r\n"
+		"Content-Length: 0\r\nConnection: close\r\n\r\n";
+	static const char bad_method[] =
+		"HTTP/1.1 405 Method Not Allowed\r\n"
+		"Allow: GET, HEAD\r\n"
+		"Content-Length: 0\r\nConnection: close\r\n\r\n";
+	const char *data = unavailable;
+	size_t len = sizeof(unavailable) - 1;
+
+	if (!strncmp(c->request, "GET ", 4) && s->ready) {
+		data = s->response.data;
+		len = s->response.len;
+	} else if (!strncmp(c->request, "HEAD ", 5) && s->ready) {
+		data = s->response.data;
+		len = s->header_len;
+	} else if (strncmp(c->request, "GET ", 4) && strncmp(c->request, "HEAD ", 5)) {
+		data = bad_method;
+		len = sizeof(bad_method) - 1;
+	}
+
+	if (data != bad_method)
+		s->nr_scrapes++;
+
+	if (buf_init(&c->out, len) < 0)
+		return -1;
+
+	buf_append(&c->out, data, len);
+	c->answered = true;
+
+	return c->out.truncated ? -1 : 0;
+}
+
+/*
+ * the headers, closing before reading them would reset the connection
+ */
+static int
+serve_client_read(struct serve *s, struct serve_client *c)
+{
+	while (!c->answered) {
+		ssize_t nr = read(c->fd, c->request + c->len,
+				  sizeof(c->request) - 1 - c->len);
+
+		if (nr < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		if (nr == 0)
+			return -1;
+
+		c->len += nr;
+		c->request[c->len] = '\0';
+
+		/* too long for us, answer what we have */
+		if (strstr(c->request, "\r\n\r\n") || strstr(c->request, "\n\n") ||
+		    c->len == sizeof(c->request) - 1)
+			return serve_client_answer(s, c);
+	}
+
+	return 0;
+}
+
+/*
+ * send as much as the socket takes, 1 once all of it is
+ */
+static int
+serve_client_send(struct serve_client *c)
+{
+	while (c->sent < c->out.len) {
+		ssize_t nr = send(c->fd, c->out.data + c->sent,
+				  c->out.len - c->sent, MSG_NOSIGNAL);
+
+		if (nr < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+
+		c->sent += nr;
+	}
+
+	return 1;
+}
+
+static void
+serve_accept(struct serve *s)
+{
+	int fd;
+
+	while (s->nr_clients < SERVE_MAX_CLIENTS &&
+	       (fd = accept(s->fd, NULL, NULL)) >= 0) {
+		struct serve_client *c = &s->clients[s->nr_clients];
+
+		/* some systems don't pass O_NONBLOCK on from the listening socket */
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+			close(fd);
+			continue;
+		}
+
+		memset(c, 0, sizeof(*c));
+		c->fd = fd;
+		c->accepted_ns = serve_now_ns();
+		s->nr_clients++;
+	}
+}
+
+size_t
+serve_pollfds(struct serve *s, struct pollfd *pfds)
+{
+	uint64_t now = serve_now_ns();
+
+	/* a slow client or a port scan doesn't get to keep a slot */
+	for (size_t i = s->nr_clients; i-- > 0;) {
+		if (now - s->clients[i].accepted_ns >
+		    SERVE_CLIENT_TIMEOUT_MS * 1000000ULL)
+			serve_client_drop(s, i);
+	}
+
+	pfds[0].fd = s->fd;
+	pfds[0].events = s->nr_clients < SERVE_MAX_CLIENTS ? POLLIN : 0;
+	for (size_t i = 0; i < s->nr_clients; i++) {
+		pfds[i + 1].fd = s->clients[i].fd;
+		pfds[i + 1].events = s->clients[i].answered ? POLLOUT : POLLIN;
+	}
+
+	return s->nr_clients + 1;
+}
+
+void
+serve_dispatch(struct serve *s, const struct pollfd *pfds)
+{
+	/* backwards, dropping a client moves the last one in its place */
+	for (size_t i = s->nr_clients; i-- > 0;) {
+		struct serve_client *c = &s->clients[i];
+		short revents = pfds[i + 1].revents;
+		int err = 0;
+
+		if (revents & POLLIN)
+			err = serve_client_read(s, c);
+		else if (revents & (POLLERR | POLLHUP | POLLNVAL))
+			err = -1;
+
+		/* try right away, most of the time it all fits */
+		if (!err && c->answered)
+			err = serve_client_send(c);
+
+		if (err)
+			serve_client_drop(s, i);
+	}
+
+	if (pfds[0].revents & POLLIN)
+		serve_accept(s);
+}
+
+void
+serve_family(struct gtop_buf *buf, const char *name, const char *type,
+	     const char *help)
+{
+	buf_printf(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+serve_label_value(struct gtop_buf *buf, const char *value)
+{
+	for (; *value; value++) {
+		switch (*value) {
+		case '\\':
+			buf_puts(buf, "\\\\");
+			break;
+		case '"':
+			buf_puts(buf, "\\\"");
+			break;
+		case '\n':
+			buf_puts(buf, "\\n");
+			break;
+		default:
+			buf_putc(buf, *value);
+		}
+	}
+}
+
+void
+serve_sample(struct gtop_buf *buf, const char *name, double value, ...)
+{
+	const char *label;
+	bool first = true;
+	va_list ap;
+
+	buf_puts(buf, name);
+
+	va_start(ap, value);
+	while ((label = va_arg(ap, const char *))) {
+		const char *label_value = va_arg(ap, const char *);
+
+		buf_puts(buf, first ? "{" : ",");
+		buf_puts(buf, label);
+		buf_puts(buf, "=\"");
+		serve_label_value(buf, label_value);
+		buf_putc(buf, '"');
+		first = false;
+	}
+	va_end(ap);
+
+	buf_printf(buf, "%s %.15g\n", first ? "" : "}", value);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_SERVE_H
+#define __GPUTOP_SERVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <poll.h>
+
+#include "buffer.h"
+
+/* connections served at once, others wait in the backlog */
+#define SERVE_MAX_CLIENTS	16
+#define SERVE_REQUEST_SIZE	4096
+
+/**
+ * serve_client:
+ *
+ * A connection, non-blocking. The request headers are gathered as they come
+ * in, the response to send is copied once they are complete so that the next
+ * window doesn't change it under us.
+ */
+struct serve_client {
+	int fd;
+	/* CLOCK_MONOTONIC, dropped if not done in time */
+	uint64_t accepted_ns;
+
+	char request[SERVE_REQUEST_SIZE];
+	size_t len;
+
+	/* what's left to send is out.data[sent..out.len) */
+	struct gtop_buf out;
+	size_t sent;
+	bool answered;
+};
+
+/**
+ * serve:
+ *
+ * Minimal HTTP server exposing the latest window in the Prometheus text
+ * format. The body is rendered once per window into body, then published as
+ * a complete response so that a scrape costs a single write(), however often
+ * we're being scraped.
+ */
+struct serve {
+	int fd;
+	/* unix socket, removed on close */
+	char *path;
+
+	/* the caller renders the next window in it */
+	struct gtop_buf body;
+
+	/* status line, headers and body of the last published window */
+	struct gtop_buf response;
+	size_t header_len;
+	bool ready;
+
+	struct serve_client clients[SERVE_MAX_CLIENTS];
+	size_t nr_clients;
+
+	uint64_t nr_scrapes;
+};
+
+/**
+ * serve_open:
+ *
+ * Listen on address, either unix:<path> or <host>:<port>. Returns -1 and sets
+ * errno on failure, -2 if the address can't be parsed or resolved.
+ */
+int
+serve_open(struct serve *s, const char *address);
+
+void
+serve_close(struct serve *s);
+
+/**
+ * serve_publish:
+ *
+ * Wrap body in a response, which is then served until the next window gets
+ * published, and reset body.
+ */
+void
+serve_publish(struct serve *s);
+
+/**
+ * serve_pollfds:
+ *
+ * What to poll() for: the listening socket, unless we have as many
+ * connections as we serve, then every connection. Connections taking too
+ * long are dropped first. pfds has room for SERVE_MAX_CLIENTS + 1, returns
+ * how many are used.
+ */
+size_t
+serve_pollfds(struct serve *s, struct pollfd *pfds);
+
+/**
+ * serve_dispatch:
+ *
+ * Accept connections, read requests and send responses, as poll() has found
+ * them ready in pfds, filled by serve_pollfds().
+ */
+void
+serve_dispatch(struct serve *s, const struct pollfd *pfds);
+
+/**
+ * serve_family:
+ *
+ * Start a metric family, type being gauge or counter.
+ */
+void
+serve_family(struct gtop_buf *buf, const char *name, const char *type,
+	     const char *help);
+
+/**
+ * serve_sample:
+ *
+ * One sample of the current family, followed by label name and value pairs,
+ * terminated by NULL. Label values are escaped.
+ */
+void
+serve_sample(struct gtop_buf *buf, const char *name, double value, ...)
+	__attribute__((sentinel));
+
+#endif
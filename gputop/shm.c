@@ -0,0 +1,163 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+/* the layout is shared with readers which don't know about trace.h */
+_Static_assert(sizeof(struct gputop_shm_column) == sizeof(struct trace_column),
+	       "shm and trace columns differ");
+_Static_assert(GPUTOP_SHM_GROUP_MEMORY == (int) TRACE_GROUP_MEMORY,
+	       "shm and trace groups differ");
+_Static_assert(GPUTOP_SHM_COL_SAMPLES == (int) TRACE_COL_SAMPLES,
+	       "shm and trace columns differ");
+
+/* values start on their own cache line */
+#define SHM_VALUES_ALIGN	64
+
+static void
+shm_unlink_name(const char *name)
+{
+	int saved = errno;
+
+#if defined __ANDROID__ || defined ANDROID
+	unlink(name);
+#else
+	shm_unlink(name);
+#endif
+	errno = saved;
+}
+
+int
+shm_writer_open(struct shm_writer *w, const char *name,
+		const struct trace_chip *chip,
+		const struct trace_column *columns, uint32_t nr_columns)
+{
+	struct gputop_shm_header *hdr;
+	size_t columns_offset, values_offset;
+	void *map;
+	int fd;
+
+	memset(w, 0, sizeof(*w));
+
+	columns_offset = sizeof(*hdr);
+	values_offset = columns_offset + nr_columns * sizeof(struct gputop_shm_column);
+	values_offset = (values_offset + SHM_VALUES_ALIGN - 1) & ~(SHM_VALUES_ALIGN - 1);
+	w->size = values_offset + nr_columns * sizeof(uint64_t);
+
+	w->name = strdup(name);
+	if (!w->name)
+		return -1;
+
+	/*
+	 * readers of a previous run may still have it mapped, truncating it
+	 * under them would fault, they keep the old one instead
+	 */
+	shm_unlink_name(name);
+
+	fd = gputop_shm_fd(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+		goto err;
+
+	if (ftruncate(fd, w->size) < 0) {
+		close(fd);
+		goto err_unlink;
+	}
+
+	map = mmap(NULL, w->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		goto err_unlink;
+
+	hdr = map;
+	hdr->version = GPUTOP_SHM_VERSION;
+	hdr->size = w->size;
+	hdr->nr_columns = nr_columns;
+	hdr->columns_offset = columns_offset;
+	hdr->values_offset = values_offset;
+	hdr->pid = getpid();
+
+	hdr->model = chip->model;
+	hdr->revision = chip->revision;
+	memcpy(hdr->cores, chip->cores, sizeof(hdr->cores));
+	hdr->drv_major = chip->drv_major;
+	hdr->drv_minor = chip->drv_minor;
+	hdr->drv_patch = chip->drv_patch;
+	hdr->drv_build = chip->drv_build;
+
+	memcpy((char *) map + columns_offset, columns,
+	       nr_columns * sizeof(struct gputop_shm_column));
+
+	/* readers check it before anything else */
+	__atomic_store_n(&hdr->magic, GPUTOP_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	w->hdr = hdr;
+	w->values = (uint64_t *) ((char *) map + values_offset);
+	return 0;
+
+err_unlink:
+	shm_unlink_name(name);
+err:
+	free(w->name);
+	w->name = NULL;
+	return -1;
+}
+
+void
+shm_writer_publish(struct shm_writer *w, const uint64_t *row)
+{
+	struct gputop_shm_header *hdr = w->hdr;
+	/* we are the only writer */
+	uint64_t seq = hdr->seq;
+
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	/* readers seeing any of the new values have to see seq odd */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (uint32_t c = 0; c < hdr->nr_columns; c++)
+		__atomic_store_n(&w->values[c], row[c], __ATOMIC_RELAXED);
+
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void
+shm_writer_close(struct shm_writer *w)
+{
+	if (w->hdr)
+		munmap(w->hdr, w->size);
+
+	if (w->name) {
+		shm_unlink_name(w->name);
+		free(w->name);
+	}
+
+	memset(w, 0, sizeof(*w));
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_SHM_H
+#define __GPUTOP_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gputop_shm.h"
+#include "trace.h"
+
+/**
+ * shm_writer:
+ *
+ * Publishes the latest window in a shared memory segment, laid out as
+ * described in gputop_shm.h. Publishing never waits for the readers.
+ */
+struct shm_writer {
+	char *name;
+	struct gputop_shm_header *hdr;
+	uint64_t *values;
+	size_t size;
+};
+
+/**
+ * shm_writer_open:
+ *
+ * Create (or take over) the segment name and describe the columns in it.
+ * Returns -1 and sets errno on failure.
+ */
+int
+shm_writer_open(struct shm_writer *w, const char *name,
+		const struct trace_chip *chip,
+		const struct trace_column *columns, uint32_t nr_columns);
+
+/**
+ * shm_writer_publish:
+ *
+ * Replace the values with row, nr_columns of them.
+ */
+void
+shm_writer_publish(struct shm_writer *w, const uint64_t *row);
+
+/**
+ * shm_writer_close:
+ *
+ * Unmap and remove the segment, readers keep what they have mapped.
+ */
+void
+shm_writer_close(struct shm_writer *w);
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#define STATS_NSEC_PER_SEC	(1000000000ULL)
+
+uint64_t
+stats_mux_scale(uint64_t events, uint64_t time_enabled, uint64_t time_running)
+{
+	if (time_running >= time_enabled)
+		return events;
+
+	if (time_running == 0)
+		return 0;
+
+	/* events * time_enabled might overflow for long windows */
+	return (uint64_t) ((double) events * (double) time_enabled /
+			   (double) time_running);
+}
+
+double
+stats_mux_active(uint64_t time_enabled, uint64_t time_running)
+{
+	if (time_enabled == 0 || time_running >= time_enabled)
+		return 100.0f;
+
+	return 100.0f * (double) time_running / (double) time_enabled;
+}
+
+uint64_t
+stats_rate(uint64_t events, enum stats_rate rate,
+	   uint64_t elapsed_ns, uint64_t frames)
+{
+	switch (rate) {
+	case RATE_SECOND:
+		if (elapsed_ns == 0)
+			return events;
+		return (uint64_t) ((double) events * STATS_NSEC_PER_SEC /
+				   (double) elapsed_ns);
+	case RATE_FRAME:
+		if (frames == 0)
+			return STATS_RATE_NONE;
+		return events / frames;
+	case RATE_WINDOW:
+	default:
+		return events;
+	}
+}
+
+/*
+ * Bit-sliced counting: plane j holds bit j of the per-bit counters, two
+ * words being processed at once in the 64-bit lanes. Adding a word is a
+ * ripple-carry of AND/XOR over the planes, independent of how many bits are
+ * set, and the planes are flushed to counts before any lane can overflow.
+ */
+#define STATS_PLANES		8
+#define STATS_PLANE_WORDS	(((1U << STATS_PLANES) - 1) * 2)
+
+void
+stats_bit_histogram(const uint32_t *words, size_t nr, uint32_t counts[32])
+{
+	uint64_t planes[STATS_PLANES];
+	size_t i = 0;
+
+	while (i < nr) {
+		size_t batch = nr - i;
+		size_t k;
+		unsigned int b, j;
+
+		if (batch > STATS_PLANE_WORDS)
+			batch = STATS_PLANE_WORDS;
+
+		memset(planes, 0, sizeof(planes));
+
+		for (k = 0; k < batch; k += 2) {
+			uint64_t carry = words[i + k];
+
+			if (k + 1 < batch)
+				carry |= (uint64_t) words[i + k + 1] << 32;
+
+			for (j = 0; j < STATS_PLANES && carry; j++) {
+				uint64_t t = planes[j] & carry;
+
+				planes[j] ^= carry;
+				carry = t;
+			}
+		}
+
+		for (b = 0; b < 32; b++) {
+			uint32_t c = 0;
+
+			for (j = 0; j < STATS_PLANES; j++)
+				c += (uint32_t) (((planes[j] >> b) & 1) +
+						 ((planes[j] >> (b + 32)) & 1)) << j;
+
+			counts[b] += c;
+		}
+
+		i += batch;
+	}
+}
+
+void
+stats_agg_merge(struct stats_agg *agg, const struct stats_agg *other)
+{
+	if (!other->n)
+		return;
+
+	if (!agg->n || other->min < agg->min)
+		agg->min = other->min;
+	if (!agg->n || other->max > agg->max)
+		agg->max = other->max;
+
+	agg->sum += other->sum;
+	agg->n += other->n;
+}
+
+double
+stats_agg_mean(const struct stats_agg *agg)
+{
+	if (!agg->n)
+		return 0.0;
+
+	return agg->sum / agg->n;
+}
+
+void
+stats_percent_bucket(uint64_t buckets[STATS_PERCENT_BUCKETS], double percent)
+{
+	int b = (int) (percent / (100.0 / STATS_PERCENT_BUCKETS));
+
+	if (b < 0)
+		b = 0;
+	if (b >= STATS_PERCENT_BUCKETS)
+		b = STATS_PERCENT_BUCKETS - 1;
+
+	buckets[b]++;
+}
+
+static int
+stats_cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+void
+stats_sort(double *values, size_t n)
+{
+	qsort(values, n, sizeof(*values), stats_cmp_double);
+}
+
+double
+stats_percentile(const double *sorted, size_t n, double p)
+{
+	double rank;
+	size_t lo;
+
+	if (!n)
+		return 0.0;
+
+	if (p <= 0.0)
+		return sorted[0];
+	if (p >= 100.0)
+		return sorted[n - 1];
+
+	rank = p / 100.0 * (n - 1);
+	lo = (size_t) rank;
+	if (lo + 1 >= n)
+		return sorted[n - 1];
+
+	return sorted[lo] + (rank - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+static double
+stats_abs(double value)
+{
+	return value < 0.0 ? -value : value;
+}
+
+void
+stats_spread(const double *sorted, size_t n, double *tmp,
+	     struct stats_spread *spread)
+{
+	double sum = 0.0;
+
+	spread->median = stats_percentile(sorted, n, 50.0);
+	spread->scale = 0.0;
+
+	if (!n)
+		return;
+
+	for (size_t i = 0; i < n; i++) {
+		tmp[i] = stats_abs(sorted[i] - spread->median);
+		sum += tmp[i];
+	}
+
+	/* both constants make it comparable to the standard deviation of a
+	 * normal distribution */
+	stats_sort(tmp, n);
+	spread->scale = 1.4826 * stats_percentile(tmp, n, 50.0);
+	if (spread->scale == 0.0)
+		spread->scale = 1.2533 * sum / n;
+}
+
+double
+stats_robust_z(const struct stats_spread *spread, double value)
+{
+	if (spread->scale == 0.0)
+		return 0.0;
+
+	return (value - spread->median) / spread->scale;
+}
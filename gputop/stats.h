@@ -0,0 +1,170 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_STATS_H
+#define __GPUTOP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * units counter values can be normalized to
+ */
+enum stats_rate {
+	RATE_WINDOW = 0,	/* raw events in the sampling window */
+	RATE_SECOND,		/* events per second */
+	RATE_FRAME,		/* events per frame */
+
+	RATE_NO,
+};
+
+/**
+ * stats_mux_scale:
+ *
+ * Scale events gathered while a counter group was active (time_running)
+ * to the whole window (time_enabled), the same way perf(1) extrapolates
+ * multiplexed events. Returns 0 if the group never ran.
+ */
+uint64_t
+stats_mux_scale(uint64_t events, uint64_t time_enabled, uint64_t time_running);
+
+/**
+ * stats_mux_active:
+ *
+ * Percentage of the window the group was active. Anything below 100% means
+ * the displayed value is an estimate.
+ */
+double
+stats_mux_active(uint64_t time_enabled, uint64_t time_running);
+
+/* no frames rendered in the window, there's no per frame value */
+#define STATS_RATE_NONE		UINT64_MAX
+
+/**
+ * stats_rate:
+ *
+ * Normalize the events of a window, elapsed_ns being the exact time the
+ * events have been gathered in and frames the number of frames rendered in
+ * the same time. Per frame without frames gives STATS_RATE_NONE, per second
+ * without elapsed time the events as they are.
+ */
+uint64_t
+stats_rate(uint64_t events, enum stats_rate rate,
+	   uint64_t elapsed_ns, uint64_t frames);
+
+/**
+ * stats_bit_histogram:
+ *
+ * For each of the 32 bits count in how many of the words it is set, adding
+ * to counts. Used to get the busy count of every module out of a window of
+ * raw idle state register values.
+ */
+void
+stats_bit_histogram(const uint32_t *words, size_t nr, uint32_t counts[32]);
+
+/**
+ * stats_agg:
+ *
+ * Running aggregate of a series of values, partial aggregates (for instance
+ * computed by different threads) can be merged.
+ */
+struct stats_agg {
+	uint64_t n;
+	double sum;
+	double min;
+	double max;
+};
+
+/* inline, it's called for every value of a trace */
+static inline void
+stats_agg_add(struct stats_agg *agg, double value)
+{
+	if (!agg->n || value < agg->min)
+		agg->min = value;
+	if (!agg->n || value > agg->max)
+		agg->max = value;
+
+	agg->sum += value;
+	agg->n++;
+}
+
+void
+stats_agg_merge(struct stats_agg *agg, const struct stats_agg *other);
+
+double
+stats_agg_mean(const struct stats_agg *agg);
+
+/*
+ * distribution of percentages, in 10% buckets, 100% going in the last one
+ */
+#define STATS_PERCENT_BUCKETS	10
+
+void
+stats_percent_bucket(uint64_t buckets[STATS_PERCENT_BUCKETS], double percent);
+
+/**
+ * stats_sort:
+ *
+ * Sort values in ascending order, what the functions below expect.
+ */
+void
+stats_sort(double *values, size_t n);
+
+/**
+ * stats_percentile:
+ *
+ * p-th percentile (0-100) of n sorted values, interpolating between the two
+ * closest ranks.
+ */
+double
+stats_percentile(const double *sorted, size_t n, double p);
+
+/**
+ * stats_spread:
+ *
+ * Median of a sample and a robust estimate of its standard deviation, out of
+ * the median absolute deviation (or of the mean absolute deviation when most
+ * values are the same). A handful of outliers doesn't move either of them.
+ */
+struct stats_spread {
+	double median;
+	double scale;
+};
+
+/*
+ * tmp has room for n values
+ */
+void
+stats_spread(const double *sorted, size_t n, double *tmp,
+	     struct stats_spread *spread);
+
+/**
+ * stats_robust_z:
+ *
+ * How many (robust) standard deviations away from the median value is, 0 if
+ * the sample has no spread at all.
+ */
+double
+stats_robust_z(const struct stats_spread *spread, double value);
+
+#endif
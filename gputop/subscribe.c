@@ -0,0 +1,498 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "subscribe.h"
+
+#define SUB_BACKLOG		16
+#define SUB_QUEUE_SIZE		4096
+
+static int
+sub_set_nonblock(int fd)
+{
+	return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static int
+sub_sockaddr(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+int
+sub_server_open(struct sub_server *srv, const char *path,
+		const struct trace_chip *chip,
+		const struct trace_column *columns, uint32_t nr_columns)
+{
+	struct trace_header hdr = {};
+	struct sockaddr_un addr;
+	struct timespec ts;
+	struct stat st;
+
+	memset(srv, 0, sizeof(*srv));
+	srv->fd = -1;
+
+	if (sub_sockaddr(&addr, path) < 0)
+		return -1;
+
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	hdr.version = TRACE_VERSION;
+	hdr.byte_order = TRACE_BYTE_ORDER;
+	hdr.header_size = sizeof(hdr) + nr_columns * sizeof(*columns);
+	hdr.nr_columns = nr_columns;
+	hdr.rows_per_block = 1;
+	hdr.chip = *chip;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	hdr.start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	if (buf_init(&srv->header, hdr.header_size) < 0)
+		return -1;
+	buf_append(&srv->header, (const char *) &hdr, sizeof(hdr));
+	buf_append(&srv->header, (const char *) columns, nr_columns * sizeof(*columns));
+	srv->nr_columns = nr_columns;
+
+	srv->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (srv->fd < 0)
+		goto err;
+
+	/* left behind by a previous daemon */
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	if (bind(srv->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		goto err;
+	srv->path = strdup(path);
+
+	if (sub_set_nonblock(srv->fd) < 0 || listen(srv->fd, SUB_BACKLOG) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	sub_server_close(srv);
+	return -1;
+}
+
+static void
+sub_client_drop(struct sub_server *srv, size_t i)
+{
+	struct sub_client *c = &srv->clients[i];
+
+	close(c->fd);
+	buf_free(&c->out);
+
+	srv->clients[i] = srv->clients[--srv->nr_clients];
+}
+
+void
+sub_server_close(struct sub_server *srv)
+{
+	while (srv->nr_clients)
+		sub_client_drop(srv, srv->nr_clients - 1);
+	free(srv->clients);
+	srv->clients = NULL;
+	srv->size = 0;
+
+	if (srv->fd >= 0)
+		close(srv->fd);
+	srv->fd = -1;
+
+	if (srv->path) {
+		unlink(srv->path);
+		free(srv->path);
+		srv->path = NULL;
+	}
+
+	buf_free(&srv->header);
+}
+
+/*
+ * send as much as the socket takes, queue the rest
+ */
+static int
+sub_client_send(struct sub_client *c, const char *data, size_t len)
+{
+	if (!c->out.len) {
+		ssize_t nr = send(c->fd, data, len, MSG_NOSIGNAL);
+
+		if (nr < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			return -1;
+		if (nr > 0) {
+			data += nr;
+			len -= nr;
+		}
+	}
+
+	if (!len)
+		return 0;
+
+	if (c->out.len + len > SUB_MAX_QUEUED)
+		return -1;
+
+	buf_append(&c->out, data, len);
+	return c->out.truncated ? -1 : 0;
+}
+
+static int
+sub_client_flush(struct sub_client *c)
+{
+	ssize_t nr;
+
+	if (!c->out.len)
+		return 0;
+
+	nr = send(c->fd, c->out.data, c->out.len, MSG_NOSIGNAL);
+	if (nr < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+
+	memmove(c->out.data, c->out.data + nr, c->out.len - nr);
+	c->out.len -= nr;
+	return 0;
+}
+
+static int
+sub_client_read(struct sub_client *c)
+{
+	while (1) {
+		ssize_t nr = read(c->fd, (char *) &c->in + c->in_len,
+				  sizeof(c->in) - c->in_len);
+
+		if (nr < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		if (nr == 0)
+			return -1;
+
+		c->in_len += nr;
+		if (c->in_len < sizeof(c->in))
+			continue;
+
+		c->in_len = 0;
+		if (c->in.magic != SUB_REQUEST_MAGIC || c->in.version != SUB_VERSION)
+			return -1;
+
+		c->req = c->in;
+		c->subscribed = true;
+	}
+}
+
+static void
+sub_server_accept(struct sub_server *srv)
+{
+	int fd;
+
+	while ((fd = accept(srv->fd, NULL, NULL)) >= 0) {
+		struct sub_client *c;
+
+		if (srv->nr_clients == srv->size) {
+			size_t size = srv->size ? srv->size * 2 : 4;
+			c = realloc(srv->clients, size * sizeof(*c));
+			if (!c) {
+				close(fd);
+				continue;
+			}
+			srv->clients = c;
+			srv->size = size;
+		}
+
+		c = &srv->clients[srv->nr_clients];
+		memset(c, 0, sizeof(*c));
+		c->fd = fd;
+
+		if (sub_set_nonblock(fd) < 0 || buf_init(&c->out, SUB_QUEUE_SIZE) < 0) {
+			close(fd);
+			continue;
+		}
+		srv->nr_clients++;
+
+		if (sub_client_send(c, srv->header.data, srv->header.len) < 0)
+			sub_client_drop(srv, srv->nr_clients - 1);
+	}
+}
+
+uint32_t
+sub_server_next(struct sub_server *srv, uint32_t *ctx)
+{
+	bool found = false, wrapped = false;
+	uint32_t next = 0, first = 0;
+	uint32_t groups = 0;
+
+	/* the next context after the last one, or the first one */
+	for (size_t i = 0; i < srv->nr_clients; i++) {
+		const struct sub_client *c = &srv->clients[i];
+
+		if (!c->subscribed || !c->req.groups)
+			continue;
+
+		if (!wrapped || c->req.ctx < first) {
+			first = c->req.ctx;
+			wrapped = true;
+		}
+		if (c->req.ctx > srv->ctx && (!found || c->req.ctx < next)) {
+			next = c->req.ctx;
+			found = true;
+		}
+	}
+
+	if (!wrapped)
+		return 0;
+
+	srv->ctx = found ? next : first;
+	*ctx = srv->ctx;
+
+	for (size_t i = 0; i < srv->nr_clients; i++) {
+		const struct sub_client *c = &srv->clients[i];
+
+		if (c->subscribed && c->req.ctx == srv->ctx)
+			groups |= c->req.groups;
+	}
+
+	return groups;
+}
+
+void
+sub_server_publish(struct sub_server *srv, uint32_t ctx, const uint64_t *row)
+{
+	struct sub_window win = {
+		.magic = SUB_WINDOW_MAGIC,
+		.ctx = ctx,
+		.seq = srv->seq++,
+	};
+	size_t len = srv->nr_columns * sizeof(*row);
+	char msg[sizeof(win) + len];
+
+	/* one send() per subscriber */
+	memcpy(msg, &win, sizeof(win));
+	memcpy(msg + sizeof(win), row, len);
+
+	for (size_t i = srv->nr_clients; i-- > 0;) {
+		struct sub_client *c = &srv->clients[i];
+
+		if (!c->subscribed || c->req.ctx != ctx)
+			continue;
+
+		if (sub_client_send(c, msg, sizeof(msg)) < 0)
+			sub_client_drop(srv, i);
+	}
+}
+
+size_t
+sub_server_pollfds(const struct sub_server *srv, struct pollfd *pfds)
+{
+	size_t nr = srv->nr_clients;
+
+	pfds[0].fd = srv->fd;
+	pfds[0].events = POLLIN;
+	for (size_t i = 0; i < nr; i++) {
+		pfds[i + 1].fd = srv->clients[i].fd;
+		pfds[i + 1].events = POLLIN;
+		if (srv->clients[i].out.len)
+			pfds[i + 1].events |= POLLOUT;
+	}
+
+	return nr + 1;
+}
+
+void
+sub_server_dispatch(struct sub_server *srv, const struct pollfd *pfds)
+{
+	/* backwards, dropping a client moves the last one in its place */
+	for (size_t i = srv->nr_clients; i-- > 0;) {
+		struct sub_client *c = &srv->clients[i];
+		short revents = pfds[i + 1].revents;
+		int err = 0;
+
+		if (revents & POLLIN)
+			err = sub_client_read(c);
+		else if (revents & (POLLERR | POLLHUP | POLLNVAL))
+			err = -1;
+		if (!err && (revents & POLLOUT))
+			err = sub_client_flush(c);
+
+		if (err < 0)
+			sub_client_drop(srv, i);
+	}
+
+	if (pfds[0].revents & POLLIN)
+		sub_server_accept(srv);
+}
+
+static int
+sub_read_all(int fd, void *data, size_t len)
+{
+	char *p = data;
+
+	while (len) {
+		ssize_t nr = read(fd, p, len);
+
+		if (nr < 0 && errno == EINTR)
+			continue;
+		if (nr <= 0) {
+			if (!nr)
+				errno = ECONNRESET;
+			return -1;
+		}
+
+		p += nr;
+		len -= nr;
+	}
+
+	return 0;
+}
+
+int
+sub_request(int fd, uint32_t groups, uint32_t ctx)
+{
+	struct sub_request req = {
+		.magic = SUB_REQUEST_MAGIC,
+		.version = SUB_VERSION,
+		.groups = groups,
+		.ctx = ctx,
+	};
+	const char *p = (const char *) &req;
+	size_t len = sizeof(req);
+
+	while (len) {
+		ssize_t nr = send(fd, p, len, MSG_NOSIGNAL);
+
+		if (nr < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += nr;
+		len -= nr;
+	}
+
+	return 0;
+}
+
+int
+sub_connect(const char *path, uint32_t groups, uint32_t ctx,
+	    struct trace_reader *r)
+{
+	struct trace_header *hdr = &r->hdr;
+	struct sockaddr_un addr;
+	struct trace_block *block;
+	uint64_t *values;
+	int fd;
+
+	memset(r, 0, sizeof(*r));
+
+	if (sub_sockaddr(&addr, path) < 0)
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    sub_request(fd, groups, ctx) < 0 ||
+	    sub_read_all(fd, hdr, sizeof(*hdr)) < 0)
+		goto err;
+
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) ||
+	    hdr->version != TRACE_VERSION || hdr->byte_order != TRACE_BYTE_ORDER ||
+	    hdr->nr_columns < TRACE_COL_STD_NO || hdr->rows_per_block != 1 ||
+	    hdr->header_size != sizeof(*hdr) + hdr->nr_columns * sizeof(struct trace_column)) {
+		errno = EPROTO;
+		goto err;
+	}
+
+	r->columns = calloc(hdr->nr_columns, sizeof(struct trace_column));
+	values = calloc(hdr->nr_columns, sizeof(uint64_t));
+	block = calloc(1, sizeof(*block));
+	r->values = values;
+	r->block = block;
+	if (!r->columns || !values || !block) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	if (sub_read_all(fd, r->columns, hdr->nr_columns * sizeof(struct trace_column)) < 0)
+		goto err;
+
+	for (uint32_t c = 0; c < hdr->nr_columns; c++) {
+		r->columns[c].name[TRACE_NAME_LEN - 1] = '\0';
+		r->columns[c].desc[TRACE_DESC_LEN - 1] = '\0';
+	}
+
+	/* a block of a single row, the window */
+	block->nr_rows = 1;
+	return fd;
+
+err:
+	sub_disconnect(fd, r);
+	return -1;
+}
+
+int
+sub_read_window(int fd, struct trace_reader *r, struct sub_window *win)
+{
+	if (sub_read_all(fd, win, sizeof(*win)) < 0)
+		return -1;
+
+	if (win->magic != SUB_WINDOW_MAGIC) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	return sub_read_all(fd, (uint64_t *) r->values,
+			    r->hdr.nr_columns * sizeof(uint64_t));
+}
+
+void
+sub_disconnect(int fd, struct trace_reader *r)
+{
+	int err = errno;
+
+	if (fd >= 0)
+		close(fd);
+
+	free(r->columns);
+	free((void *) r->values);
+	free((void *) r->block);
+	memset(r, 0, sizeof(*r));
+
+	errno = err;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_SUBSCRIBE_H
+#define __GPUTOP_SUBSCRIBE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <poll.h>
+
+#include "buffer.h"
+#include "trace.h"
+
+/*
+ * gputop --daemon owns the profiler session and publishes its windows to
+ * subscribers over a unix socket. The stream reuses the trace layout:
+ *
+ * 	subscriber -> daemon: struct sub_request, at any time
+ * 	daemon -> subscriber: struct trace_header, nr_columns trace_column,
+ * 			      then for each window a struct sub_window
+ * 			      followed by nr_columns uint64_t values
+ *
+ * header_size being the size of the header and of the column descriptors,
+ * without padding, block_size 0 and rows_per_block 1. Only the groups asked
+ * for are sampled, the values of the others are 0. Subscribers of different
+ * contexts get every other window, the daemon switching between their
+ * contexts.
+ */
+#define SUB_REQUEST_MAGIC	0x51534754	/* GTSQ */
+#define SUB_WINDOW_MAGIC	0x57534754	/* GTSW */
+#define SUB_VERSION		1
+
+/* slow subscribers are dropped once that much is queued for them */
+#define SUB_MAX_QUEUED		(1024 * 1024)
+
+#define SUB_GROUP(g)		(1U << (g))
+
+struct sub_request {
+	uint32_t magic;
+	uint32_t version;
+	/* SUB_GROUP(TRACE_GROUP_*) */
+	uint32_t groups;
+	/* 0 for all of them */
+	uint32_t ctx;
+};
+
+struct sub_window {
+	uint32_t magic;
+	uint32_t ctx;
+	uint64_t seq;
+};
+
+struct sub_client {
+	int fd;
+	struct sub_request req;
+	bool subscribed;
+
+	/* partial request */
+	struct sub_request in;
+	size_t in_len;
+
+	/* what couldn't be sent right away */
+	struct gtop_buf out;
+};
+
+struct sub_server {
+	int fd;
+	char *path;
+
+	struct sub_client *clients;
+	size_t nr_clients;
+	size_t size;
+
+	/* header and column descriptors every subscriber starts with */
+	struct gtop_buf header;
+	uint32_t nr_columns;
+
+	uint64_t seq;
+	/* last context sampled, to go round-robin */
+	uint32_t ctx;
+};
+
+/**
+ * sub_server_open:
+ *
+ * Listen on the unix socket path. Returns -1 and sets errno on failure.
+ */
+int
+sub_server_open(struct sub_server *srv, const char *path,
+		const struct trace_chip *chip,
+		const struct trace_column *columns, uint32_t nr_columns);
+
+void
+sub_server_close(struct sub_server *srv);
+
+/**
+ * sub_server_next:
+ *
+ * Context to sample the next window for, going round-robin over the ones
+ * subscribers asked for. Returns the groups they want, 0 if there's nobody to
+ * sample for.
+ */
+uint32_t
+sub_server_next(struct sub_server *srv, uint32_t *ctx);
+
+/**
+ * sub_server_publish:
+ *
+ * Queue a window sampled for ctx to its subscribers.
+ */
+void
+sub_server_publish(struct sub_server *srv, uint32_t ctx, const uint64_t *row);
+
+/**
+ * sub_server_pollfds:
+ *
+ * What to poll() for: the socket accepting subscribers, then every
+ * subscriber. pfds has room for nr_clients + 1, returns how many are used.
+ */
+size_t
+sub_server_pollfds(const struct sub_server *srv, struct pollfd *pfds);
+
+/**
+ * sub_server_dispatch:
+ *
+ * Accept subscribers, read their requests and send what's queued, as poll()
+ * has found them ready in pfds, filled by sub_server_pollfds().
+ */
+void
+sub_server_dispatch(struct sub_server *srv, const struct pollfd *pfds);
+
+/**
+ * sub_connect:
+ *
+ * Connect to the daemon, subscribe and read the header. r can be used with
+ * trace_value() once sub_read_window() returns, the window being row 0.
+ * Returns the socket, or -1.
+ */
+int
+sub_connect(const char *path, uint32_t groups, uint32_t ctx,
+	    struct trace_reader *r);
+
+/**
+ * sub_request:
+ *
+ * Change the subscription.
+ */
+int
+sub_request(int fd, uint32_t groups, uint32_t ctx);
+
+/**
+ * sub_read_window:
+ *
+ * Blocks until the next window. Returns -1 if the daemon went away.
+ */
+int
+sub_read_window(int fd, struct trace_reader *r, struct sub_window *win);
+
+void
+sub_disconnect(int fd, struct trace_reader *r);
+
+#endif
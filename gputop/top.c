@@ -21,6 +21,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -31,7 +32,6 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <inttypes.h>
@@ -41,6 +41,22 @@
 #include <termios.h>
 
 #include "debugfs.h"
+#include "stats.h"
+#include "buffer.h"
+#include "output.h"
+#include "trace.h"
+#include "report.h"
+#include "serve.h"
+#include "subscribe.h"
+#include "shm.h"
+#include "trace_event.h"
+#include "flight.h"
+#include "screen.h"
+#include "layout.h"
+#include "fmt.h"
+#include "history.h"
+#include "loop.h"
+#include "procs.h"
 
 #include <gpuperfcnt/gpuperfcnt.h>
 #include <gpuperfcnt/gpuperfcnt_vivante.h>
@@ -61,8 +77,16 @@ static const char *version = "1.4";
 
 /* if a SIGINT/SIGTERM has been received */
 static int volatile sig_recv = 0;
-/* if a resize signal has been received */
-static int volatile resized = 0;
+/* resize signals received so far */
+static unsigned int volatile resized = 0;
+
+/* where we wait for windows, keys and signals */
+static struct loop loop;
+
+/* pages are rendered to it, then only what changed goes to the terminal */
+static struct screen screen;
+/* resized when the screen was last sized */
+static unsigned int screen_resized = 0;
 
 /* for/not reading counters */
 static bool paused = false;
@@ -90,10 +114,69 @@ static const char *governor_names[] = { "underdrive", "nominal", "overdrive" };
 /* the  # of samples to take in a period of time  */
 static int samples = 100;
 
+/* how often we refresh the display, or output a window in batch mode */
+static struct timespec refresh = {
+	.tv_sec = DELAY_SECS,
+	.tv_nsec = DELAY_NSECS,
+};
+
+/* machine readable output, batch mode only */
+static struct output output = {
+	.format = OUTPUT_TEXT,
+};
+static struct gtop_buf output_buf;
+
+/* every window is written to, or read from, a trace */
+static const char *record_path = NULL;
+static const char *replay_path = NULL;
+static struct trace_time replay_from;
+static struct trace_time replay_to;
+static struct trace_writer trace_writer;
+static uint64_t *trace_row = NULL;
+/* SIGUSR2 marks the next recorded window */
+static int volatile trace_marker = 0;
+/* client memory is expensive to walk, keep it for a second */
+static uint64_t trace_mem[TRACE_MEM_NO];
+static uint64_t trace_mem_ns = 0;
+
+/* metrics exporter, serves the latest window */
+static const char *serve_address = NULL;
+static struct serve server = {
+	.fd = -1,
+};
+
+/* the daemon publishes windows to subscribers, --connect subscribes */
+static const char *daemon_path = NULL;
+static const char *connect_path = NULL;
+static struct sub_server subscribers = {
+	.fd = -1,
+};
+static uint32_t daemon_groups = 0;
+
+/* the latest window in shared memory, for readers polling it */
+static const char *shm_name = NULL;
+static struct shm_writer shm_writer;
+
+/* counter tracks for Perfetto or chrome://tracing */
+static const char *trace_events_path = NULL;
+static struct trace_event_writer trace_events;
+
+/* the last windows, dumped on SIGUSR1 or when a trigger fires */
+static const char *flight_path = NULL;
+static uint64_t flight_length_ns = 60 * NSEC_PER_SEC;
+static const char *flight_triggers[FLIGHT_MAX_TRIGGERS];
+static size_t nr_flight_triggers = 0;
+static struct flight flight;
+static int volatile flight_requested = 0;
+
 /* current mode */
 enum display_mode mode = MODE_PERF_SHOW_CLIENTS;
 /* current display mode for counters */
 enum display_samples samples_mode = SAMPLES_TIME;
+/* how counter values are normalized */
+static struct gtop_rate rate = {
+	.rate = RATE_SECOND,
+};
 /* curr page we're at */
 uint8_t curr_page = PAGE_SHOW_CLIENTS;
 
@@ -103,6 +186,21 @@ static uint32_t selected_ctx = 0;
 /* associated client we're tracking */
 static struct debugfs_client *selected_client = NULL;
 
+/* which process owns which context, to validate selected_ctx */
+static struct debugfs_ctx_index ctx_index;
+
+/* process followed with -p or -n, attached again as its contexts change */
+static struct follow {
+	uint32_t pid;
+	const char *name;
+
+	/* ctx_index generation looked at last */
+	uint32_t generation;
+} follow;
+
+/* contexts rotated through with --rotate, and their processes */
+static struct procs procs;
+
 /* our prg name */
 static const char *prg_name = "gputop";
 
@@ -125,29 +223,190 @@ const char *display_samples_names[] = {
 	"TIME", "AVERAGE", "MIN", "MAX",
 };
 
+static const char *rate_names[] = {
+	[RATE_WINDOW]	= "per window",
+	[RATE_SECOND]	= "per second",
+	[RATE_FRAME]	= "per frame",
+};
+
 static struct p_page program_pages[] = {
-	[PAGE_SHOW_CLIENTS]	= { PAGE_SHOW_CLIENTS, "Clients attached to GPU" },
-	[PAGE_COUNTER_PART1]	= { PAGE_COUNTER_PART1, "HW Counters (context 1)" },
-	[PAGE_COUNTER_PART2]	= { PAGE_COUNTER_PART2, "HW Counters (context 2)" },
-	[PAGE_DMA]		= { PAGE_DMA, "DMA engines" },
-	[PAGE_OCCUPANCY]	= { PAGE_OCCUPANCY, "Occupancy" },
-	[PAGE_VID_MEM_USAGE]	= { PAGE_VID_MEM_USAGE, "VidMem" },
+	[PAGE_SHOW_CLIENTS]	= { PAGE_SHOW_CLIENTS, "Clients attached to GPU", "clients" },
+	[PAGE_COUNTER_PART1]	= { PAGE_COUNTER_PART1, "HW Counters (context 1)", "counter_1" },
+	[PAGE_COUNTER_PART2]	= { PAGE_COUNTER_PART2, "HW Counters (context 2)", "counter_2" },
+	[PAGE_DMA]		= { PAGE_DMA, "DMA engines", "dma" },
+	[PAGE_OCCUPANCY]	= { PAGE_OCCUPANCY, "Occupancy", "occupancy" },
+	[PAGE_VID_MEM_USAGE]	= { PAGE_VID_MEM_USAGE, "VidMem", "vidmem" },
 #if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
-	[PAGE_DDR_PERF]		= { PAGE_DDR_PERF, "DDR" },
+	[PAGE_DDR_PERF]		= { PAGE_DDR_PERF, "DDR", "ddr" },
 #endif
 };
 
 struct dma_table dma_tables[] = {
-	{ CMD_STATE, "Command state", NUM_VIV_CMD_STATE_NAMES, viv_cmd_state_names, NULL },
-	{ CMD_DMA_STATE, "Command DMA state", NUM_VIV_CMD_DMA_STATE_NAMES, viv_cmd_dma_state_names, NULL },
-	{ CMD_FETCH_STATE, "Command fetch state", NUM_VIV_CMD_FETCH_STATE_NAMES, viv_cmd_fetch_state_names, NULL },
-	{ CMD_DMA_REQ_STATE, "DMA request state", NUM_VIV_REQ_DMA_STATE_NAMES, viv_req_dma_state_names, NULL },
-	{ CMD_CAL_STATE, "Cal state", NUM_VIV_CAL_STATE_NAMES, viv_cal_state_names, NULL },
-	{ CMD_VE_REQ_STATE, "VE req state", NUM_VIV_VE_REQ_STATE_NAMES, viv_ve_req_state_names, NULL }
+	{ CMD_STATE, "Command state", "cmd_state", NUM_VIV_CMD_STATE_NAMES, viv_cmd_state_names, NULL },
+	{ CMD_DMA_STATE, "Command DMA state", "cmd_dma_state", NUM_VIV_CMD_DMA_STATE_NAMES, viv_cmd_dma_state_names, NULL },
+	{ CMD_FETCH_STATE, "Command fetch state", "cmd_fetch_state", NUM_VIV_CMD_FETCH_STATE_NAMES, viv_cmd_fetch_state_names, NULL },
+	{ CMD_DMA_REQ_STATE, "DMA request state", "dma_req_state", NUM_VIV_REQ_DMA_STATE_NAMES, viv_req_dma_state_names, NULL },
+	{ CMD_CAL_STATE, "Cal state", "cal_state", NUM_VIV_CAL_STATE_NAMES, viv_cal_state_names, NULL },
+	{ CMD_VE_REQ_STATE, "VE req state", "ve_req_state", NUM_VIV_VE_REQ_STATE_NAMES, viv_ve_req_state_names, NULL }
 };
 
 #define NUM_DMA_TABLES (sizeof(dma_tables) / sizeof(dma_tables[0]))
 
+/*
+ * counters are "~     1,234,567 description ", descriptions are cut down to
+ * COUNTER_DESC_MIN to fit more columns. DMA states are "  name 12.34 % ".
+ */
+#define COUNTER_FIXED_WIDTH	17
+#define COUNTER_DESC_MIN	16
+#define DMA_STATE_WIDTH		20
+
+/*
+ * memory of the clients, in kB. On narrow terminals the columns go in the
+ * order of client_columns_drop, then the command gets shorter.
+ */
+enum gtop_client_column {
+	CLIENT_RES,
+	CLIENT_CONT,
+	CLIENT_VIRT,
+	CLIENT_NON_PGD,
+	CLIENT_TOTAL,
+	NR_CLIENT_COLUMNS,
+};
+
+static const char *client_columns_names[NR_CLIENT_COLUMNS] = {
+	"RES(kB)", "CONT(kB)", "VIRT(kB)", "Non-PGD(kB)", "Total(kB)",
+};
+static const int client_columns_width[NR_CLIENT_COLUMNS] = {
+	10, 11, 11, 13, 11,
+};
+static const int client_columns_drop[] = {
+	CLIENT_NON_PGD, CLIENT_VIRT, CLIENT_CONT, -1,
+};
+
+#define CLIENT_PID_WIDTH	8
+#define CLIENT_CMD_MIN		8
+#define CLIENT_CMD_MAX		32
+#define CLIENT_CTX_WIDTH	16
+
+/*
+ * what the clients are sorted by, in the order the o key goes through them.
+ * The memory columns go down, the PID up.
+ */
+#define CLIENT_SORT_PID		NR_CLIENT_COLUMNS
+
+/* the line with where we are in the list, the totals */
+#define CLIENT_FOOTER_LINES	3
+
+static const struct {
+	const char *name;
+	int key;
+} client_sort_keys[] = {
+	{ "total",	CLIENT_TOTAL },
+	{ "res",	CLIENT_RES },
+	{ "cont",	CLIENT_CONT },
+	{ "virt",	CLIENT_VIRT },
+	{ "non-pgd",	CLIENT_NON_PGD },
+	{ "pid",	CLIENT_SORT_PID },
+};
+
+struct gtop_client_row {
+	struct debugfs_client *client;
+	uint64_t values[NR_CLIENT_COLUMNS];
+};
+
+/* kept from a refresh to the next, only the rows shown get sorted */
+static struct {
+	struct gtop_client_row *rows;
+	size_t nr;
+	size_t size;
+
+	/* in client_sort_keys */
+	size_t sort;
+	/* first row shown, and how many fit the last time, what a page is */
+	size_t first;
+	size_t page;
+} clients_table;
+
+/*
+ * The pickers are drawn in place of the page and get the keys while open,
+ * sampling goes on meanwhile.
+ */
+enum gtop_picker_type {
+	PICKER_NONE,
+	/* the context to read counters for */
+	PICKER_CONTEXT,
+	/* samples per window */
+	PICKER_SAMPLES,
+};
+
+#define PICKER_SAMPLES_DIGITS	6
+
+struct gtop_picker_entry {
+	uint32_t pid;
+	uint32_t ctx;
+	const char *name;
+};
+
+static struct {
+	enum gtop_picker_type type;
+
+	/* clients and their contexts as they were when it was opened */
+	struct debugfs_client clients;
+	struct gtop_picker_entry *entries;
+	size_t nr_entries;
+	size_t size;
+	size_t cursor;
+	size_t first;
+
+	/* the number being typed */
+	char input[PICKER_SAMPLES_DIGITS + 1];
+	size_t input_len;
+
+	/* instead of the entries, when there's nothing to pick */
+	const char *message;
+} picker;
+
+/* video memory pools, "%5u" each after a "%6u" PID */
+static const struct {
+	const char *name;
+	size_t offset;
+} vid_mem_pools[] = {
+	{ "IN",		offsetof(struct debugfs_vid_mem_client, index) },
+	{ "VE",		offsetof(struct debugfs_vid_mem_client, vertex) },
+	{ "TE",		offsetof(struct debugfs_vid_mem_client, texture) },
+	{ "RT",		offsetof(struct debugfs_vid_mem_client, render_target) },
+	{ "DE",		offsetof(struct debugfs_vid_mem_client, depth) },
+	{ "BM",		offsetof(struct debugfs_vid_mem_client, bitmap) },
+	{ "TS",		offsetof(struct debugfs_vid_mem_client, tile_status) },
+	{ "IM",		offsetof(struct debugfs_vid_mem_client, image) },
+	{ "MA",		offsetof(struct debugfs_vid_mem_client, mask) },
+	{ "SC",		offsetof(struct debugfs_vid_mem_client, scissor) },
+	{ "HZ",		offsetof(struct debugfs_vid_mem_client, hz) },
+	{ "IC",		offsetof(struct debugfs_vid_mem_client, i_cache) },
+	{ "TD",		offsetof(struct debugfs_vid_mem_client, tx_desc) },
+	{ "FE",		offsetof(struct debugfs_vid_mem_client, fence) },
+	{ "TFB",	offsetof(struct debugfs_vid_mem_client, tfbheader) },
+};
+
+#define NUM_VID_MEM_POOLS (sizeof(vid_mem_pools) / sizeof(vid_mem_pools[0]))
+#define VID_MEM_PID_WIDTH	6
+#define VID_MEM_POOL_WIDTH	6
+
+/* pages laid out for the terminal size, done again only when it changes */
+static struct {
+	int cols;
+
+	struct layout_grid counters[VIV_PROF_COUNTER_PART2 + 1];
+	struct layout_grid dma[NUM_DMA_TABLES];
+
+	bool clients_shown[NR_CLIENT_COLUMNS];
+	bool clients_contexts;
+	int clients_cmd;
+
+	/* pools per table, the others go in the tables below */
+	size_t vid_mem_pools;
+} layout = { .cols = -1 };
+
 #if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
 /* what DDR pmus we want to read, if you want to add more you also need
  * to modify PERF_DDR_PMUS_COUNT  */
@@ -161,58 +420,140 @@ static struct perf_pmu_ddr perf_pmu_axid_ddrs[] = {
   };
 
 #endif
+
+/*
+ * the last windows of what the pages show, drawn by the history view. Rings
+ * of percentages are in hundredths and drawn against 100%, the others
+ * against the largest value seen.
+ */
+#define HISTORY_DESC_WIDTH	24
+/* without a terminal */
+#define HISTORY_TEXT_COLS	80
+
+static struct {
+	bool init;
+	/* -1 until chosen */
+	int style;
+
+	struct history occupancy[NUM_VIV_IDLE_MODULES];
+	struct history usage[2];
+	struct history *dma;
+	struct history *counters[VIV_PROF_COUNTER_PART2 + 1];
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+	/* MB, in hundredths */
+	struct history ddr[ARRAY_SIZE(perf_pmu_ddrs)][PERF_DDR_PMUS_COUNT];
+#endif
+} history = { .style = -1 };
+
 static int gtop_enable_profiling(struct perf_device *dev);
+static bool gtop_trace_wanted(void);
 
-static uint64_t
-get_ns_time(void)
+/*
+ * serial consoles often don't know, fall back to what the shell says
+ */
+static void
+gtop_screen_size(int *rows, int *cols)
 {
-	struct timespec ts;
+	struct winsize ws = {};
+	const char *env;
+
+	ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
+	*rows = ws.ws_row;
+	*cols = ws.ws_col;
+
+	if (!*rows)
+		*rows = (env = getenv("LINES")) ? atoi(env) : 0;
+	if (!*cols)
+		*cols = (env = getenv("COLUMNS")) ? atoi(env) : 0;
+
+	if (*rows <= 0)
+		*rows = 24;
+	if (*cols <= 0)
+		*cols = 80;
+}
 
-	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
-		dprintf("clock_gettime()");
+/*
+ * a grid of cells only makes sense on a terminal we own
+ */
+static void
+gtop_screen_init(void)
+{
+	bool grid = isatty(STDOUT_FILENO) && output.format == OUTPUT_TEXT &&
+		    !FLAG_IS_SET(flags, FLAG_SHOW_BATCH_PERF);
+	int rows = 0, cols = 0;
+
+	if (grid)
+		gtop_screen_size(&rows, &cols);
+
+	if (screen_init(&screen, grid, rows, cols) < 0) {
+		dprintf("malloc?\n");
 		exit(EXIT_FAILURE);
 	}
-
-	return (ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
 }
 
 /*
- * format uint64_t
+ * the tables laid out once for the width of the terminal, counters and DMA
+ * states are laid out when displayed as they also depend on the page
  */
 static void
-format_number(char *num, size_t num_len, uint64_t sample)
+gtop_layout(void)
 {
-	char tmp[100];
-	size_t len;
+	bool contexts = FLAG_IS_SET(flags, FLAG_SHOW_CONTEXTS);
+	int cols = screen.cols;
+	int left;
+	size_t i;
 
-	int groups, group_size;
-	size_t in_ptr, out_ptr;
-	int i, j;
+	if (layout.cols == cols && layout.clients_contexts == contexts)
+		return;
+
+	layout.cols = cols;
+	layout.clients_contexts = contexts;
 
-	if (num_len == 0)
+	if (!cols) {
+		for (i = 0; i < NR_CLIENT_COLUMNS; i++)
+			layout.clients_shown[i] = true;
+		layout.clients_cmd = CLIENT_CMD_MAX;
+		layout.vid_mem_pools = NUM_VID_MEM_POOLS;
 		return;
+	}
 
-	snprintf(tmp, sizeof(tmp), "%llu", (unsigned long long) sample);
-	len = strlen(tmp);
+	left = cols - CLIENT_PID_WIDTH - 2 - (contexts ? CLIENT_CTX_WIDTH : 0);
+	left = layout_columns(layout.clients_shown, client_columns_width,
+			      client_columns_drop, NR_CLIENT_COLUMNS, left,
+			      CLIENT_CMD_MIN);
+	layout.clients_cmd = left > CLIENT_CMD_MAX ? CLIENT_CMD_MAX : left;
+
+	layout.vid_mem_pools = (cols - VID_MEM_PID_WIDTH) / VID_MEM_POOL_WIDTH;
+	if (cols < VID_MEM_PID_WIDTH + VID_MEM_POOL_WIDTH)
+		layout.vid_mem_pools = 1;
+	if (layout.vid_mem_pools > NUM_VID_MEM_POOLS)
+		layout.vid_mem_pools = NUM_VID_MEM_POOLS;
+}
 
-	groups = (len + 2) / 3;
-	group_size = len - (groups - 1) * 3;
-	in_ptr = out_ptr = 0;
+static uint64_t
+get_ns_time(void)
+{
+	struct timespec ts;
 
-	num_len -= 1;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		dprintf("clock_gettime()");
+		exit(EXIT_FAILURE);
+	}
 
-	for (i = 0; i < groups && out_ptr < num_len; i++) {
-		for (j = 0; j < group_size && out_ptr < num_len; j++) {
-			num[out_ptr++] = tmp[in_ptr++];
-		}
-		if (i != (groups - 1) && out_ptr < num_len) {
-			num[out_ptr++] = ',';
-		}
+	return (ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
 
-		group_size = 3;
+static uint64_t
+get_realtime_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) < 0) {
+		dprintf("clock_gettime()");
+		exit(EXIT_FAILURE);
 	}
 
-	num[out_ptr] = '\0';
+	return (ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
 }
 
 static void
@@ -251,35 +592,42 @@ tty_reset(struct termios *tty_o)
 	tcsetattr(STDIN_FILENO, TCSAFLUSH, tty_o);
 }
 
+/*
+ * every wait goes through the loop, which also tells about the signals
+ */
 static int
-get_input_char(void)
+gtop_wait(unsigned events, struct pollfd *fds, size_t nr, int64_t timeout_ns)
 {
-	fd_set fds;
-	int rc;
+	int ev = loop_wait(&loop, events, fds, nr, timeout_ns);
 
-	FD_ZERO(&fds);
-	FD_SET(STDIN_FILENO, &fds);
+	if (ev < 0) {
+		dprintf("Failed to wait: %s\n", strerror(errno));
+		return -1;
+	}
 
-#if defined __QNXTO__ || defined __QNX__
-	struct timeval tval = {};
-	tval.tv_sec = DELAY_SECS;
-	tval.tv_usec = DELAY_NSECS / 1000;
-	rc = select(STDIN_FILENO + 1, &fds, NULL, NULL, &tval);
-#else
-	struct timespec ts = {};
-	/* one second time out */
-	ts.tv_sec = DELAY_SECS;
-	ts.tv_nsec = DELAY_NSECS;
-	rc = pselect(STDIN_FILENO + 1, &fds, NULL, NULL, &ts, NULL);
-#endif
+	if (ev & LOOP_QUIT)
+		sig_recv = 1;
+	if (ev & LOOP_RESIZE)
+		resized++;
 
-	return (rc < 0) ? 0 : rc;
+	return ev;
 }
 
-static void
-delay(void)
+/*
+ * until a key is pressed, false if we're asked to quit meanwhile
+ */
+static bool
+gtop_wait_input(void)
 {
-	nanosleep(&(struct timespec) { .tv_sec = DELAY_SECS, .tv_nsec = DELAY_NSECS }, NULL);
+	int ev;
+
+	do {
+		if (loop.input_fd < 0)
+			return false;
+		ev = gtop_wait(LOOP_INPUT, NULL, 0, -1);
+	} while (ev >= 0 && !(ev & LOOP_INPUT) && !sig_recv);
+
+	return ev > 0 && (ev & LOOP_INPUT);
 }
 
 /*
@@ -294,6 +642,20 @@ gtop_get_clocks_governor(struct gtop_clocks_governor *d)
 	debugfs_get_current_gpu_governor(&d->governor);
 }
 
+/*
+ * if we're currently viewing one of the hardware counter pages
+ */
+static bool
+gtop_is_counter_page(void)
+{
+	if (FLAG_IS_SET(flags, FLAG_MODE))
+		return mode == MODE_PERF_COUNTER_PART1 ||
+		       mode == MODE_PERF_COUNTER_PART2;
+
+	return curr_page == PAGE_COUNTER_PART1 ||
+	       curr_page == PAGE_COUNTER_PART2;
+}
+
 static bool
 gtop_is_chip_model(uint32_t model, struct perf_device *dev)
 {
@@ -312,104 +674,325 @@ gtop_is_chip_model(uint32_t model, struct perf_device *dev)
 	return false;
 }
 
-static void
-gtop_display_interactive_counters(const struct gtop_data *gtop,
-				  uint32_t id, bool display_nl,
-				  struct perf_device *dev)
+/*
+ * Counters are stored unscaled, normalize them only when displaying. Only the
+ * TIME view is normalized, MIN/MAX/AVERAGE are per sample.
+ */
+static uint64_t
+gtop_counter_value(const struct gtop_data *gtop_d, uint32_t id)
 {
-	char num[100];
-	struct perf_counter_info *info;
+	uint64_t events;
 
 	switch (samples_mode) {
 	case SAMPLES_TIME:
-		format_number(num, sizeof(num), gtop->events_per_sample[id]);
-		break;
+		events = stats_mux_scale(gtop_d->events_per_sample[id],
+					 gtop_d->time_enabled, gtop_d->time_running);
+		return stats_rate(events, rate.rate, gtop_d->time_enabled, rate.frames);
 	case SAMPLES_MIN:
-		format_number(num, sizeof(num), gtop->events_per_sample_min[id]);
-		break;
+		return gtop_d->events_per_sample_min[id];
 	case SAMPLES_AVERAGE:
-		format_number(num, sizeof(num), gtop->events_per_sample_average[id]);
-		break;
+		if (!gtop_d->nr_average_samples)
+			return 0;
+		return gtop_d->events_per_sample_average[id] / gtop_d->nr_average_samples;
 	case SAMPLES_MAX:
-		format_number(num, sizeof(num), gtop->events_per_sample_max[id]);
-		break;
+		return gtop_d->events_per_sample_max[id];
 	default:
 		abort();
 	}
+}
 
-	info = perf_get_counter_info(gtop->type, id, dev);
-	if (!info)
-		return;
+/*
+ * the history of a metric, in what the line leaves, used columns being taken
+ */
+static void
+gtop_display_history(const struct history *h, int used)
+{
+	int cols = screen.cols ? screen.cols : HISTORY_TEXT_COLS;
+
+	screen_putc(&screen, ' ');
+	history_draw(h, &screen.text, cols - used - 1, history.style);
+}
 
-	if (!display_nl)
-		fprintf(stdout, "%15.15s %-50.50s ", num, info->desc);
+/*
+ * n/a when there's no per frame value
+ */
+static void
+gtop_display_counter_value(uint64_t value, int width)
+{
+	if (value == STATS_RATE_NONE)
+		screen_printf(&screen, "%*s", width, "n/a");
 	else
-		fprintf(stdout, "%15.15s %-50.50s\n", num, info->desc);
+		screen_u64(&screen, value, width, true);
+}
+
+static void
+gtop_display_interactive_counters(const struct gtop_data *gtop,
+				  uint32_t id, int label, bool display_nl)
+{
+	/* mark extrapolated values when multiplexing */
+	char scaled = (gtop->time_running < gtop->time_enabled) ? '~' : ' ';
+
+	screen_putc(&screen, scaled);
+	gtop_display_counter_value(gtop_counter_value(gtop, id), 14);
+	screen_printf(&screen, " %-*.*s", label, label, gtop->desc[id].display);
+	screen_putc(&screen, display_nl ? '\n' : ' ');
 }
 
+/*
+ * rows is how many lines the counters can take on the terminal
+ */
 static void
-gtop_display_interactive_mode_perf(const struct gtop_data *gtop,
-				   struct perf_device *dev)
+gtop_display_interactive_mode_perf(const struct gtop_data *gtop, int rows)
 {
 	/*
-	 * display the counter(s) over two columns so that we can
-	 * print all of them. Have to see what to do in case the columns
-	 * do not fit.
+	 * display the counter(s) over as many columns as the terminal
+	 * takes, row by row:
 	 *
-	 * num_value	descriptions	num_value	description
+	 * num_value	descriptions	num_value	description ...
 	 *
 	 */
+	struct layout_grid *grid = &layout.counters[gtop->type];
 	uint32_t c;
-	for (c = 0; c < gtop->num_perf_counters; c += 2) {
-		uint32_t k = c + 1;
-		gtop_display_interactive_counters(gtop, c, false, dev);
 
-		/* we would reach over in case we just print a new line */
-		if (k >= gtop->num_perf_counters) {
-			fprintf(stdout, "\n");
-		} else {
-			gtop_display_interactive_counters(gtop, k, true, dev);
+	/* a counter per line, with its history */
+	if (history.init && FLAG_IS_SET(flags, FLAG_HISTORY)) {
+		for (c = 0; c < gtop->num_perf_counters; c++) {
+			gtop_display_interactive_counters(gtop, c, HISTORY_DESC_WIDTH, false);
+			gtop_display_history(&history.counters[gtop->type][c],
+					     COUNTER_FIXED_WIDTH + HISTORY_DESC_WIDTH);
+			screen_putc(&screen, '\n');
 		}
+		return;
+	}
+
+	layout_grid(grid, rows, screen.cols, gtop->num_perf_counters,
+		    COUNTER_FIXED_WIDTH, COUNTER_DESC_MIN, COUNTER_DESC_WIDTH);
+
+	for (c = 0; c < gtop->num_perf_counters; c++) {
+		bool display_nl = (c + 1) % grid->columns == 0 ||
+				  c + 1 == gtop->num_perf_counters;
+
+		gtop_display_interactive_counters(gtop, c, grid->label, display_nl);
 	}
 }
 
+/*
+ * processes with the sum of the counters of their contexts, the busiest first,
+ * and the contexts of the one followed below it. Values marked with '~' are
+ * scaled estimates.
+ */
+#define PROCS_PID_WIDTH		8
+#define PROCS_NAME_WIDTH	16
+#define PROCS_COUNTER_WIDTH	14
+
 static void
-gtop_display_interactive_mode_occupancy(const struct vivante_gpu_state *st)
+gtop_display_procs_row(const struct gtop *gtop, uint32_t nr_counters,
+		       uint32_t pid, const char *name, uint32_t nr_ctx,
+		       const uint64_t *events, uint64_t enabled, uint64_t running)
 {
-	double percent;
-	size_t i;
+	screen_u64(&screen, pid, PROCS_PID_WIDTH, false);
+	screen_printf(&screen, " %-*.*s", PROCS_NAME_WIDTH, PROCS_NAME_WIDTH, name);
+	screen_u64(&screen, nr_ctx, 5, false);
+
+	screen_putc(&screen, ' ');
+	screen_fixed2(&screen, fmt_hundredths(stats_mux_active(enabled, running)), 6);
+	screen_putc(&screen, '%');
+
+	for (uint32_t c = 0; c < nr_counters; c++) {
+		screen_putc(&screen, ' ');
+		screen_putc(&screen, running < enabled ? '~' : ' ');
+		gtop_display_counter_value(stats_rate(events[c], rate.rate,
+						      gtop->window_ns, rate.frames),
+					   PROCS_COUNTER_WIDTH - 2);
+	}
 
-	for (i = 0; i < NUM_VIV_IDLE_MODULES; i++) {
-		percent = 
-			100.0f * (double) st->viv_idle_states[i] /
-			(double) samples;
+	screen_putc(&screen, '\n');
+}
+
+static void
+gtop_display_procs(const struct gtop *gtop, enum vivante_profiler_type_counter type)
+{
+	const struct gtop_data *gtop_d = gtop->perf_data[type];
+	int fixed = PROCS_PID_WIDTH + 1 + PROCS_NAME_WIDTH + 5 + 8;
+	int cols = screen.cols ? screen.cols : HISTORY_TEXT_COLS;
+	uint32_t nr_counters = 1;
+	size_t nr_rows, shown = 0;
+
+	if (cols > fixed + PROCS_COUNTER_WIDTH)
+		nr_counters = (cols - fixed) / PROCS_COUNTER_WIDTH;
+	if (nr_counters > gtop_d->num_perf_counters)
+		nr_counters = gtop_d->num_perf_counters;
+
+	procs_sort(&procs, 0);
+
+	screen_puts(&screen, underlined_color);
+	screen_printf(&screen, "%*s %-*s %4s %7s", PROCS_PID_WIDTH, "PID",
+			PROCS_NAME_WIDTH, "CMD", "CTXS", "SAMPLED");
+	for (uint32_t c = 0; c < nr_counters; c++)
+		screen_printf(&screen, " %*.*s", PROCS_COUNTER_WIDTH - 1,
+				PROCS_COUNTER_WIDTH - 1, gtop_d->desc[c].desc);
+	screen_printf(&screen, "%s\n", regular_color);
+
+	/* page just switched, nothing rotated for this group yet */
+	if (!gtop->rotate.slot_events || gtop->rotate.type != type)
+		return;
 
-		/* if it inverse subtract */
-		if (vivante_idle_module_names[i].inv)
-			percent = 100.0f - percent;
+	/* what fits above the last line, all of them when not a terminal */
+	nr_rows = procs.nr_procs + procs.nr_ctxs;
+	if (screen.rows) {
+		int left = screen.rows - screen_lines(&screen) - 2;
 
-		fprintf(stdout, " %s %.2f%%\n", vivante_idle_module_names[i].name,
-				percent);
+		nr_rows = left > 1 ? (size_t) left : 1;
 	}
 
+	for (size_t i = 0; i < procs.nr_procs && shown < nr_rows; i++, shown++) {
+		const struct procs_proc *proc = &procs.procs[i];
+
+		gtop_display_procs_row(gtop, nr_counters, proc->pid, proc->name,
+				       proc->nr_ctx, proc->events,
+				       proc->time_enabled, proc->time_running);
 
-	double cycles_idle_percent_core0;
+		/* only those of the process followed, there would be too many */
+		if (!FLAG_IS_SET(flags, FLAG_FOLLOW))
+			continue;
 
-	cycles_idle_percent_core0 = 100.0f * (double) st->total_idle_cycles_core0 / 
-		(double) samples;
+		for (size_t k = 0; k < proc->nr_ctx && shown + 1 < nr_rows; k++, shown++) {
+			const struct procs_ctx *c = &procs.ctxs[proc->first_ctx + k];
+			char label[PROCS_NAME_WIDTH + 1];
 
+			snprintf(label, sizeof(label), "  ctx %u", c->ctx);
+			gtop_display_procs_row(gtop, nr_counters, c->pid, label, 1,
+					       c->estimate, c->time_enabled,
+					       c->estimate_running);
+		}
+	}
 
-	fprintf(stdout, " IDLE0%28s %.2f%%\n", "", cycles_idle_percent_core0);
-	fprintf(stdout, " USAGE%28s %.2f%%\n", "", 100.0f - cycles_idle_percent_core0);
+	screen_printf(&screen, " %zu processes, %zu contexts, %d samples each\n",
+			procs.nr_procs, procs.nr_ctxs,
+			gtop->rotate.slot_samples);
+}
 
-	if (gtop_info.cores[0] > 1) {
-		double cycles_idle_percent_core1;
+/*
+ * display PART1 and PART2 in one go, each group with the percentage of the
+ * window it has been active. Values marked with '~' are estimates.
+ */
+static void
+gtop_display_interactive_mode_mux(const struct gtop *gtop)
+{
+	const char *group_names[] = {
+		[VIV_PROF_COUNTER_PART1] = "PART1",
+		[VIV_PROF_COUNTER_PART2] = "PART2",
+	};
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		const struct gtop_data *gtop_d = gtop->perf_data[i];
+
+		screen_printf(&screen, "%s%s: active ", underlined_color, group_names[i]);
+		screen_fixed2(&screen, fmt_hundredths(stats_mux_active(gtop_d->time_enabled,
+								     gtop_d->time_running)), 0);
+		screen_printf(&screen, "%% of window%s%s\n",
+				(gtop_d->time_running < gtop_d->time_enabled) ?
+				" (~ scaled estimates)" : "",
+				regular_color);
+
+		/* title, the two group headers and the last line */
+		gtop_display_interactive_mode_perf(gtop_d, (screen.rows - 4) / 2);
+	}
+}
+
+/*
+ * the counters of a group, PART1 and PART2 together if multiplexed
+ */
+static void
+gtop_display_interactive_mode_counters(const struct gtop *gtop,
+				       enum vivante_profiler_type_counter type)
+{
+	if (FLAG_IS_SET(flags, FLAG_ROTATE))
+		gtop_display_procs(gtop, type);
+	else if (FLAG_IS_SET(flags, FLAG_MULTIPLEX))
+		gtop_display_interactive_mode_mux(gtop);
+	else
+		gtop_display_interactive_mode_perf(gtop->perf_data[type], screen.rows - 2);
+}
+
+/*
+ * in hundredths of a percent
+ */
+static int64_t
+gtop_module_busy_percent(const struct vivante_gpu_state *st, size_t i)
+{
+	int64_t percent;
+
+	percent = fmt_percent_of(st->viv_idle_states[i], samples);
+
+	/* if it inverse subtract */
+	if (vivante_idle_module_names[i].inv)
+		percent = 10000 - percent;
+
+	return percent;
+}
+
+/*
+ * module name without the description, i.e. FE, DE, AXI_LP
+ */
+static void
+gtop_module_short_name(char *name, size_t len, size_t i)
+{
+	const char *full = vivante_idle_module_names[i].name;
+	size_t n = 0;
+
+	while (full[n] && full[n] != ' ' && n < len - 1) {
+		name[n] = full[n];
+		n++;
+	}
+	name[n] = '\0';
+}
+
+static void
+gtop_display_interactive_mode_occupancy(const struct vivante_gpu_state *st)
+{
+	bool graph = history.init && FLAG_IS_SET(flags, FLAG_HISTORY);
+	size_t i;
+
+	for (i = 0; i < NUM_VIV_IDLE_MODULES; i++) {
+		const char *name = vivante_idle_module_names[i].name;
+
+		screen_printf(&screen, " %s ", name);
+		screen_fixed2(&screen, gtop_module_busy_percent(st, i), graph ? 6 : 0);
+		screen_puts(&screen, "%");
+		if (graph)
+			gtop_display_history(&history.occupancy[i], strlen(name) + 9);
+		screen_puts(&screen, "\n");
+	}
+
+
+	int64_t cycles_idle_percent_core0;
 
-		cycles_idle_percent_core1 = 100.0f * (double) st->total_idle_cycles_core1 / 
-			(double) samples;
+	cycles_idle_percent_core0 = fmt_percent_of(st->total_idle_cycles_core0, samples);
 
-		fprintf(stdout, " IDLE1%28s %.2f%%\n", "", cycles_idle_percent_core1);
-		fprintf(stdout, " USAGE%28s %.2f%%\n", "", 100.0f - cycles_idle_percent_core1);
+
+	screen_printf(&screen, " IDLE0%28s ", "");
+	screen_fixed2(&screen, cycles_idle_percent_core0, graph ? 6 : 0);
+	screen_printf(&screen, "%%\n USAGE%28s ", "");
+	screen_fixed2(&screen, 10000 - cycles_idle_percent_core0, graph ? 6 : 0);
+	screen_puts(&screen, "%");
+	if (graph)
+		gtop_display_history(&history.usage[0], 42);
+	screen_puts(&screen, "\n");
+
+	if (gtop_info.cores[0] > 1) {
+		int64_t cycles_idle_percent_core1;
+
+		cycles_idle_percent_core1 = fmt_percent_of(st->total_idle_cycles_core1, samples);
+
+		screen_printf(&screen, " IDLE1%28s ", "");
+		screen_fixed2(&screen, cycles_idle_percent_core1, graph ? 6 : 0);
+		screen_printf(&screen, "%%\n USAGE%28s ", "");
+		screen_fixed2(&screen, 10000 - cycles_idle_percent_core1, graph ? 6 : 0);
+		screen_puts(&screen, "%");
+		if (graph)
+			gtop_display_history(&history.usage[1], 42);
+		screen_puts(&screen, "\n");
 	}
 }
 
@@ -439,50 +1022,69 @@ attach_gpu_state_to_dma_table(struct dma_table *table, struct vivante_gpu_state
 	}
 }
 
+/*
+ * a state per line, those which have never been seen are left out
+ */
 static void
-gtop_display_interactive_mode_dma(const struct vivante_gpu_state *st)
+gtop_display_dma_history(const struct dma_table *table, size_t first)
 {
-	size_t t = 0;
-	int i;
+	int shown = 0;
 
-	/* first display the commands */
-	struct dma_table *table = &dma_tables[t];
-	attach_gpu_state_to_dma_table(table, (struct vivante_gpu_state *) st);
+	for (int i = 0; i < table->data_size; i++) {
+		const struct history *h = &history.dma[first + i];
 
-	fprintf(stdout, "%s\n", table->title);
+		if (!h->peak)
+			continue;
 
-	for (i = 0; i < table->data_size; i++) {
-		double percent;
-		percent = 100.0f * ((double) table->data[i] / (double) samples);
-		fprintf(stdout, "%10.10s %.2f %%\n", table->data_names[i], percent);
+		screen_printf(&screen, "%10.10s ", table->data_names[i]);
+		screen_fixed2(&screen, fmt_percent_of(table->data[i], samples), 6);
+		screen_puts(&screen, " %");
+		gtop_display_history(h, 19);
+		screen_puts(&screen, "\n");
+		shown++;
 	}
 
-	fprintf(stdout, "\n");
+	if (!shown)
+		screen_printf(&screen, "%10s\n", "-");
+}
+
+static void
+gtop_display_interactive_mode_dma(const struct vivante_gpu_state *st)
+{
+	/* first history ring of the table */
+	size_t t, k = 0;
+	int i;
 
-	/* then all the other tables */
-	for (t = 1; t < NUM_DMA_TABLES; t++) {
+	for (t = 0; t < NUM_DMA_TABLES; t++) {
 
 		struct dma_table *table = &dma_tables[t];
+		struct layout_grid *grid = &layout.dma[t];
 		attach_gpu_state_to_dma_table(table, (struct vivante_gpu_state *) st);
 
-		fprintf(stdout, "%s\n", table->title);
+		if (t)
+			screen_printf(&screen, "\n");
+		screen_printf(&screen, "%s\n", table->title);
 
-		for (i = 0; i < table->data_size; i += 2) {
+		if (history.init && FLAG_IS_SET(flags, FLAG_HISTORY)) {
+			gtop_display_dma_history(table, k);
+			k += table->data_size;
+			continue;
+		}
 
-			int k = i + 1;
-			double percent;
+		/* the names are short enough, as many columns as fit */
+		layout_grid(grid, 0, screen.cols, table->data_size,
+			    DMA_STATE_WIDTH, 0, 0);
 
-			percent = 100.0f * ((double) table->data[i] / (double) samples);
-			fprintf(stdout, "%10.10s %.2f %% ", table->data_names[i], percent);
+		for (i = 0; i < table->data_size; i++) {
+			screen_printf(&screen, "%10.10s ", table->data_names[i]);
+			screen_fixed2(&screen, fmt_percent_of(table->data[i], samples), 6);
+			screen_puts(&screen, " % ");
 
-			if (k < table->data_size) {
-				double percent;
-				percent = 100.0f * ((double) table->data[k] / (double) samples);
-				fprintf(stdout, "%10.10s %.2f %% ", table->data_names[k], percent);
-			}
+			if ((i + 1) % grid->columns == 0 && i + 1 < table->data_size)
+				screen_printf(&screen, "\n");
 		}
 
-		fprintf(stdout, "\n");
+		screen_printf(&screen, "\n");
 	}
 }
 
@@ -528,55 +1130,55 @@ gtop_display_drv_info(struct perf_device *dev, struct gtop_hw_drv_info *ginfo, s
 	int core_id = 0;
 
 	/* print info about driver */
-	fprintf(stdout, "Galcore version:%d.%d.%d.%d, ",
+	screen_printf(&screen, "Galcore version:%d.%d.%d.%d, ",
 			gtop_info.drv_info.major, gtop_info.drv_info.minor,
 			gtop_info.drv_info.patch, gtop_info.drv_info.build);
-	fprintf(stdout, "gpuperfcnt:%s, %s\n",
+	screen_printf(&screen, "gpuperfcnt:%s, %s\n",
 			perf_version.git_version, perf_version.version);
 
 	if (governor.governor.governor)
-		fprintf(stdout, "Governor: %s\n", governor_names[governor.governor.governor - 1]);
+		screen_printf(&screen, "Governor: %s\n", governor_names[governor.governor.governor - 1]);
 
 	list_for_each(hw_info_iter, ginfo->hw_info.head) {
 		enum perf_core_type c_type = 
 			perf_get_core_type(hw_info_iter->id, dev);
 		switch (c_type) {
 		case PERF_CORE_3D:
-			fprintf(stdout, "3D:");
+			screen_printf(&screen, "3D:");
 			break;
 		case PERF_CORE_2D:
-			fprintf(stdout, "2D:");
+			screen_printf(&screen, "2D:");
 			break;
 		case PERF_CORE_VG:
-			fprintf(stdout, "VG:");
+			screen_printf(&screen, "VG:");
 			break;
 		default:
-			fprintf(stdout, "UNKNOWN:");
+			screen_printf(&screen, "UNKNOWN:");
 			break;
 		}
-		fprintf(stdout, "GC%x,Rev:%x ",
+		screen_printf(&screen, "GC%x,Rev:%x ",
 				hw_info_iter->model,
 				hw_info_iter->revision);
 
 		if (governor.clock.gpu_core_0 && core_id == 0)
-			fprintf(stdout, "Core: %u MHz, Shader: %u MHz ",
+			screen_printf(&screen, "Core: %u MHz, Shader: %u MHz ",
 					governor.clock.gpu_core_0 / (1000 * 1000),
 					governor.clock.shader_core_0 / (1000 * 1000));
 
 		if (governor.clock.gpu_core_0  && governor.clock.gpu_core_1 && core_id == 0)
-			fprintf(stdout, "\n");
+			screen_printf(&screen, "\n");
 
 
 		if (governor.clock.gpu_core_1 && core_id == 1)
-			fprintf(stdout, "Core: %u MHz, Shader: %u MHz ",
+			screen_printf(&screen, "Core: %u MHz, Shader: %u MHz ",
 					governor.clock.gpu_core_1 / (1000 * 1000),
 					governor.clock.shader_core_1 / (1000 * 1000));
 
 		core_id++;
 	}
 
-	fprintf(stdout, "\n");
-	fprintf(stdout, "3D Cores:%d,2D Cores:%d,VG Cores:%d\n",
+	screen_printf(&screen, "\n");
+	screen_printf(&screen, "3D Cores:%d,2D Cores:%d,VG Cores:%d\n",
 			ginfo->cores[0], ginfo->cores[1], ginfo->cores[2]);
 
 }
@@ -586,7 +1188,9 @@ gtop_display_vid_mem_usage(struct perf_device *dev, struct gtop_hw_drv_info *gin
 {
 	struct debugfs_client clients;
 	struct debugfs_client *curr_client;
-	struct debugfs_vid_mem_client vid_mem_client;
+	struct debugfs_vid_mem_client *vid_mem = NULL;
+	uint32_t *pids = NULL;
+	size_t nr_vid_mem = 0, first, p, i;
 	struct gtop_clocks_governor governor = {};
 	uint32_t scale_factor = 1024;
 
@@ -603,73 +1207,64 @@ gtop_display_vid_mem_usage(struct perf_device *dev, struct gtop_hw_drv_info *gin
 		return;
 	}
 
-	fprintf(stdout, "%s", underlined_color);
-	fprintf(stdout, "%6s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s", 
-			"PID", "IN", "VE", "TE", "RT", "DE",
-			"BM", "TS", "IM", "MA", "SC",
-			"HZ", "IC", "TD", "FE", "TFB");
-	fprintf(stdout, "\n");
+	vid_mem = calloc(nr_clients, sizeof(*vid_mem));
+	pids = calloc(nr_clients, sizeof(*pids));
+	if (!vid_mem || !pids)
+		goto out_exit;
 
-	fprintf(stdout, "%s", regular_color);
 	list_for_each(curr_client, clients.head) {
 		/* skip our program from attached programs */
 		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
 			continue;
 
-		int ret = debugfs_get_vid_mem(&vid_mem_client, curr_client->pid);
+		if (nr_vid_mem == (size_t) nr_clients)
+			break;
+
+		int ret = debugfs_get_vid_mem(&vid_mem[nr_vid_mem], curr_client->pid);
 		if (ret == -1)
 			goto out_exit;
 
-		/* scale them when their are too bigger */
-		if (vid_mem_client.index > scale_factor)
-			vid_mem_client.index /= scale_factor;
-		if (vid_mem_client.vertex > scale_factor)
-			vid_mem_client.vertex /= scale_factor;
-		if (vid_mem_client.texture > scale_factor)
-			vid_mem_client.texture /= scale_factor;
-		if (vid_mem_client.render_target > scale_factor)
-			vid_mem_client.render_target /= scale_factor;
-		if (vid_mem_client.depth > scale_factor)
-			vid_mem_client.depth /= scale_factor;
-		if (vid_mem_client.bitmap > scale_factor)
-			vid_mem_client.bitmap /= scale_factor;
-		if (vid_mem_client.tile_status > scale_factor)
-			vid_mem_client.tile_status /= scale_factor;
-		if (vid_mem_client.image > scale_factor)
-			vid_mem_client.image /= scale_factor;
-		if (vid_mem_client.mask > scale_factor)
-			vid_mem_client.mask /= scale_factor;
-		if (vid_mem_client.scissor > scale_factor)
-			vid_mem_client.scissor /= scale_factor;
-		if (vid_mem_client.hz > scale_factor)
-			vid_mem_client.hz /= scale_factor;
-		if (vid_mem_client.i_cache > scale_factor)
-			vid_mem_client.i_cache /= scale_factor;
-		if (vid_mem_client.tx_desc > scale_factor)
-			vid_mem_client.tx_desc /= scale_factor;
-		if (vid_mem_client.fence > scale_factor)
-			vid_mem_client.fence /= scale_factor;
-		if (vid_mem_client.tfbheader > scale_factor)
-			vid_mem_client.tfbheader /= scale_factor;
-
-		fprintf(stdout, "%6u ",
-				curr_client->pid);
-		/* display */
-		fprintf(stdout, "%5u %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u",
-				vid_mem_client.index, vid_mem_client.vertex,
-				vid_mem_client.texture, vid_mem_client.render_target,
-				vid_mem_client.depth, vid_mem_client.bitmap,
-				vid_mem_client.tile_status, vid_mem_client.image,
-				vid_mem_client.mask, vid_mem_client.scissor,
-				vid_mem_client.hz, vid_mem_client.i_cache,
-				vid_mem_client.tx_desc, vid_mem_client.fence,
-				vid_mem_client.tfbheader);
-		fprintf(stdout, "\n");
-	}
-
-	fprintf(stdout, "\nN: If value is bigger than %u, assume kBytes, otherwise Bytes\n", scale_factor);
+		pids[nr_vid_mem++] = curr_client->pid;
+	}
+
+	/* as many pools as fit side by side, the others in the tables below */
+	for (first = 0; first < NUM_VID_MEM_POOLS; first += layout.vid_mem_pools) {
+		size_t last = first + layout.vid_mem_pools;
+
+		if (last > NUM_VID_MEM_POOLS)
+			last = NUM_VID_MEM_POOLS;
+		if (first)
+			screen_printf(&screen, "\n");
+
+		screen_puts(&screen, underlined_color);
+		screen_printf(&screen, "%6s", "PID");
+		for (p = first; p < last; p++)
+			screen_printf(&screen, " %5s", vid_mem_pools[p].name);
+		screen_printf(&screen, "\n");
+		screen_puts(&screen, regular_color);
+
+		for (i = 0; i < nr_vid_mem; i++) {
+			screen_u64(&screen, pids[i], VID_MEM_PID_WIDTH, false);
+
+			for (p = first; p < last; p++) {
+				uint32_t value = *(const uint32_t *)
+					((const char *) &vid_mem[i] + vid_mem_pools[p].offset);
+
+				/* scale them when their are too bigger */
+				if (value > scale_factor)
+					value /= scale_factor;
+
+				screen_u64(&screen, value, VID_MEM_POOL_WIDTH, false);
+			}
+			screen_printf(&screen, "\n");
+		}
+	}
+
+	screen_printf(&screen, "\nN: If value is bigger than %u, assume kBytes, otherwise Bytes\n", scale_factor);
 out_exit:
 	/* free all resources */
+	free(vid_mem);
+	free(pids);
 	debugfs_free_clients(&clients);
 }
 
@@ -734,12 +1329,81 @@ gtop_enable_pmus(void)
 }
 
 static void
-gtop_disable_pmus(void)
+gtop_start_pmus(void)
 {
-	unsigned int i, j;
-
-	for_all_pmus(perf_pmu_ddrs, i, j) {
-		int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
+	if (!perf_ddr_enabled) {
+		gtop_configure_pmus();
+		gtop_enable_pmus();
+		perf_ddr_enabled = 1;
+	}
+}
+
+/*
+ * MB transferred, axid events count bytes, the others 16 byte bursts
+ */
+static double
+gtop_pmu_mbytes(const char *event_name, uint64_t counter_val)
+{
+	if (!strncmp(event_name, "axid", 4))
+		return counter_val / (1024.0 * 1024.0);
+
+	return counter_val * 16 / (1024.0 * 1024.0);
+}
+
+/*
+ * what the PMU counted since it was last read, kept in the history
+ */
+static uint64_t
+gtop_pmu_read(unsigned int i, unsigned int j)
+{
+	int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
+	uint64_t counter_val = perf_event_pmu_read(fd);
+
+	perf_event_pmu_reset(fd);
+
+	if (!paused)
+		history_push(&history.ddr[i][j],
+			     fmt_hundredths(gtop_pmu_mbytes(PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j),
+							    counter_val)));
+
+	return counter_val;
+}
+
+/*
+ * a PMU event per line, MB in the last window
+ */
+static void
+gtop_display_perf_pmus_history(void)
+{
+	unsigned int i, j;
+	char name[64];
+
+	screen_printf(&screen, "\n");
+
+	for_all_pmus(perf_pmu_ddrs, i, j) {
+		if (PMU_GET_FD(perf_pmu_ddrs, i, j) <= 0)
+			continue;
+
+		snprintf(name, sizeof(name), "%s/%s", PMU_GET_TYPE_NAME(perf_pmu_ddrs, i),
+			 PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j));
+		gtop_pmu_read(i, j);
+
+		screen_printf(&screen, "%-*.*s ", HISTORY_DESC_WIDTH, HISTORY_DESC_WIDTH, name);
+		screen_fixed2(&screen, history.ddr[i][j].values[(history.ddr[i][j].pushed - 1) %
+								HISTORY_LEN], 10);
+		screen_puts(&screen, " MB");
+		gtop_display_history(&history.ddr[i][j], HISTORY_DESC_WIDTH + 14);
+		screen_puts(&screen, "\n");
+	}
+}
+
+static void
+gtop_disable_pmus(void)
+{
+	unsigned int i, j;
+
+	for_all_pmus(perf_pmu_ddrs, i, j) {
+		int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
 		if (fd > 0)
 			perf_event_pmu_disable(fd);
 	}
@@ -749,21 +1413,22 @@ static inline void
 gtop_display_white_space(size_t amount)
 {
 	for (size_t i = 0; i < amount; i++)
-		fprintf(stdout, " ");
+		screen_printf(&screen, " ");
 }
 
 static void
 gtop_display_perf_pmus(void)
 {
 	unsigned int i, j;
-	if (!perf_ddr_enabled) {
-		gtop_configure_pmus();
-		gtop_enable_pmus();
-		perf_ddr_enabled = 1;
+	gtop_start_pmus();
+
+	if (history.init && FLAG_IS_SET(flags, FLAG_HISTORY)) {
+		gtop_display_perf_pmus_history();
+		return;
 	}
 
-	fprintf(stdout, "\n");
-	fprintf(stdout, "%s%5s", underlined_color, "");
+	screen_printf(&screen, "\n");
+	screen_printf(&screen, "%s%5s", underlined_color, "");
 
 	for_all_pmus(perf_pmu_ddrs, i, j) {
 		int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
@@ -771,14 +1436,14 @@ gtop_display_perf_pmus(void)
 			const char *type_name = PMU_GET_TYPE_NAME(perf_pmu_ddrs, i);
 			const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, j, j);
 
-			fprintf(stdout, "%s/%s%3s",
+			screen_printf(&screen, "%s/%s%3s",
 				type_name, event_name, "");
 
 		}
 	}
 
-	fprintf(stdout, "(MB)%s\n", regular_color);
-	fprintf(stdout, "%5s", "");
+	screen_printf(&screen, "(MB)%s\n", regular_color);
+	screen_printf(&screen, "%5s", "");
 	
 	char buf[PATH_MAX];
 	/* use a marker to known how much we need to shift on the right and
@@ -788,7 +1453,7 @@ gtop_display_perf_pmus(void)
 	for_all_pmus(perf_pmu_ddrs, i, j) {
 		int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
 		if (fd > 0) {
-			uint64_t counter_val = perf_event_pmu_read(fd);
+			uint64_t counter_val = gtop_pmu_read(i, j);
 			const char *type_name = PMU_GET_TYPE_NAME(perf_pmu_ddrs, i);
 			const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, j, j);
 
@@ -817,27 +1482,21 @@ gtop_display_perf_pmus(void)
 				gtop_display_white_space(buf_len - 4 + 3 - adjust_float);
 
 			/* 0.123 -> 4 chars */
-			fprintf(stdout, "%.2f", display_value);
-
-			perf_event_pmu_reset(fd);
+			screen_fixed2(&screen, fmt_hundredths(display_value), 0);
 
 			p++;
 		}
 	}
-	fprintf(stdout, "\n");
+	screen_printf(&screen, "\n");
 }
 
 static void
 gtop_display_perf_pmus_short(void)
 {
 	unsigned int i, j;
-	if (!perf_ddr_enabled) {
-		gtop_configure_pmus();
-		gtop_enable_pmus();
-		perf_ddr_enabled = 1;
-	}
+	gtop_start_pmus();
 
-	fprintf(stdout, "\n");
+	screen_printf(&screen, "\n");
 
 	for_each_pmu(perf_pmu_ddrs, i) {
 		char type_name_upper[1024];
@@ -856,34 +1515,140 @@ gtop_display_perf_pmus_short(void)
 		}
 		type_name_upper[index] = '\0';
 
-		fprintf(stdout, "%s", bold_color);
-		fprintf(stdout, "%s: ", type_name_upper);
-		fprintf(stdout, "%s", regular_color);
+		screen_puts(&screen, bold_color);
+		screen_printf(&screen, "%s: ", type_name_upper);
+		screen_puts(&screen, regular_color);
 
 		for_each_pmu(perf_pmu_ddrs[i].events, j) {
 			int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
 			if (fd > 0) {
 				const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j);
-				uint64_t counter_val = perf_event_pmu_read(fd);
-				double display_value;
-				if(!strncmp(event_name, "axid",4))
-						display_value = counter_val  / (1024.0*1024.0);
-				else
-						display_value = counter_val *16  / (1024.0*1024.0);
+				uint64_t counter_val = gtop_pmu_read(i, j);
+				double display_value = gtop_pmu_mbytes(event_name, counter_val);
 
-				fprintf(stdout, "%s:%.2f", event_name, display_value);
+				screen_printf(&screen, "%s:", event_name);
+				screen_fixed2(&screen, fmt_hundredths(display_value), 0);
 				if (j < (ARRAY_SIZE(perf_pmu_ddrs[i].events) - 1))
-						fprintf(stdout, ",");
-				perf_event_pmu_reset(fd);
+						screen_printf(&screen, ",");
 			}
 		}
-		fprintf(stdout, "\n");
+		screen_printf(&screen, "\n");
 	}
 
-	fprintf(stdout, "\n");
+	screen_printf(&screen, "\n");
 }
 #endif
 
+static bool
+gtop_client_before(const struct gtop_client_row *a, const struct gtop_client_row *b)
+{
+	int key = client_sort_keys[clients_table.sort].key;
+
+	if (key != CLIENT_SORT_PID && a->values[key] != b->values[key])
+		return a->values[key] > b->values[key];
+
+	return a->client->pid < b->client->pid;
+}
+
+static int
+gtop_client_cmp(const void *a, const void *b)
+{
+	if (gtop_client_before(a, b))
+		return -1;
+
+	return gtop_client_before(b, a);
+}
+
+static void
+gtop_client_swap(struct gtop_client_row *rows, size_t i, size_t j)
+{
+	struct gtop_client_row tmp = rows[i];
+
+	rows[i] = rows[j];
+	rows[j] = tmp;
+}
+
+/*
+ * only the first k rows end up sorted: a quickselect moves them in front,
+ * the rest is left as it is
+ */
+static void
+gtop_clients_select(struct gtop_client_row *rows, size_t nr, size_t k)
+{
+	size_t lo = 0, hi = nr;
+
+	if (k >= nr) {
+		qsort(rows, nr, sizeof(*rows), gtop_client_cmp);
+		return;
+	}
+
+	if (!k)
+		return;
+
+	/* row k - 1 is in [lo, hi), what is before lo goes first */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		size_t last = hi - 1;
+		size_t store = lo;
+
+		/* median of three as pivot, moved last */
+		if (gtop_client_before(&rows[mid], &rows[lo]))
+			gtop_client_swap(rows, mid, lo);
+		if (gtop_client_before(&rows[last], &rows[lo]))
+			gtop_client_swap(rows, last, lo);
+		if (gtop_client_before(&rows[last], &rows[mid]))
+			gtop_client_swap(rows, last, mid);
+		gtop_client_swap(rows, mid, last);
+
+		for (size_t i = lo; i < last; i++) {
+			if (gtop_client_before(&rows[i], &rows[last]))
+				gtop_client_swap(rows, i, store++);
+		}
+		gtop_client_swap(rows, store, last);
+
+		if (store == k - 1)
+			break;
+		if (store > k - 1)
+			hi = store;
+		else
+			lo = store + 1;
+	}
+
+	qsort(rows, k, sizeof(*rows), gtop_client_cmp);
+}
+
+static struct gtop_client_row *
+gtop_clients_add(struct debugfs_client *client)
+{
+	struct gtop_client_row *row;
+
+	if (clients_table.nr == clients_table.size) {
+		clients_table.size = clients_table.size ? clients_table.size * 2 : 64;
+		clients_table.rows = realloc(clients_table.rows,
+					     clients_table.size * sizeof(*row));
+		if (!clients_table.rows) {
+			dprintf("malloc?\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	row = &clients_table.rows[clients_table.nr++];
+	row->client = client;
+
+	return row;
+}
+
+static void
+gtop_clients_scroll(long pages)
+{
+	size_t by = clients_table.page ? clients_table.page : 1;
+
+	if (pages < 0 && clients_table.first < by * -pages)
+		clients_table.first = 0;
+	else
+		clients_table.first += by * pages;
+}
+
 static void
 gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 {
@@ -891,6 +1656,7 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 	struct debugfs_client *curr_client;
 	struct perf_client_memory client_total = {};
 	struct gtop_clocks_governor governor = {};
+	size_t col, first, nr_rows;
 
 	int nr_clients = 0;
 
@@ -915,23 +1681,24 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 #endif
 
 	/* draw with bold */
-	fprintf(stdout, "%s", underlined_color);
+	screen_puts(&screen, underlined_color);
 
-	if (FLAG_IS_SET(flags, FLAG_SHOW_CONTEXTS)) {
-		fprintf(stdout, " %7s %9s %10s %10s %12s %10s %16s %14s\n",
-				"PID", "RES(kB)", "CONT(kB)",
-				"VIRT(kB)", "Non-PGD(kB)", "Total(kB)",
-				"CMD", "CTX");
-	} else {
-		fprintf(stdout, " %7s %9s %10s %10s %12s %10s %16s\n",
-				"PID", "RES(kB)", "CONT(kB)",
-				"VIRT(kB)", "Non-PGD(kB)", "Total(kB)",
-				"CMD");
+	screen_printf(&screen, " %7s", "PID");
+	for (col = 0; col < NR_CLIENT_COLUMNS; col++) {
+		if (layout.clients_shown[col])
+			screen_printf(&screen, " %*s", client_columns_width[col] - 1,
+					client_columns_names[col]);
 	}
+	screen_printf(&screen, "  %-*s", layout.clients_cmd, "CMD");
+	if (FLAG_IS_SET(flags, FLAG_SHOW_CONTEXTS))
+		screen_printf(&screen, " %s", "CTX");
+	screen_printf(&screen, "\n");
 
 	/* reset drawing */
-	fprintf(stdout, "%s", regular_color);
+	screen_puts(&screen, regular_color);
 
+	/* all of them in an array, sorted by what is asked */
+	clients_table.nr = 0;
 	list_for_each(curr_client, clients.head) {
 
 		/* skip our program from attached programs */
@@ -939,8 +1706,7 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 			continue;
 
 		struct perf_client_memory cmem = {};
-
-		/* get contexts for this client */
+		struct gtop_client_row *row;
 
 		/* 
 		 * skip also programs that do not have CTXs.
@@ -953,15 +1719,12 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 
 		perf_get_client_memory(&cmem, curr_client->pid, dev);
 
-		fprintf(stdout, "%1s%7u%1s", "",
-				curr_client->pid, "");
-
-		fprintf(stdout, "%1s%8"PRIu64"%3s%8"PRIu64"%3s%8"PRIu64"%5s%8"PRIu64"%3s%8"PRIu64,
-				"", cmem.reserved / (1024), 
-				"", cmem.contigous / (1024), 
-				"", cmem._virtual / (1024), 
-				"", cmem.non_paged / (1024), 
-				"", cmem.total / (1024));
+		row = gtop_clients_add(curr_client);
+		row->values[CLIENT_RES] = cmem.reserved;
+		row->values[CLIENT_CONT] = cmem.contigous;
+		row->values[CLIENT_VIRT] = cmem._virtual;
+		row->values[CLIENT_NON_PGD] = cmem.non_paged;
+		row->values[CLIENT_TOTAL] = cmem.total;
 
 		/* compute total amount */
 		client_total.total += cmem.total;
@@ -969,31 +1732,77 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 		client_total.contigous += cmem.contigous;
 		client_total._virtual += cmem._virtual;
 		client_total.non_paged += cmem.non_paged;
+	}
 
-		fprintf(stdout, "   %14s", curr_client->name);
+	/*
+	 * what fits under the header, above the totals, or all of them when
+	 * it is not a terminal
+	 */
+	nr_rows = clients_table.nr;
+	if (screen.rows) {
+		int left = screen.rows - screen_lines(&screen) - CLIENT_FOOTER_LINES;
+
+		nr_rows = left > 1 ? (size_t) left : 1;
+		if (nr_rows > clients_table.nr)
+			nr_rows = clients_table.nr;
+		clients_table.page = nr_rows;
+	}
+	if (clients_table.first > clients_table.nr - nr_rows)
+		clients_table.first = clients_table.nr - nr_rows;
+
+	first = clients_table.first;
+	gtop_clients_select(clients_table.rows, clients_table.nr, first + nr_rows);
+
+	for (size_t r = first; r < first + nr_rows; r++) {
+		const struct gtop_client_row *row = &clients_table.rows[r];
+
+		curr_client = row->client;
+
+		screen_u64(&screen, curr_client->pid, 8, false);
+		for (col = 0; col < NR_CLIENT_COLUMNS; col++) {
+			if (layout.clients_shown[col])
+				screen_u64(&screen, row->values[col] / 1024,
+					   client_columns_width[col], false);
+		}
+
+		screen_printf(&screen, "  %-*.*s", layout.clients_cmd,
+				layout.clients_cmd, curr_client->name);
 
 		if (FLAG_IS_SET(flags, FLAG_SHOW_CONTEXTS)) {
 			for (size_t ctx = 0; ctx < curr_client->ctx_no; ctx++) {
 				if (ctx == (curr_client->ctx_no - 1))
-					fprintf(stdout, " %2d", curr_client->ctx[ctx]);
+					screen_printf(&screen, " %2d", curr_client->ctx[ctx]);
 				else
-					fprintf(stdout, " %2d,", curr_client->ctx[ctx]);
+					screen_printf(&screen, " %2d,", curr_client->ctx[ctx]);
 			}
 		}
 		
-		fprintf(stdout, "\n");
+		screen_printf(&screen, "\n");
 	}
 
-
-	fprintf(stdout, "\n%s", bold_color);
-	fprintf(stdout, "TOT: ");
-	fprintf(stdout, "%s", regular_color);
-	fprintf(stdout, "%13"PRIu64" %10"PRIu64" %10"PRIu64" %12"PRIu64" %10"PRIu64, 
-			client_total.reserved / (1024) ,
-			client_total.contigous / (1024),
-			client_total._virtual / (1024),
-			client_total.non_paged / (1024),
-			client_total.total / (1024));
+	/* where we are in the list */
+	if (screen.rows && nr_rows < clients_table.nr)
+		screen_printf(&screen, " %zu-%zu of %zu, sorted by %s",
+				first + 1, first + nr_rows, clients_table.nr,
+				client_sort_keys[clients_table.sort].name);
+
+	screen_printf(&screen, "\n%s", bold_color);
+	screen_printf(&screen, "%-*s", CLIENT_PID_WIDTH, "TOT:");
+	screen_puts(&screen, regular_color);
+
+	uint64_t totals[NR_CLIENT_COLUMNS] = {
+		[CLIENT_RES]		= client_total.reserved,
+		[CLIENT_CONT]		= client_total.contigous,
+		[CLIENT_VIRT]		= client_total._virtual,
+		[CLIENT_NON_PGD]	= client_total.non_paged,
+		[CLIENT_TOTAL]		= client_total.total,
+	};
+
+	for (col = 0; col < NR_CLIENT_COLUMNS; col++) {
+		if (layout.clients_shown[col])
+			screen_u64(&screen, totals[col] / 1024,
+				   client_columns_width[col], false);
+	}
 
 #if !defined __QNXNTO__ && !defined __QNX__
 	char cmdline[512];
@@ -1012,12 +1821,19 @@ gtop_display_clients(struct perf_device *dev, struct gtop_hw_drv_info *ginfo)
 	sscanf(cmdline, "%"PRIu32, &contigousSize);
 
 
-	fprintf(stdout, "\n");
-	fprintf(stdout, "%s", bold_color);
-	fprintf(stdout, "TOT_CON:");
-	fprintf(stdout, "%s", regular_color);
-	fprintf(stdout, "%9s- %9s- %9s- %11s-%11" PRIu64 " ", 
-			"", "", "", "", (contigousSize - client_total.reserved) / (1024));
+	screen_printf(&screen, "\n");
+	screen_puts(&screen, bold_color);
+	screen_printf(&screen, "%-*s", CLIENT_PID_WIDTH, "TOT_CON:");
+	screen_puts(&screen, regular_color);
+
+	/* what is left of the contiguous memory goes under the total */
+	for (col = 0; col < CLIENT_TOTAL; col++) {
+		if (layout.clients_shown[col])
+			screen_printf(&screen, " %*s", client_columns_width[col] - 1, "-");
+	}
+	screen_u64(&screen, (contigousSize - client_total.reserved) / (1024),
+		   client_columns_width[CLIENT_TOTAL], false);
+	screen_putc(&screen, ' ');
 skip:
 #endif
 	/* free all resources */
@@ -1031,10 +1847,10 @@ gtop_check_profiler_state(void)
 	if (!profiler_state.enabled) {
 		switch (profiler_state.state) {
 		case -1:
-			fprintf(stdout, "Err: gpuProfiler not enabled in kernel!...\n");
+			screen_printf(&screen, "Err: gpuProfiler not enabled in kernel!...\n");
 			break;
 		case -2:
-			fprintf(stdout, "Err: powerManagement not disabled in kernel!...\n");
+			screen_printf(&screen, "Err: powerManagement not disabled in kernel!...\n");
 			break;
 		case 0:
 		default:
@@ -1044,35 +1860,114 @@ gtop_check_profiler_state(void)
 }
 
 static void
-gtop_display_interactive(struct perf_device *dev, const struct gtop gtop)
+gtop_display_picker(void)
 {
+	size_t nr_rows = picker.nr_entries;
+
+	if (picker.type == PICKER_SAMPLES) {
+		screen_printf(&screen, "\n Samples per window: %s%s_%s (now %d)\n",
+				bold_color, picker.input, regular_color, samples);
+		screen_puts(&screen, "\n Type the number, Enter to change it, ESC to cancel\n");
+		return;
+	}
+
+	if (picker.message) {
+		screen_printf(&screen, "\n %s\n\n Type any key to resume...\n",
+				picker.message);
+		return;
+	}
+
+	screen_puts(&screen, "\n Context to read counters for, Enter to pick it, ESC to cancel\n");
+	screen_printf(&screen, "%s   %*s  %-*s %8s%s\n", underlined_color,
+			CLIENT_PID_WIDTH, "PID", CLIENT_CMD_MAX, "CMD", "CTX",
+			regular_color);
+
+	/* keep the cursor in what fits */
+	if (screen.rows) {
+		int left = screen.rows - screen_lines(&screen) - 1;
+
+		nr_rows = left > 1 ? (size_t) left : 1;
+		if (nr_rows > picker.nr_entries)
+			nr_rows = picker.nr_entries;
+	}
+	if (picker.cursor < picker.first)
+		picker.first = picker.cursor;
+	else if (picker.cursor >= picker.first + nr_rows)
+		picker.first = picker.cursor - nr_rows + 1;
+
+	for (size_t i = picker.first; i < picker.first + nr_rows; i++) {
+		const struct gtop_picker_entry *e = &picker.entries[i];
+		bool cursor = i == picker.cursor;
+
+		if (cursor)
+			screen_puts(&screen, bold_color);
+		screen_puts(&screen, cursor ? " > " : "   ");
+		if (e->pid)
+			screen_u64(&screen, e->pid, CLIENT_PID_WIDTH, false);
+		else
+			screen_printf(&screen, "%*s", CLIENT_PID_WIDTH, "-");
+		screen_printf(&screen, "  %-*.*s ", CLIENT_CMD_MAX, CLIENT_CMD_MAX, e->name);
+		screen_u64(&screen, e->ctx, 8, false);
+		if (cursor)
+			screen_puts(&screen, regular_color);
+		screen_putc(&screen, '\n');
+	}
+}
 
+static void
+gtop_display_interactive(struct perf_device *dev, const struct gtop gtop)
+{
+	/* what has been printed so far goes before the frame */
 	fflush(stdout);
-	fprintf(stdout, "%s", clear_screen);
+
+	if (resized != screen_resized) {
+		int rows, cols;
+
+		screen_resized = resized;
+		gtop_screen_size(&rows, &cols);
+		screen_resize(&screen, rows, cols);
+	}
+	gtop_layout();
+
+	screen_begin(&screen);
+	screen_puts(&screen, clear_screen);
 
 	/* check any errors related to module *not* being properly loaded */
 	gtop_check_profiler_state();
 
 	if (FLAG_IS_SET(flags, FLAG_MODE))
-		fprintf(stdout, "%s | %u / %u ", program_pages[mode].page_desc, mode, (MODE_PERF_NO - 1));
+		screen_printf(&screen, "%s | %u / %u ", program_pages[mode].page_desc, mode, (MODE_PERF_NO - 1));
 	else
-		fprintf(stdout, "%s | %u / %u ", program_pages[curr_page].page_desc, curr_page, (PAGE_NO - 1));
+		screen_printf(&screen, "%s | %u / %u ", program_pages[curr_page].page_desc, curr_page, (PAGE_NO - 1));
 
-	fprintf(stdout, " (sample_mode: %s", display_samples_names[samples_mode]);
+	if (FLAG_IS_SET(flags, FLAG_MULTIPLEX) && gtop_is_counter_page())
+		screen_printf(&screen, "[PART1+PART2 multiplexed] ");
+
+	screen_printf(&screen, " (sample_mode: %s", display_samples_names[samples_mode]);
 	if (samples_mode == SAMPLES_TIME) {
-		fprintf(stdout, " - %d.%d secs)", DELAY_SECS, DELAY_NSECS);
+		screen_puts(&screen, " - ");
+		/* in hundredths of a second */
+		screen_fixed2(&screen, (refresh.tv_sec * NSEC_PER_SEC + refresh.tv_nsec +
+					NSEC_PER_SEC / 200) / (NSEC_PER_SEC / 100), 0);
+		screen_printf(&screen, " secs, %s)", rate_names[rate.rate]);
 	} else {
-		fprintf(stdout, ")");
+		screen_printf(&screen, ", per sample)");
 	}
 
 	if (selected_client && selected_client->name) {
-		fprintf(stdout, "(PID: %u, Program: %s, CTX = %u)\n",
+		screen_printf(&screen, "(PID: %u, Program: %s, CTX = %u)\n",
 				selected_client->pid, selected_client->name, selected_ctx);
+	} else if (FLAG_IS_SET(flags, FLAG_FOLLOW) && follow.name) {
+		screen_printf(&screen, "(waiting for %s)\n", follow.name);
+	} else if (FLAG_IS_SET(flags, FLAG_FOLLOW)) {
+		screen_printf(&screen, "(waiting for PID %u)\n", follow.pid);
 	} else {
-		fprintf(stdout, "\n");
+		screen_printf(&screen, "\n");
 	}
 
-	if (FLAG_IS_SET(flags, FLAG_MODE)) {
+	if (picker.type != PICKER_NONE) {
+		gtop_display_picker();
+	} else if (FLAG_IS_SET(flags, FLAG_MODE)) {
 		switch (mode) {
 		case MODE_PERF_SHOW_CLIENTS:
 			gtop_display_clients(dev, &gtop_info);
@@ -1081,10 +1976,10 @@ gtop_display_interactive(struct perf_device *dev, const struct gtop gtop)
 			gtop_display_vid_mem_usage(dev, &gtop_info);
 			break;
 		case MODE_PERF_COUNTER_PART1:
-			gtop_display_interactive_mode_perf(gtop.perf_data[VIV_PROF_COUNTER_PART1], dev);
+			gtop_display_interactive_mode_counters(&gtop, VIV_PROF_COUNTER_PART1);
 			break;
 		case MODE_PERF_COUNTER_PART2:
-			gtop_display_interactive_mode_perf(gtop.perf_data[VIV_PROF_COUNTER_PART2], dev);
+			gtop_display_interactive_mode_counters(&gtop, VIV_PROF_COUNTER_PART2);
 			break;
 		case MODE_PERF_DMA:
 			gtop_display_interactive_mode_dma(&gtop.st);
@@ -1111,10 +2006,10 @@ gtop_display_interactive(struct perf_device *dev, const struct gtop gtop)
 			gtop_display_vid_mem_usage(dev, &gtop_info);
 			break;
 		case PAGE_COUNTER_PART1:
-			gtop_display_interactive_mode_perf(gtop.perf_data[VIV_PROF_COUNTER_PART1], dev);
+			gtop_display_interactive_mode_counters(&gtop, VIV_PROF_COUNTER_PART1);
 			break;
 		case PAGE_COUNTER_PART2:
-			gtop_display_interactive_mode_perf(gtop.perf_data[VIV_PROF_COUNTER_PART2], dev);
+			gtop_display_interactive_mode_counters(&gtop, VIV_PROF_COUNTER_PART2);
 			break;
 		case PAGE_DMA:
 			gtop_display_interactive_mode_dma(&gtop.st);
@@ -1134,14 +2029,83 @@ gtop_display_interactive(struct perf_device *dev, const struct gtop gtop)
 		}
 	}
 
-	fprintf(stdout, "\n");
+	screen_puts(&screen, "\n");
+	screen_flush(&screen, STDOUT_FILENO);
+}
+
+/*
+ * Guess what the counter counts out of its description, the library doesn't
+ * provide this information.
+ */
+static const char *
+gtop_counter_unit(const char *desc)
+{
+	char lower[COUNTER_DESC_LEN];
+	size_t i;
+
+	for (i = 0; i < sizeof(lower) - 1 && desc[i]; i++)
+		lower[i] = tolower((unsigned char) desc[i]);
+	lower[i] = '\0';
+
+	if (strstr(lower, "cycle"))
+		return "cycles";
+	if (strstr(lower, "byte"))
+		return "bytes";
+
+	return "events";
+}
+
+static void
+gtop_counter_desc_set(struct gtop_counter_desc *desc, const char *str)
+{
+	size_t i, len = 0;
+
+	snprintf(desc->desc, sizeof(desc->desc), "%s", str);
+
+	/* name: lower-case alpha-numeric, everything else collapsed to '_' */
+	for (i = 0; desc->desc[i] && len < sizeof(desc->name) - 1; i++) {
+		unsigned char ch = desc->desc[i];
+
+		if (isalnum(ch))
+			desc->name[len++] = tolower(ch);
+		else if (len && desc->name[len - 1] != '_')
+			desc->name[len++] = '_';
+	}
+	while (len && desc->name[len - 1] == '_')
+		len--;
+	desc->name[len] = '\0';
+
+	desc->unit = gtop_counter_unit(desc->desc);
+
+	snprintf(desc->display, sizeof(desc->display), "%-*.*s",
+		 COUNTER_DESC_WIDTH, COUNTER_DESC_WIDTH, desc->desc);
+
+	len = strlen(desc->desc);
+	desc->width = len > COUNTER_DESC_WIDTH ? COUNTER_DESC_WIDTH : len;
+}
+
+static void
+gtop_counter_desc_init(struct gtop_counter_desc *desc,
+		       enum vivante_profiler_type_counter type, uint32_t id,
+		       struct perf_device *dev)
+{
+	struct perf_counter_info *info;
+	char str[COUNTER_DESC_LEN];
+
+	info = perf_get_counter_info(type, id, dev);
+	if (info && info->desc)
+		snprintf(str, sizeof(str), "%s", info->desc);
+	else
+		snprintf(str, sizeof(str), "PART%d counter %u", type, id);
 
+	gtop_counter_desc_set(desc, str);
 }
 
 static struct gtop_data *
 gtop_data_create(enum vivante_profiler_type_counter type,
 		 uint32_t num_perf_counters,
-		 uint32_t num_perf_derived_counters)
+		 uint32_t num_perf_derived_counters,
+		 struct perf_device *dev)
 {
 	uint64_t total_num_perf_counters =
 		num_perf_counters + num_perf_derived_counters;
@@ -1199,6 +2163,18 @@ gtop_data_create(enum vivante_profiler_type_counter type,
 		exit(EXIT_FAILURE);
 	}
 
+	gtop->desc = calloc(total_num_perf_counters, sizeof(struct gtop_counter_desc));
+	if (!gtop->desc) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* when replaying descriptors come from the trace */
+	if (dev) {
+		for (uint32_t c = 0; c < num_perf_counters; c++)
+			gtop_counter_desc_init(&gtop->desc[c], type, c, dev);
+	}
+
 	return gtop;
 }
 
@@ -1228,6 +2204,9 @@ gtop_data_destroy(struct gtop_data *gtop)
 		if (gtop->reset_after_read)
 			free(gtop->reset_after_read);
 
+		if (gtop->desc)
+			free(gtop->desc);
+
 		free(gtop);
 		gtop = NULL;
 	}
@@ -1240,30 +2219,41 @@ gtop_data_clear_samples(struct gtop_data *gtop)
 		if (gtop->events_per_sample)
 			memset(gtop->events_per_sample, 0, sizeof(uint64_t) *
 					gtop->total_num_perf_counters);
+
+		gtop->nr_samples = 0;
+		gtop->time_enabled = 0;
+		gtop->time_running = 0;
 	}
 }
 
+/*
+ * enable and start the profiler, if not already running
+ */
 static int
-gtop_compute_mode_dma(struct perf_device *dev, struct vivante_gpu_state *st)
+gtop_start_profiling(struct perf_device *dev)
 {
-	uint32_t data = 0;
-	uint32_t cmd_state_idx;
-	int err;
-
-	if (!profiler_state.enabled) {
+	if (profiler_state.enabled)
+		return 0;
 
-		if (perf_check_profiler(&profiler_state.state, dev) < 0)
-			return -1;
+	if (perf_check_profiler(&profiler_state.state, dev) < 0)
+		return -1;
 
-		if (gtop_enable_profiling(dev) < 0)
-			return -1;
+	if (gtop_enable_profiling(dev) < 0)
+		return -1;
 
-		if (perf_profiler_start(dev) < 0)
-			return -1;
+	if (perf_profiler_start(dev) < 0)
+		return -1;
 
-		profiler_state.enabled = true;
+	profiler_state.enabled = true;
+	return 0;
+}
 
-	}
+static int
+gtop_compute_mode_dma(struct perf_device *dev, struct vivante_gpu_state *st)
+{
+	uint32_t data = 0;
+	uint32_t cmd_state_idx;
+	int err;
 
 	err = perf_read_register(PERF_MGPU_3D_CORE_0, VIVS_FE_DMA_DEBUG_STATE, &data, dev);
 	if (err < 0) {
@@ -1289,47 +2279,86 @@ gtop_compute_mode_dma(struct perf_device *dev, struct vivante_gpu_state *st)
 	return 0;
 }
 
+static uint32_t
+gtop_get_idle_reg_addr(struct perf_device *dev)
+{
+	if (gtop_is_chip_model(0x880, dev))
+		return GC_TOTAL_CYCLES;
+	else if (gtop_is_chip_model(0x2000, dev))
+		return GC_2000_TOTAL_IDLE_CYCLES;
+
+	return GC_TOTAL_IDLE_CYCLES;
+}
+
+/*
+ * just store the raw idle state, see gtop_compute_idle_states()
+ */
 static int
-gtop_compute_mode_occupancy(struct perf_device *dev, struct vivante_gpu_state *st)
+gtop_compute_mode_idle_state(struct perf_device *dev, struct gtop *gtop)
 {
 	uint32_t data = 0;
-	uint32_t mid;
 	int err;
-	uint32_t idle_reg_addr = GC_TOTAL_IDLE_CYCLES;
 
-	if (gtop_is_chip_model(0x880, dev)) {
-		idle_reg_addr = GC_TOTAL_CYCLES;
-	} else if (gtop_is_chip_model(0x2000, dev)) {
-		idle_reg_addr = GC_2000_TOTAL_IDLE_CYCLES;
+	err = perf_read_register(PERF_MGPU_3D_CORE_0, VIVS_HI_IDLE_STATE, &data, dev);
+	if (err < 0) {
+		dprintf("Failed to read 0x%x\n", VIVS_HI_IDLE_STATE);
+		return err;
 	}
 
+	if (gtop->nr_idle_words < gtop->idle_words_size)
+		gtop->idle_words[gtop->nr_idle_words++] = data;
 
-	if (!profiler_state.enabled) {
-
-		if (perf_check_profiler(&profiler_state.state, dev) < 0)
-			return -1;
-
-		if (gtop_enable_profiling(dev) < 0)
-			return -1;
+	return 0;
+}
 
-		if (perf_profiler_start(dev) < 0)
-			return -1;
+/*
+ * make room for a window worth of idle states
+ */
+static void
+gtop_idle_words_reserve(struct gtop *gtop, uint32_t nr)
+{
+	gtop->nr_idle_words = 0;
 
-		profiler_state.enabled = true;
+	if (gtop->idle_words_size >= nr)
+		return;
 
+	gtop->idle_words = realloc(gtop->idle_words, nr * sizeof(uint32_t));
+	if (!gtop->idle_words) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
 	}
+	gtop->idle_words_size = nr;
+}
 
-	err = perf_read_register(PERF_MGPU_3D_CORE_0, VIVS_HI_IDLE_STATE, &data, dev);
-	if (err < 0) {
-		dprintf("Failed to read 0x%x\n", VIVS_HI_IDLE_STATE);
-		return err;
-	}
+/*
+ * busy count of each module over the whole window, out of the raw idle states
+ */
+static void
+gtop_compute_idle_states(struct gtop *gtop)
+{
+	uint32_t counts[32] = {};
+	uint32_t mid;
+
+	stats_bit_histogram(gtop->idle_words, gtop->nr_idle_words, counts);
 
 	for (mid = 0; mid < NUM_VIV_IDLE_MODULES; mid++) {
-		if (data & vivante_idle_module_names[mid].bit) {
-			st->viv_idle_states[mid]++;
+		uint32_t bit = vivante_idle_module_names[mid].bit;
+		unsigned int b = 0;
+
+		while (!(bit & 1)) {
+			bit >>= 1;
+			b++;
 		}
+
+		gtop->st.viv_idle_states[mid] = counts[b];
 	}
+}
+
+static int
+gtop_compute_mode_occupancy(struct perf_device *dev, struct vivante_gpu_state *st,
+			    uint32_t idle_reg_addr)
+{
+	int err;
 
 	/*
 	 * used to be read then reset, turns out reset then read works better.
@@ -1369,24 +2398,8 @@ gtop_compute_mode_occupancy(struct perf_device *dev, struct vivante_gpu_state *s
 	return 0;
 }
 
-static void
-gtop_scale_counters_by(struct gtop_data *gtop, uint64_t diff)
-{
-	uint32_t c;
-
-	/* scale counters by elapsed time */
-	for (c = 0; c < gtop->num_perf_counters; c++) {
-
-		gtop->events_per_sample[c] =
-			(gtop->events_per_sample[c] * USEC_PER_SEC * 10) / diff;
-
-		gtop->events_per_sample_average[c] /= samples;
-
-	}
-}
-
-static int
-gtop_enable_profiling(struct perf_device *dev)
+static int
+gtop_enable_profiling(struct perf_device *dev)
 {
 	int err = 0;
 
@@ -1413,30 +2426,22 @@ gtop_disable_profiling(struct perf_device *dev)
 static int
 gtop_compute_perf(struct perf_device *dev, struct gtop_data *gtop_d)
 {
+	uint64_t now;
 	uint32_t c;
 	int err;
 
-	if (!profiler_state.enabled) {
-
-		if (perf_check_profiler(&profiler_state.state, dev) < 0)
-			return -1;
-
-		if (gtop_enable_profiling(dev) < 0)
-			return -1;
-
-		if (perf_profiler_start(dev) < 0)
-			return -1;
-
-		profiler_state.enabled = true;
-
-	}
-
 	err = perf_read_counters_3d(gtop_d->type, gtop_d->counter_data, dev);
 	if (err < 0) {
 		dprintf("reading counters failed!\n");
 		exit(EXIT_FAILURE);
 	}
 
+	/* the deltas cover the time since the previous read */
+	now = get_ns_time();
+	if (gtop_d->last_read_ns)
+		gtop_d->time_running += now - gtop_d->last_read_ns;
+	gtop_d->last_read_ns = now;
+
 	for (c = 0; c < gtop_d->num_perf_counters; c++) {
 		if (!gtop_d->reset_after_read[c]) {
 			if (gtop_d->counter_data_last[c] > gtop_d->counter_data[c]) {
@@ -1465,311 +2470,2421 @@ gtop_compute_perf(struct perf_device *dev, struct gtop_data *gtop_d)
 	memcpy(gtop_d->counter_data_last, gtop_d->counter_data,
 			gtop_d->num_perf_counters * sizeof(uint32_t));
 
+	gtop_d->nr_samples++;
+	gtop_d->nr_average_samples++;
+
+	return 0;
+}
+
+/*
+ * read the counters of the group without accounting them, used at the start of
+ * a multiplexing slot so that only events while the group is active get counted
+ */
+static int
+gtop_prime_perf(struct perf_device *dev, struct gtop_data *gtop_d)
+{
+	int err;
+
+	err = perf_read_counters_3d(gtop_d->type, gtop_d->counter_data_last, dev);
+	if (err < 0) {
+		dprintf("reading counters failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	gtop_d->last_read_ns = get_ns_time();
+
 	return 0;
 }
 
+/*
+ * Alternate between PART1 and PART2 every (samples / MUX_SLOTS) samples. Each
+ * slot begins by priming the group, then the following samples accumulate
+ * deltas and the time since priming in time_running, so we know how long each
+ * group was active and can extrapolate to the whole window.
+ */
+static int
+gtop_compute_perf_mux(struct perf_device *dev, struct gtop *gtop, int s)
+{
+	int slot_samples = samples / MUX_SLOTS;
+
+	/* we need at least one sample after priming */
+	if (slot_samples < 2)
+		slot_samples = 2;
+
+	if (s % slot_samples == 0) {
+		if (gtop->mux.active == VIV_PROF_COUNTER_PART1)
+			gtop->mux.active = VIV_PROF_COUNTER_PART2;
+		else
+			gtop->mux.active = VIV_PROF_COUNTER_PART1;
+
+		return gtop_prime_perf(dev, gtop->perf_data[gtop->mux.active]);
+	}
+
+	return gtop_compute_perf(dev, gtop->perf_data[gtop->mux.active]);
+}
+
+/*
+ * the group being rotated now holds what it gets for the contexts of this
+ * rotation, whose estimates are kept from one plan to the next
+ */
 static void
-gtop_wait_for_keyboard(const char *str, bool clean_screen)
+gtop_rotate_init(struct gtop *gtop, enum vivante_profiler_type_counter type)
 {
-	int dummy;
+	struct gtop_rotate *r = &gtop->rotate;
+	const struct gtop_data *gtop_d = gtop->perf_data[type];
 
-	if (clean_screen)
-		fprintf(stdout, "%s\n", clear_screen);
-	if (str)
-		fprintf(stdout, "%s", str);
+	if (r->slot_events && r->type == type)
+		return;
 
-	fprintf(stdout, "\n Type any key to resume...\n");
+	/* estimates of the other group mean nothing for this one */
+	procs_free(&procs);
+	procs_init(&procs, gtop_d->num_perf_counters, prg_name);
 
-	fflush(NULL);
-	ssize_t nr = read(STDIN_FILENO, &dummy, sizeof(int));
-	(void) nr;
+	free(r->slot_events);
+	r->slot_events = calloc(gtop_d->num_perf_counters, sizeof(uint64_t));
+	if (!r->slot_events) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+
+	r->type = type;
+	r->curr = NULL;
 }
 
-static bool
-gtop_check_ctx_is_valid(uint32_t c)
+/*
+ * contexts as they are now, and how many samples each of them gets
+ */
+static void
+gtop_rotate_begin(struct gtop *gtop)
 {
-	struct debugfs_client clients;
-	struct debugfs_client *curr_client;
-	int nr_clients = 0;
-	bool ctx_found = false;
+	struct gtop_rotate *r = &gtop->rotate;
+	bool following = FLAG_IS_SET(flags, FLAG_FOLLOW);
+	size_t nr;
+
+	/* parsed again only if the database changed */
+	if (debugfs_ctx_index_update(&ctx_index, NULL) >= 0 &&
+	    procs_sync(&procs, &ctx_index, following ? follow.pid : 0,
+		       following ? follow.name : NULL) < 0) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
 
-	nr_clients = debugfs_get_current_clients(&clients, NULL);
+	/* those not fitting in this window go first in the next one */
+	nr = procs.nr_ctxs ? procs.nr_ctxs : 1;
+	r->slot_samples = samples / nr;
+	if (r->slot_samples < PROCS_SLOT_MIN_SAMPLES)
+		r->slot_samples = PROCS_SLOT_MIN_SAMPLES;
 
-	/* if no clients are attached bail out */
-	if (!nr_clients)
-		return ctx_found;
+	r->curr = NULL;
+}
 
+/*
+ * the context of the slot gets what the group gathered since it started
+ */
+static void
+gtop_rotate_slot_end(struct gtop *gtop)
+{
+	struct gtop_rotate *r = &gtop->rotate;
+	const struct gtop_data *gtop_d = gtop->perf_data[r->type];
 
-	list_for_each(curr_client, clients.head) {
+	if (!r->curr)
+		return;
 
-		/* skip our program from attached programs */
-		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
-			continue;
+	for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++)
+		r->slot_events[c] = gtop_d->events_per_sample[c] - r->slot_events[c];
+
+	procs_account(&procs, r->curr, r->slot_events,
+		      gtop_d->time_running - r->slot_running);
+	r->curr = NULL;
+}
+
+/*
+ * Each slot binds the counters to the next context and primes the group, the
+ * samples after it accumulate like for a single context. A slot starts only
+ * if it gets a read after priming.
+ */
+static int
+gtop_compute_perf_rotate(struct perf_device *dev, struct gtop *gtop, int s)
+{
+	struct gtop_rotate *r = &gtop->rotate;
+	struct gtop_data *gtop_d = gtop->perf_data[r->type];
 
-		/* get contexts for this client */
-		debugfs_get_current_ctx(curr_client, NULL);
+	if (s % r->slot_samples == 0 && samples - s >= PROCS_SLOT_MIN_SAMPLES) {
+		gtop_rotate_slot_end(gtop);
 
-		for (size_t ctx = 0; ctx < curr_client->ctx_no; ctx++) {
+		r->curr = procs_next(&procs);
+		if (!r->curr)
+			return 0;
 
-			if (curr_client->ctx[ctx] == c) {
-				size_t name_len;
+		perf_context_set(r->curr->ctx, dev);
 
-				ctx_found = true;
+		memcpy(r->slot_events, gtop_d->events_per_sample,
+		       gtop_d->num_perf_counters * sizeof(uint64_t));
+		r->slot_running = gtop_d->time_running;
 
-				name_len = strlen(curr_client->name);
+		return gtop_prime_perf(dev, gtop_d);
+	}
 
-try_again:
-				/*
-				 * if this is the first time, or we're modifying it
-				 * allocate some space for it
-				 */
-				if (selected_client == NULL) {
+	if (!r->curr)
+		return 0;
 
-					selected_client = malloc(sizeof(*selected_client));
-					memset(selected_client, 0, sizeof(*selected_client));
+	return gtop_compute_perf(dev, gtop_d);
+}
 
-					selected_client->name = malloc(name_len + 1);
-					memset(selected_client->name, 0, name_len + 1);
+/*
+ * Scale the contexts sampled to the window and sum them per process. The group
+ * is left with the total of all of them, already scaled, which is what gets
+ * displayed elsewhere and recorded.
+ */
+static void
+gtop_rotate_end(struct perf_device *dev, struct gtop *gtop)
+{
+	struct gtop_rotate *r = &gtop->rotate;
+	struct gtop_data *gtop_d = gtop->perf_data[r->type];
 
-				} else {
+	gtop_rotate_slot_end(gtop);
 
-					/* if it is not NULL, free it first and try again */
-					if (selected_client->name)
-						free(selected_client->name);
+	if (procs_window(&procs, gtop->window_ns) < 0) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
 
-					memset(selected_client, 0, sizeof(*selected_client));
-					free(selected_client);
-					selected_client = NULL;
-					goto try_again;
-				}
+	memset(gtop_d->events_per_sample, 0,
+	       gtop_d->num_perf_counters * sizeof(uint64_t));
+	for (size_t i = 0; i < procs.nr_procs; i++) {
+		for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++)
+			gtop_d->events_per_sample[c] += procs.procs[i].events[c];
+	}
+	gtop_d->time_enabled = gtop_d->time_running = gtop->window_ns;
 
-				/* copy the info over */
-				selected_client->pid = curr_client->pid;
-				memcpy(selected_client->name, curr_client->name, name_len);
-			}
+	/* back to the one selected, for the pages not rotating */
+	perf_context_set(selected_ctx, dev);
+}
+
+/*
+ * plan readers, dst being what they accumulate into
+ */
+static int
+gtop_plan_read_perf(struct perf_device *dev, void *dst, int s)
+{
+	(void) s;
+	return gtop_compute_perf(dev, dst);
+}
+
+static int
+gtop_plan_read_perf_mux(struct perf_device *dev, void *dst, int s)
+{
+	return gtop_compute_perf_mux(dev, dst, s);
+}
+
+static int
+gtop_plan_read_perf_rotate(struct perf_device *dev, void *dst, int s)
+{
+	return gtop_compute_perf_rotate(dev, dst, s);
+}
+
+static int
+gtop_plan_read_dma(struct perf_device *dev, void *dst, int s)
+{
+	struct gtop *gtop = dst;
+
+	(void) s;
+	return gtop_compute_mode_dma(dev, &gtop->st);
+}
+
+static int
+gtop_plan_read_idle_state(struct perf_device *dev, void *dst, int s)
+{
+	(void) s;
+	return gtop_compute_mode_idle_state(dev, dst);
+}
+
+static int
+gtop_plan_read_occupancy(struct perf_device *dev, void *dst, int s)
+{
+	struct gtop *gtop = dst;
+
+	(void) s;
+	return gtop_compute_mode_occupancy(dev, &gtop->st, gtop->idle_reg_addr);
+}
+
+static void
+gtop_plan_add(struct gtop_plan *plan, gtop_plan_reader read, void *dst)
+{
+	assert(plan->nr_steps < PLAN_MAX_STEPS);
+
+	plan->steps[plan->nr_steps].read = read;
+	plan->steps[plan->nr_steps].dst = dst;
+	plan->nr_steps++;
+}
+
+static void
+gtop_plan_add_counters(struct gtop_plan *plan, struct gtop *gtop,
+		       enum vivante_profiler_type_counter type)
+{
+	if (FLAG_IS_SET(flags, FLAG_ROTATE) &&
+	    !FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS)) {
+		/* one group only, the contexts take the slots */
+		gtop_rotate_init(gtop, type);
+		gtop_plan_add(plan, gtop_plan_read_perf_rotate, gtop);
+		plan->rotate = true;
+	} else if (!FLAG_IS_SET(flags, FLAG_MULTIPLEX)) {
+		gtop_plan_add(plan, gtop_plan_read_perf, gtop->perf_data[type]);
+	} else if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS)) {
+		/* instantaneous view, just read both groups once */
+		gtop_plan_add(plan, gtop_plan_read_perf, gtop->perf_data[VIV_PROF_COUNTER_PART1]);
+		gtop_plan_add(plan, gtop_plan_read_perf, gtop->perf_data[VIV_PROF_COUNTER_PART2]);
+	} else {
+		gtop_plan_add(plan, gtop_plan_read_perf_mux, gtop);
+		plan->mux = true;
+	}
+
+	plan->profiler = true;
+}
+
+/* flags which change what we sample */
+#define PLAN_FLAGS	(SET_BIT(FLAG_MULTIPLEX) | SET_BIT(FLAG_SHOW_BATCH_CONTEXTS) | \
+			 SET_BIT(FLAG_ROTATE))
+
+static uint8_t
+gtop_plan_page(void)
+{
+	return FLAG_IS_SET(flags, FLAG_MODE) ? (uint8_t) mode : curr_page;
+}
+
+static bool
+gtop_plan_is_current(const struct gtop_plan *plan)
+{
+	return plan->compiled && plan->page == gtop_plan_page() &&
+	       plan->flags == (flags & PLAN_FLAGS) && plan->ctx == selected_ctx &&
+	       plan->groups == daemon_groups;
+}
+
+/*
+ * Pages and modes share the same values so we can compile the plan from
+ * either of them.
+ */
+static void
+gtop_plan_compile(struct gtop_plan *plan, struct gtop *gtop)
+{
+	memset(plan, 0, sizeof(*plan));
+
+	plan->page = gtop_plan_page();
+	plan->flags = flags & PLAN_FLAGS;
+	plan->ctx = selected_ctx;
+	plan->groups = daemon_groups;
+	plan->compiled = true;
+
+	/* recordings hold everything, whatever page is being displayed */
+	if (gtop_trace_wanted() || FLAG_IS_SET(flags, FLAG_TRACE_EVENTS)) {
+		gtop_plan_add(plan, gtop_plan_read_perf_mux, gtop);
+		gtop_plan_add(plan, gtop_plan_read_dma, gtop);
+		gtop_plan_add(plan, gtop_plan_read_idle_state, gtop);
+		gtop_plan_add(plan, gtop_plan_read_occupancy, gtop);
+		plan->mux = true;
+		plan->idle_states = true;
+		plan->profiler = true;
+		return;
+	}
+
+	/* the daemon samples only what its subscribers asked for */
+	if (FLAG_IS_SET(flags, FLAG_DAEMON)) {
+		if (daemon_groups & (SUB_GROUP(TRACE_GROUP_PART1) |
+				     SUB_GROUP(TRACE_GROUP_PART2))) {
+			gtop_plan_add(plan, gtop_plan_read_perf_mux, gtop);
+			plan->mux = true;
+			plan->profiler = true;
+		}
+		if (daemon_groups & SUB_GROUP(TRACE_GROUP_DMA)) {
+			gtop_plan_add(plan, gtop_plan_read_dma, gtop);
+			plan->profiler = true;
 		}
+		if (daemon_groups & SUB_GROUP(TRACE_GROUP_OCCUPANCY)) {
+			gtop_plan_add(plan, gtop_plan_read_idle_state, gtop);
+			gtop_plan_add(plan, gtop_plan_read_occupancy, gtop);
+			plan->idle_states = true;
+			plan->profiler = true;
+		}
+		return;
+	}
 
+	/* so does the exporter, counters apart */
+	if (FLAG_IS_SET(flags, FLAG_SERVE)) {
+		gtop_plan_add(plan, gtop_plan_read_dma, gtop);
+		gtop_plan_add(plan, gtop_plan_read_idle_state, gtop);
+		gtop_plan_add(plan, gtop_plan_read_occupancy, gtop);
+		plan->idle_states = true;
+		plan->profiler = true;
+		return;
 	}
 
-	/* free all resources */
-	debugfs_free_clients(&clients);
+	switch (plan->page) {
+	case PAGE_COUNTER_PART1:
+		gtop_plan_add_counters(plan, gtop, VIV_PROF_COUNTER_PART1);
+		break;
+	case PAGE_COUNTER_PART2:
+		gtop_plan_add_counters(plan, gtop, VIV_PROF_COUNTER_PART2);
+		break;
+	case PAGE_DMA:
+		gtop_plan_add(plan, gtop_plan_read_dma, gtop);
+		plan->profiler = true;
+		break;
+	case PAGE_OCCUPANCY:
+		gtop_plan_add(plan, gtop_plan_read_idle_state, gtop);
+		gtop_plan_add(plan, gtop_plan_read_occupancy, gtop);
+		plan->idle_states = true;
+		plan->profiler = true;
+		break;
+	case PAGE_VID_MEM_USAGE:
+	case PAGE_SHOW_CLIENTS:
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+	case PAGE_DDR_PERF:
+#endif
+		/* nothing to sample */
+		break;
+	default:
+		dprintf("Invalid page view specified!\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Accounts the time of the window. With multiplexing the running time has been
+ * accumulated per slot and the group was enabled for the whole window,
+ * otherwise the deltas cover exactly the running time.
+ */
+static void
+gtop_compute_window(struct gtop *gtop, uint64_t window_ns, bool mux)
+{
+	gtop->window_ns = window_ns;
 
-	return ctx_found;
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		struct gtop_data *gtop_d = gtop->perf_data[i];
+
+		if (mux)
+			gtop_d->time_enabled = window_ns;
+		else
+			gtop_d->time_enabled = gtop_d->time_running;
+	}
 }
 
-static uint32_t
-gtop_get_ctx_from_keyboard(struct perf_device *dev)
+static void
+gtop_wait_for_keyboard(const char *str, bool clean_screen)
 {
-	uint32_t c_ctx;
-	int m;
+	int dummy;
 
-	/* restore back tty so we can get a number */
-	tty_reset(&tty_old);
+	if (clean_screen)
+		fprintf(stdout, "%s\n", clear_screen);
+	if (str)
+		fprintf(stdout, "%s", str);
 
-	fprintf(stdout, "Type context to attach to (0 to quit): ");
-	m = scanf("%u", &c_ctx);
-	(void) m;
+	fprintf(stdout, "\n Type any key to resume...\n");
 
-	/* if we don't support this board */
-	if (gtop_is_chip_model(0x7000, dev) && (gtop_info.drv_info.build < 150331)) {
-		tty_init(&tty_old);
-		gtop_wait_for_keyboard("GC7000 not supported at the moment!\n", true);
-		tty_reset(&tty_old);
-		goto out;
+	fflush(NULL);
+	if (!gtop_wait_input())
+		return;
+
+	ssize_t nr = read(STDIN_FILENO, &dummy, sizeof(int));
+	(void) nr;
+}
+
+static void
+gtop_selected_client_set(uint32_t pid, const char *name)
+{
+	if (selected_client == NULL) {
+		selected_client = calloc(1, sizeof(*selected_client));
+		if (!selected_client) {
+			dprintf("malloc?\n");
+			exit(EXIT_FAILURE);
+		}
 	}
 
-	while (!gtop_check_ctx_is_valid(c_ctx) && c_ctx != 0) {
-		fprintf(stdout, "Type context to attach to (0 to quit): ");
-		m = scanf("%u", &c_ctx);
+	/* copy the info over, if it is not the one we have already */
+	if (!selected_client->name || strcmp(selected_client->name, name)) {
+		free(selected_client->name);
+		selected_client->name = strdup(name);
+		if (!selected_client->name) {
+			dprintf("malloc?\n");
+			exit(EXIT_FAILURE);
+		}
 	}
+	selected_client->pid = pid;
+}
 
-out:
-	/* go back into canonical mode */
-	tty_init(&tty_old);
+static bool
+gtop_check_ctx_is_valid(uint32_t c)
+{
+	const struct debugfs_ctx_entry *entry;
+
+	/* parses the database only if it changed since */
+	if (debugfs_ctx_index_update(&ctx_index, NULL) < 0)
+		return false;
 
+	entry = debugfs_ctx_index_find(&ctx_index, c);
 
-	return c_ctx;
+	/* skip our program from attached programs */
+	if (!entry || !strncmp(entry->name, prg_name, strlen(prg_name)))
+		return false;
+
+	gtop_selected_client_set(entry->pid, entry->name);
+	return true;
 }
 
 static void
-gtop_get_no_samples_from_keyboard(void)
+gtop_selected_client_clear(void)
 {
-	int m;
+	if (selected_client) {
+		free(selected_client->name);
+		free(selected_client);
+		selected_client = NULL;
+	}
+}
 
-	/* restore back tty so we can get a number */
-	tty_reset(&tty_old);
+/*
+ * whether the counter pages have a context to show, dropping the selected one
+ * if it went away since
+ */
+static bool
+gtop_context_ready(struct perf_device *dev)
+{
+	/* gtop_follow() takes care of it, rotating needs none */
+	if (FLAG_IS_SET(flags, FLAG_FOLLOW) || FLAG_IS_SET(flags, FLAG_ROTATE))
+		return true;
+
+	if (!selected_client || !selected_client->name)
+		return false;
+
+	if (!gtop_check_ctx_is_valid(selected_ctx)) {
+		gtop_selected_client_clear();
+
+		selected_ctx = 0;
+		/* use our own context in this case */
+		perf_context_set(selected_ctx, dev);
+	}
 
-	fprintf(stdout, "# Samples: ");
-	m = scanf("%u", &samples);
-	(void) m;
+	return true;
+}
+
+/*
+ * attach to the newest context of the process followed, or to ours while it
+ * has none; looks again only when the database changed
+ */
+static void
+gtop_follow(struct perf_device *dev)
+{
+	const struct debugfs_ctx_entry *entry, *newest = NULL;
+
+	if (debugfs_ctx_index_update(&ctx_index, NULL) < 0 ||
+	    ctx_index.generation == follow.generation)
+		return;
+
+	follow.generation = ctx_index.generation;
+
+	ctx_index_for_each(entry, &ctx_index) {
+		if (follow.name ? strcmp(entry->name, follow.name) != 0 :
+				  entry->pid != follow.pid)
+			continue;
+
+		/* contexts are handed out increasing */
+		if (!newest || entry->ctx > newest->ctx)
+			newest = entry;
+	}
+
+	if (!newest) {
+		/* gone, wait for it to come back */
+		if (selected_ctx) {
+			selected_ctx = 0;
+			gtop_selected_client_clear();
+			perf_context_set(selected_ctx, dev);
+		}
+		return;
+	}
+
+	gtop_selected_client_set(newest->pid, newest->name);
+	if (newest->ctx != selected_ctx) {
+		selected_ctx = newest->ctx;
+		perf_context_set(selected_ctx, dev);
+	}
+}
+
+static void
+gtop_picker_add(uint32_t pid, uint32_t ctx, const char *name)
+{
+	if (picker.nr_entries == picker.size) {
+		picker.size = picker.size ? picker.size * 2 : 16;
+		picker.entries = realloc(picker.entries,
+					 picker.size * sizeof(*picker.entries));
+		if (!picker.entries) {
+			dprintf("malloc?\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	picker.entries[picker.nr_entries++] = (struct gtop_picker_entry) {
+		.pid = pid,
+		.ctx = ctx,
+		.name = name,
+	};
+}
+
+static void
+gtop_picker_close(void)
+{
+	debugfs_free_clients(&picker.clients);
+	picker.nr_entries = 0;
+	picker.type = PICKER_NONE;
+}
+
+/*
+ * the clients and their contexts read once, the cursor on the context we
+ * follow
+ */
+static void
+gtop_picker_open_context(struct perf_device *dev)
+{
+	struct debugfs_client *client;
+
+	gtop_picker_close();
+	picker.type = PICKER_CONTEXT;
+	picker.message = NULL;
+	picker.cursor = picker.first = 0;
+
+	/* if we don't support this board */
+	if (gtop_is_chip_model(0x7000, dev) && (gtop_info.drv_info.build < 150331)) {
+		picker.message = "GC7000 not supported at the moment!";
+		return;
+	}
+
+	/* our own, to stop following an application */
+	gtop_picker_add(0, 0, "(none)");
+
+	if (debugfs_get_current_clients(&picker.clients, NULL) &&
+	    debugfs_get_contexts(&picker.clients, NULL) == 0) {
+		list_for_each(client, picker.clients.head) {
+			if (!strncmp(client->name, prg_name, strlen(prg_name)))
+				continue;
+
+			for (size_t ctx = 0; ctx < client->ctx_no; ctx++) {
+				if (client->ctx[ctx] == selected_ctx)
+					picker.cursor = picker.nr_entries;
+				gtop_picker_add(client->pid, client->ctx[ctx], client->name);
+			}
+		}
+	}
+}
+
+static void
+gtop_picker_open_samples(void)
+{
+	gtop_picker_close();
+	picker.type = PICKER_SAMPLES;
+	picker.input_len = 0;
+	picker.input[0] = '\0';
+}
+
+/*
+ * follow the context under the cursor, or ours
+ */
+static void
+gtop_picker_pick_context(struct perf_device *dev)
+{
+	uint32_t ctx = picker.entries[picker.cursor].ctx;
+
+	/* gone since, have a look again */
+	if (ctx && !gtop_check_ctx_is_valid(ctx)) {
+		gtop_picker_open_context(dev);
+		return;
+	}
+
+	/* picked by hand, stop following */
+	REMOVE_FLAG(flags, FLAG_FOLLOW);
+
+	selected_ctx = ctx;
+	perf_context_set(selected_ctx, dev);
+	if (!selected_ctx)
+		gtop_selected_client_clear();
+
+	gtop_picker_close();
+}
+
+/*
+ * a key for the picker, returns 0 if it changed what gets sampled and 1 if
+ * it only needs to be drawn again
+ */
+static int
+gtop_picker_key(struct perf_device *dev, long long key)
+{
+	size_t page = screen.rows > 4 ? screen.rows - 4 : 1;
+	size_t last = picker.nr_entries ? picker.nr_entries - 1 : 0;
+
+	if (key == KB_ESCAPE || key == KEY_Q ||
+	    (picker.type == PICKER_CONTEXT && picker.message)) {
+		gtop_picker_close();
+		return 1;
+	}
+
+	if (picker.type == PICKER_SAMPLES) {
+		if (key >= KEY_0 && key <= '9' && picker.input_len < PICKER_SAMPLES_DIGITS) {
+			picker.input[picker.input_len++] = key;
+			picker.input[picker.input_len] = '\0';
+		} else if ((key == KB_BACK || key == '\b') && picker.input_len) {
+			picker.input[--picker.input_len] = '\0';
+		} else if (key == KB_SEEK && atoi(picker.input) > 0) {
+			samples = atoi(picker.input);
+			gtop_picker_close();
+			return 0;
+		}
+		return 1;
+	}
+
+	switch (key) {
+	case KB_UP:
+	case KB_UP_SERIAL:
+		if (picker.cursor)
+			picker.cursor--;
+		break;
+	case KB_DOWN:
+	case KB_DOWN_SERIAL:
+		if (picker.cursor < last)
+			picker.cursor++;
+		break;
+	case KB_PGUP:
+		picker.cursor = picker.cursor > page ? picker.cursor - page : 0;
+		break;
+	case KB_PGDN:
+		picker.cursor = picker.cursor + page < last ? picker.cursor + page : last;
+		break;
+	case KB_HOME:
+		picker.cursor = 0;
+		break;
+	case KB_END:
+		picker.cursor = last;
+		break;
+	case KB_SEEK:
+	case KB_SPACE:
+		gtop_picker_pick_context(dev);
+		return 0;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+static int
+gtop_compute(struct perf_device *dev, struct gtop *gtop)
+{
+	int s;
+	uint8_t i;
+	struct timespec interval = {};
+	int err = 0;
+	uint64_t window_start;
+	struct gtop_plan *plan = &gtop->plan;
+
+	interval.tv_sec = 0;
+	interval.tv_nsec = (USEC_PER_SEC / samples);
+
+
+	if (!gtop_plan_is_current(plan))
+		gtop_plan_compile(plan, gtop);
+
+	/* bail early in case there's nothing to sample */
+	if (plan->nr_steps == 0)
+		return 0;
+
+	if (plan->profiler && gtop_start_profiling(dev) < 0)
+		return -1;
+
+	/* clear every time gpu state so we get % values correctly */
+	memset(&gtop->st, 0, sizeof(struct vivante_gpu_state));
+
+	if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS))
+		samples = 1;
+
+	if (plan->idle_states)
+		gtop_idle_words_reserve(gtop, samples);
+
+	if (plan->rotate)
+		gtop_rotate_begin(gtop);
+
+	window_start = get_ns_time();
+
+	/* in batch mode we just run it once */
+	for (s = 0; s < samples; s++) {
+
+		for (i = 0; i < plan->nr_steps; i++) {
+			err = plan->steps[i].read(dev, plan->steps[i].dst, s);
+			if (err < 0)
+				return err;
+		}
+
+		if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS))
+			break;
+
+		nanosleep(&interval, NULL);
+	}
+
+	gtop_compute_window(gtop, get_ns_time() - window_start, plan->mux);
+
+	if (plan->rotate)
+		gtop_rotate_end(dev, gtop);
+
+	if (plan->idle_states)
+		gtop_compute_idle_states(gtop);
+
+	return 0;
+}
+
+/*
+ * Retrieve the number of frames rendered in the last window, either from
+ * the frame counter or from the marker file.
+ */
+static void
+gtop_rate_update(const struct gtop *gtop)
+{
+	rate.frames = 0;
+
+	if (rate.frame_type) {
+		const struct gtop_data *gtop_d = gtop->perf_data[rate.frame_type];
+
+		rate.frames = stats_mux_scale(gtop_d->events_per_sample[rate.frame_id],
+					      gtop_d->time_enabled, gtop_d->time_running);
+	} else if (rate.marker_path) {
+		unsigned long long marker = 0;
+		FILE *file;
+
+		file = fopen(rate.marker_path, "r");
+		if (!file)
+			return;
+
+		if (fscanf(file, "%llu", &marker) == 1) {
+			if (rate.marker_last && marker >= rate.marker_last)
+				rate.frames = marker - rate.marker_last;
+			rate.marker_last = marker;
+		}
+
+		fclose(file);
+	}
+}
+
+/*
+ * look-up the frame counter by its name in both groups
+ */
+static void
+gtop_rate_resolve(const struct gtop *gtop)
+{
+	if (!rate.frame_name)
+		return;
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		const struct gtop_data *gtop_d = gtop->perf_data[i];
+
+		for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++) {
+			if (!strcmp(gtop_d->desc[c].name, rate.frame_name)) {
+				rate.frame_type = gtop_d->type;
+				rate.frame_id = c;
+				return;
+			}
+		}
+	}
+
+	dprintf("Frame counter %s not found\n", rate.frame_name);
+	exit(EXIT_FAILURE);
+}
+
+
+static void
+gtop_output_counters(struct output *out, const struct gtop_data *gtop_d,
+		     const char *group, bool mux)
+{
+	output_group_begin(out, group);
+
+	if (mux)
+		output_fixed(out, "active_percent",
+			     stats_mux_active(gtop_d->time_enabled, gtop_d->time_running));
+
+	for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++) {
+		uint64_t value = gtop_counter_value(gtop_d, c);
+
+		/* left out rather than passing window totals off as per frame */
+		if (value != STATS_RATE_NONE)
+			output_u64(out, gtop_d->desc[c].name, value);
+	}
+
+	output_group_end(out);
+}
+
+static void
+gtop_output_occupancy(struct output *out, const struct vivante_gpu_state *st)
+{
+	char name[32];
+
+	output_group_begin(out, "busy_percent");
+
+	for (size_t i = 0; i < NUM_VIV_IDLE_MODULES; i++) {
+		gtop_module_short_name(name, sizeof(name), i);
+		output_fixed(out, name, gtop_module_busy_percent(st, i) / 100.0);
+	}
+
+	output_group_end(out);
+}
+
+static void
+gtop_output_dma(struct output *out, const struct vivante_gpu_state *st)
+{
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+		struct dma_table *table = &dma_tables[t];
+		attach_gpu_state_to_dma_table(table, (struct vivante_gpu_state *) st);
+
+		output_group_begin(out, table->name);
+
+		for (int i = 0; i < table->data_size; i++)
+			output_fixed(out, table->data_names[i],
+				     100.0f * ((double) table->data[i] / (double) samples));
+
+		output_group_end(out);
+	}
+}
+
+static void
+gtop_output_clients(struct output *out, struct perf_device *dev)
+{
+	struct debugfs_client clients;
+	struct debugfs_client *curr_client;
+	struct perf_client_memory client_total = {};
+	char pid[16];
+
+	if (!debugfs_get_current_clients(&clients, NULL))
+		return;
+
+	if (debugfs_get_contexts(&clients, NULL) < 0)
+		return;
+
+	output_group_begin(out, "clients");
+
+	list_for_each(curr_client, clients.head) {
+		struct perf_client_memory cmem = {};
+
+		/* skip our program from attached programs */
+		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
+			continue;
+#if !defined __QNXTO__ && !defined __QNX__
+		if (curr_client->ctx_no == 0)
+			continue;
+#endif
+		perf_get_client_memory(&cmem, curr_client->pid, dev);
+
+		client_total.total += cmem.total;
+		client_total.reserved += cmem.reserved;
+		client_total.contigous += cmem.contigous;
+		client_total._virtual += cmem._virtual;
+		client_total.non_paged += cmem.non_paged;
+
+		snprintf(pid, sizeof(pid), "%u", curr_client->pid);
+		output_group_begin(out, pid);
+
+		output_str(out, "name", curr_client->name);
+		output_u64(out, "res_kb", cmem.reserved / 1024);
+		output_u64(out, "cont_kb", cmem.contigous / 1024);
+		output_u64(out, "virt_kb", cmem._virtual / 1024);
+		output_u64(out, "non_paged_kb", cmem.non_paged / 1024);
+		output_u64(out, "total_kb", cmem.total / 1024);
+
+		output_group_end(out);
+	}
+
+	output_group_end(out);
+
+	output_group_begin(out, "total");
+	output_u64(out, "res_kb", client_total.reserved / 1024);
+	output_u64(out, "cont_kb", client_total.contigous / 1024);
+	output_u64(out, "virt_kb", client_total._virtual / 1024);
+	output_u64(out, "non_paged_kb", client_total.non_paged / 1024);
+	output_u64(out, "total_kb", client_total.total / 1024);
+	output_group_end(out);
+
+	debugfs_free_clients(&clients);
+}
+
+static void
+gtop_output_vid_mem_usage(struct output *out)
+{
+	struct debugfs_client clients;
+	struct debugfs_client *curr_client;
+	struct debugfs_vid_mem_client vm;
+	char pid[16];
+
+	if (!debugfs_get_current_clients(&clients, NULL))
+		return;
+
+	/* unlike the display, always in bytes */
+	output_group_begin(out, "clients");
+
+	list_for_each(curr_client, clients.head) {
+		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
+			continue;
+
+		if (debugfs_get_vid_mem(&vm, curr_client->pid) == -1)
+			break;
+
+		snprintf(pid, sizeof(pid), "%u", curr_client->pid);
+		output_group_begin(out, pid);
+
+		output_u64(out, "index", vm.index);
+		output_u64(out, "vertex", vm.vertex);
+		output_u64(out, "texture", vm.texture);
+		output_u64(out, "render_target", vm.render_target);
+		output_u64(out, "depth", vm.depth);
+		output_u64(out, "bitmap", vm.bitmap);
+		output_u64(out, "tile_status", vm.tile_status);
+		output_u64(out, "image", vm.image);
+		output_u64(out, "mask", vm.mask);
+		output_u64(out, "scissor", vm.scissor);
+		output_u64(out, "hz", vm.hz);
+		output_u64(out, "i_cache", vm.i_cache);
+		output_u64(out, "tx_desc", vm.tx_desc);
+		output_u64(out, "fence", vm.fence);
+		output_u64(out, "tfbheader", vm.tfbheader);
+
+		output_group_end(out);
+	}
+
+	output_group_end(out);
+
+	debugfs_free_clients(&clients);
+}
+
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+static void
+gtop_output_perf_pmus(struct output *out)
+{
+	unsigned int i, j;
+
+	gtop_start_pmus();
+
+	output_group_begin(out, "mbytes");
+
+	for_each_pmu(perf_pmu_ddrs, i) {
+		output_group_begin(out, PMU_GET_TYPE_NAME(perf_pmu_ddrs, i));
+
+		for_each_pmu(perf_pmu_ddrs[i].events, j) {
+			int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
+			if (fd > 0) {
+				const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j);
+				uint64_t counter_val = perf_event_pmu_read(fd);
+
+				output_fixed(out, event_name,
+					     gtop_pmu_mbytes(event_name, counter_val));
+				perf_event_pmu_reset(fd);
+			}
+		}
+
+		output_group_end(out);
+	}
+
+	output_group_end(out);
+}
+#endif
+
+/*
+ * serialize the current page as one record and hand it over with a single
+ * write(), in place of gtop_display_interactive() in batch mode
+ */
+static void
+gtop_output_window(struct perf_device *dev, const struct gtop *gtop,
+		   uint64_t timestamp)
+{
+	uint8_t page = gtop_plan_page();
+	bool mux = FLAG_IS_SET(flags, FLAG_MULTIPLEX) && gtop_is_counter_page();
+
+	output_begin(&output, mux ? "counters" : program_pages[page].page_name,
+		     timestamp);
+
+	if (gtop_is_counter_page()) {
+		output_str(&output, "unit", rate_names[rate.rate]);
+
+		if (mux || page == PAGE_COUNTER_PART1)
+			gtop_output_counters(&output, gtop->perf_data[VIV_PROF_COUNTER_PART1],
+					     "part1", mux);
+		if (mux || page == PAGE_COUNTER_PART2)
+			gtop_output_counters(&output, gtop->perf_data[VIV_PROF_COUNTER_PART2],
+					     "part2", mux);
+	} else {
+		switch (page) {
+		case PAGE_SHOW_CLIENTS:
+			gtop_output_clients(&output, dev);
+			break;
+		case PAGE_VID_MEM_USAGE:
+			gtop_output_vid_mem_usage(&output);
+			break;
+		case PAGE_DMA:
+			gtop_output_dma(&output, &gtop->st);
+			break;
+		case PAGE_OCCUPANCY:
+			gtop_output_occupancy(&output, &gtop->st);
+			break;
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+		case PAGE_DDR_PERF:
+			gtop_output_perf_pmus(&output);
+			break;
+#endif
+		default:
+			break;
+		}
+	}
+
+	output_end(&output);
+
+	if (output_buf.truncated)
+		dprintf("Output truncated, buffer could not be grown\n");
+
+	if (buf_write(&output_buf, STDOUT_FILENO) < 0) {
+		dprintf("write()");
+		sig_recv = 1;
+	}
+}
+
+static void
+gtop_trace_chip(struct perf_device *dev, struct trace_chip *chip)
+{
+	struct perf_hw_info *hw_info_iter = NULL;
+
+	memset(chip, 0, sizeof(*chip));
+
+	/* the 3D core is the one we sample */
+	list_for_each(hw_info_iter, gtop_info.hw_info.head) {
+		if (perf_get_core_type(hw_info_iter->id, dev) == PERF_CORE_3D) {
+			chip->model = hw_info_iter->model;
+			chip->revision = hw_info_iter->revision;
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(chip->cores); i++)
+		chip->cores[i] = gtop_info.cores[i];
+
+	chip->drv_major = gtop_info.drv_info.major;
+	chip->drv_minor = gtop_info.drv_info.minor;
+	chip->drv_patch = gtop_info.drv_info.patch;
+	chip->drv_build = gtop_info.drv_info.build;
+}
+
+static struct trace_column *
+gtop_trace_column(struct trace_column *columns, uint32_t *nr,
+		  enum trace_group group, uint32_t id,
+		  const char *name, const char *desc)
+{
+	struct trace_column *col = &columns[(*nr)++];
+
+	snprintf(col->name, sizeof(col->name), "%s", name);
+	snprintf(col->desc, sizeof(col->desc), "%s", desc);
+	col->group = group;
+	col->id = id;
+
+	return col;
+}
+
+/*
+ * Everything we sample in a window, the standard columns first.
+ */
+static struct trace_column *
+gtop_trace_columns(const struct gtop *gtop, uint32_t *nr)
+{
+	struct trace_column *columns;
+	uint32_t nr_columns = TRACE_COL_STD_NO + NUM_VIV_IDLE_MODULES;
+	char name[32];
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++)
+		nr_columns += 2 + gtop->perf_data[i]->num_perf_counters;
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++)
+		nr_columns += dma_tables[t].data_size;
+	nr_columns += TRACE_MEM_NO;
+
+	columns = calloc(nr_columns, sizeof(*columns));
+	if (!columns) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*nr = 0;
+	gtop_trace_column(columns, nr, TRACE_GROUP_WINDOW, TRACE_COL_TIMESTAMP,
+			  "timestamp_ns", "End of the window");
+	gtop_trace_column(columns, nr, TRACE_GROUP_WINDOW, TRACE_COL_FLAGS,
+			  "flags", "Markers");
+	gtop_trace_column(columns, nr, TRACE_GROUP_WINDOW, TRACE_COL_WINDOW,
+			  "window_ns", "Length of the window");
+	gtop_trace_column(columns, nr, TRACE_GROUP_WINDOW, TRACE_COL_SAMPLES,
+			  "samples", "Samples taken in the window");
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		const struct gtop_data *gtop_d = gtop->perf_data[i];
+		enum trace_group group = (i == VIV_PROF_COUNTER_PART1) ?
+			TRACE_GROUP_PART1 : TRACE_GROUP_PART2;
+
+		gtop_trace_column(columns, nr, group, TRACE_ID_TIME_ENABLED,
+				  "time_enabled", "Time (ns) the group was enabled");
+		gtop_trace_column(columns, nr, group, TRACE_ID_TIME_RUNNING,
+				  "time_running", "Time (ns) the group was read");
+
+		for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++)
+			gtop_trace_column(columns, nr, group, c,
+					  gtop_d->desc[c].name, gtop_d->desc[c].desc);
+	}
+
+	for (uint32_t mid = 0; mid < NUM_VIV_IDLE_MODULES; mid++) {
+		gtop_module_short_name(name, sizeof(name), mid);
+		gtop_trace_column(columns, nr, TRACE_GROUP_OCCUPANCY, mid, name,
+				  vivante_idle_module_names[mid].name);
+	}
+
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+		const struct dma_table *table = &dma_tables[t];
+
+		for (int i = 0; i < table->data_size; i++)
+			gtop_trace_column(columns, nr, TRACE_GROUP_DMA, (t << 16) | i,
+					  table->data_names[i], table->name);
+	}
+
+	gtop_trace_column(columns, nr, TRACE_GROUP_MEMORY, TRACE_MEM_TOTAL,
+			  "total_kb", "Memory allocated by all clients");
+	gtop_trace_column(columns, nr, TRACE_GROUP_MEMORY, TRACE_MEM_RESERVED,
+			  "res_kb", "Reserved memory of all clients");
+	gtop_trace_column(columns, nr, TRACE_GROUP_MEMORY, TRACE_MEM_CONTIGUOUS,
+			  "cont_kb", "Contiguous memory of all clients");
+	gtop_trace_column(columns, nr, TRACE_GROUP_MEMORY, TRACE_MEM_VIRTUAL,
+			  "virt_kb", "Virtual memory of all clients");
+	gtop_trace_column(columns, nr, TRACE_GROUP_MEMORY, TRACE_MEM_NON_PAGED,
+			  "non_paged_kb", "Non-paged memory of all clients");
+
+	assert(*nr == nr_columns);
+	return columns;
+}
+
+/*
+ * the groups the plan has sampled in the last window
+ */
+static uint32_t
+gtop_plan_groups(const struct gtop *gtop)
+{
+	const struct gtop_plan *plan = &gtop->plan;
+	uint32_t groups = 0;
+
+	for (uint8_t i = 0; i < plan->nr_steps; i++) {
+		const struct gtop_plan_step *step = &plan->steps[i];
+
+		if (step->read == gtop_plan_read_perf_mux)
+			groups |= SUB_GROUP(TRACE_GROUP_PART1) | SUB_GROUP(TRACE_GROUP_PART2);
+		else if (step->read == gtop_plan_read_perf)
+			groups |= step->dst == gtop->perf_data[VIV_PROF_COUNTER_PART1] ?
+				  SUB_GROUP(TRACE_GROUP_PART1) : SUB_GROUP(TRACE_GROUP_PART2);
+		else if (step->read == gtop_plan_read_dma)
+			groups |= SUB_GROUP(TRACE_GROUP_DMA);
+		else if (step->read == gtop_plan_read_occupancy)
+			groups |= SUB_GROUP(TRACE_GROUP_OCCUPANCY);
+	}
+
+	return groups;
+}
+
+/*
+ * UTF-8 as far as the locale goes, we don't need setlocale() for anything else
+ */
+static bool
+gtop_history_utf8(void)
+{
+	const char *vars[] = { "LC_ALL", "LC_CTYPE", "LANG" };
+
+	for (size_t i = 0; i < ARRAY_SIZE(vars); i++) {
+		const char *val = getenv(vars[i]);
+		char lower[64];
+		size_t n;
+
+		if (!val || !*val)
+			continue;
+
+		for (n = 0; val[n] && n < sizeof(lower) - 1; n++)
+			lower[n] = tolower((unsigned char) val[n]);
+		lower[n] = '\0';
+
+		return strstr(lower, "utf-8") || strstr(lower, "utf8");
+	}
+
+	return false;
+}
+
+static void
+gtop_history_init(const struct gtop *gtop)
+{
+	size_t nr_dma = 0;
+
+	for (size_t i = 0; i < NUM_VIV_IDLE_MODULES; i++)
+		history_init(&history.occupancy[i], 10000);
+	for (size_t i = 0; i < ARRAY_SIZE(history.usage); i++)
+		history_init(&history.usage[i], 10000);
+
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++)
+		nr_dma += dma_tables[t].data_size;
+
+	history.dma = malloc(nr_dma * sizeof(*history.dma));
+	if (!history.dma) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < nr_dma; i++)
+		history_init(&history.dma[i], 10000);
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		uint32_t nr = gtop->perf_data[i]->num_perf_counters;
+
+		history.counters[i] = calloc(nr ? nr : 1, sizeof(struct history));
+		if (!history.counters[i]) {
+			dprintf("malloc?\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (history.style < 0)
+		history.style = gtop_history_utf8() ? HISTORY_BLOCKS : HISTORY_ASCII;
+	history.init = true;
+}
+
+static void
+gtop_history_free(void)
+{
+	free(history.dma);
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++)
+		free(history.counters[i]);
+	memset(&history, 0, sizeof(history));
+}
+
+/*
+ * one window more in the history of the groups which have been sampled,
+ * only what the pages draw
+ */
+static void
+gtop_history_window(const struct gtop *gtop, uint32_t groups)
+{
+	const struct vivante_gpu_state *st = &gtop->st;
+
+	if (!history.init)
+		gtop_history_init(gtop);
+
+	if (groups & SUB_GROUP(TRACE_GROUP_OCCUPANCY)) {
+		for (size_t i = 0; i < NUM_VIV_IDLE_MODULES; i++)
+			history_push(&history.occupancy[i], gtop_module_busy_percent(st, i));
+
+		history_push(&history.usage[0], 10000 -
+			     fmt_percent_of(st->total_idle_cycles_core0, samples));
+		history_push(&history.usage[1], 10000 -
+			     fmt_percent_of(st->total_idle_cycles_core1, samples));
+	}
+
+	if (groups & SUB_GROUP(TRACE_GROUP_DMA)) {
+		size_t k = 0;
+
+		for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+			struct dma_table *table = &dma_tables[t];
+			attach_gpu_state_to_dma_table(table, (struct vivante_gpu_state *) st);
+
+			for (int i = 0; i < table->data_size; i++)
+				history_push(&history.dma[k++],
+					     fmt_percent_of(table->data[i], samples));
+		}
+	}
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		const struct gtop_data *gtop_d = gtop->perf_data[i];
+
+		if (!(groups & SUB_GROUP(i == VIV_PROF_COUNTER_PART1 ?
+					 TRACE_GROUP_PART1 : TRACE_GROUP_PART2)))
+			continue;
+
+		for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++) {
+			uint64_t value = gtop_counter_value(gtop_d, c);
+
+			history_push(&history.counters[i][c],
+				     value == STATS_RATE_NONE ? 0 : value);
+		}
+	}
+}
+
+/*
+ * if anything consumes the windows as rows, sampling them all
+ */
+static bool
+gtop_trace_wanted(void)
+{
+	return FLAG_IS_SET(flags, FLAG_RECORD) || FLAG_IS_SET(flags, FLAG_SHM) ||
+	       FLAG_IS_SET(flags, FLAG_FLIGHT);
+}
+
+/*
+ * one row for all the consumers of windows, filled once per window
+ */
+static void
+gtop_trace_row_alloc(uint32_t nr_columns)
+{
+	if (trace_row)
+		return;
+
+	trace_row = calloc(nr_columns, sizeof(uint64_t));
+	if (!trace_row) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+gtop_trace_open(struct perf_device *dev, const struct gtop *gtop)
+{
+	struct trace_column *columns;
+	struct trace_chip chip;
+	uint32_t nr_columns;
+
+	gtop_trace_chip(dev, &chip);
+	columns = gtop_trace_columns(gtop, &nr_columns);
+
+	if (trace_writer_open(&trace_writer, record_path, &chip,
+			      columns, nr_columns) < 0) {
+		dprintf("Failed to create %s: %s\n", record_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	gtop_trace_row_alloc(nr_columns);
+
+	free(columns);
+}
+
+static void
+gtop_flight_open(struct perf_device *dev, const struct gtop *gtop)
+{
+	struct trace_column *columns;
+	struct trace_chip chip;
+	uint32_t nr_columns;
+
+	gtop_trace_chip(dev, &chip);
+	columns = gtop_trace_columns(gtop, &nr_columns);
+
+	if (flight_open(&flight, flight_path, flight_length_ns,
+			refresh.tv_sec * NSEC_PER_SEC + refresh.tv_nsec,
+			&chip, columns, nr_columns) < 0) {
+		dprintf("Failed to allocate the flight recorder: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < nr_flight_triggers; i++) {
+		if (flight_trigger_add(&flight, flight_triggers[i]) < 0) {
+			dprintf("Invalid trigger %s\n", flight_triggers[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	gtop_trace_row_alloc(nr_columns);
+	free(columns);
+}
+
+/*
+ * keep the window, dump the ring if asked to or if a trigger fired
+ */
+static void
+gtop_flight_window(void)
+{
+	const struct flight_trigger *t = flight_push(&flight, trace_row);
+	const char *why;
+	int no;
+
+	if (flight_requested) {
+		flight_requested = 0;
+		why = "SIGUSR1";
+	} else if (t) {
+		why = t->expr;
+	} else {
+		return;
+	}
+
+	no = flight_dump(&flight);
+
+	/* the screen would be wiped out right away */
+	if (!FLAG_IS_SET(flags, FLAG_SHOW_BATCH_PERF))
+		return;
+
+	if (no < 0)
+		fprintf(stderr, "Not dumping for %s, still writing the last dump\n", why);
+	else
+		fprintf(stderr, "Dumping to %s.%d for %s\n", flight_path, no, why);
+}
+
+static void
+gtop_shm_open(struct perf_device *dev, const struct gtop *gtop)
+{
+	struct trace_column *columns;
+	struct trace_chip chip;
+	uint32_t nr_columns;
+
+	gtop_trace_chip(dev, &chip);
+	columns = gtop_trace_columns(gtop, &nr_columns);
+
+	if (shm_writer_open(&shm_writer, shm_name, &chip, columns, nr_columns) < 0) {
+		dprintf("Failed to create %s: %s\n", shm_name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	gtop_trace_row_alloc(nr_columns);
+
+	free(columns);
+}
+
+/*
+ * next context to sample for, and what for
+ */
+static void
+gtop_daemon_next(struct perf_device *dev)
+{
+	uint32_t ctx = 0;
+
+	daemon_groups = sub_server_next(&subscribers, &ctx);
+	if (daemon_groups && ctx != selected_ctx) {
+		selected_ctx = ctx;
+		/* the same as selecting it from the keyboard */
+		perf_context_set(selected_ctx, dev);
+	}
+}
+
+/*
+ * subscribers get the same columns as recordings
+ */
+static void
+gtop_daemon_open(struct perf_device *dev, const struct gtop *gtop)
+{
+	struct trace_column *columns;
+	struct trace_chip chip;
+	uint32_t nr_columns;
+
+	gtop_trace_chip(dev, &chip);
+	columns = gtop_trace_columns(gtop, &nr_columns);
+
+	if (sub_server_open(&subscribers, daemon_path, &chip,
+			    columns, nr_columns) < 0) {
+		dprintf("Failed to listen on %s: %s\n", daemon_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	gtop_trace_row_alloc(nr_columns);
+
+	free(columns);
+}
+
+/*
+ * memory of all clients, in KiB, the same totals the clients page shows
+ */
+static void
+gtop_trace_memory(struct perf_device *dev, uint64_t now)
+{
+	struct debugfs_client clients;
+	struct debugfs_client *curr_client;
+	struct perf_client_memory total = {};
+
+	if (trace_mem_ns && now - trace_mem_ns < NSEC_PER_SEC)
+		return;
+	trace_mem_ns = now;
+
+	if (!debugfs_get_current_clients(&clients, NULL))
+		return;
+
+	list_for_each(curr_client, clients.head) {
+		struct perf_client_memory cmem = {};
+
+		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
+			continue;
+
+		perf_get_client_memory(&cmem, curr_client->pid, dev);
+
+		total.total += cmem.total;
+		total.reserved += cmem.reserved;
+		total.contigous += cmem.contigous;
+		total._virtual += cmem._virtual;
+		total.non_paged += cmem.non_paged;
+	}
+
+	debugfs_free_clients(&clients);
+
+	trace_mem[TRACE_MEM_TOTAL] = total.total / 1024;
+	trace_mem[TRACE_MEM_RESERVED] = total.reserved / 1024;
+	trace_mem[TRACE_MEM_CONTIGUOUS] = total.contigous / 1024;
+	trace_mem[TRACE_MEM_VIRTUAL] = total._virtual / 1024;
+	trace_mem[TRACE_MEM_NON_PAGED] = total.non_paged / 1024;
+}
+
+/*
+ * the last window as a row, in the same order as gtop_trace_columns()
+ */
+static void
+gtop_trace_fill(struct perf_device *dev, struct gtop *gtop, uint32_t groups)
+{
+	uint64_t *row = trace_row;
+	uint64_t now = get_realtime_ns();
+
+	*row++ = now;
+	*row++ = trace_marker ? TRACE_FLAG_MARKER : 0;
+	trace_marker = 0;
+	*row++ = gtop->window_ns;
+	*row++ = samples;
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++) {
+		const struct gtop_data *gtop_d = gtop->perf_data[i];
+
+		*row++ = gtop_d->time_enabled;
+		*row++ = gtop_d->time_running;
+
+		memcpy(row, gtop_d->events_per_sample,
+		       gtop_d->num_perf_counters * sizeof(uint64_t));
+		row += gtop_d->num_perf_counters;
+	}
+
+	/* busy samples, so that readers don't need to know which bits are inversed */
+	for (uint32_t mid = 0; mid < NUM_VIV_IDLE_MODULES; mid++) {
+		uint64_t count = gtop->st.viv_idle_states[mid];
+
+		if (!(groups & SUB_GROUP(TRACE_GROUP_OCCUPANCY)))
+			*row++ = 0;
+		else
+			*row++ = vivante_idle_module_names[mid].inv ? samples - count : count;
+	}
+
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+		struct dma_table *table = &dma_tables[t];
+		attach_gpu_state_to_dma_table(table, &gtop->st);
+
+		for (int i = 0; i < table->data_size; i++)
+			*row++ = table->data[i];
+	}
+
+	if (groups & SUB_GROUP(TRACE_GROUP_MEMORY)) {
+		gtop_trace_memory(dev, now);
+		memcpy(row, trace_mem, sizeof(trace_mem));
+	} else {
+		memset(row, 0, sizeof(trace_mem));
+	}
+}
+
+static void
+gtop_trace_record(void)
+{
+	if (trace_writer_append(&trace_writer, trace_row) < 0) {
+		dprintf("Failed to write %s: %s\n", record_path, strerror(errno));
+		sig_recv = 1;
+	}
+}
+
+static void
+gtop_trace_close(void)
+{
+	if (trace_writer_close(&trace_writer) < 0)
+		dprintf("Failed to write %s: %s\n", record_path, strerror(errno));
+}
+
+static void
+gtop_serve_clients(struct gtop_buf *buf, struct perf_device *dev)
+{
+	static const char *mem_types[] = {
+		"reserved", "contiguous", "virtual", "non_paged", "total",
+	};
+	static const char *vid_mem_types[] = {
+		"index", "vertex", "texture", "render_target", "depth", "bitmap",
+		"tile_status", "image", "mask", "scissor", "hz", "i_cache",
+		"tx_desc", "fence", "tfbheader",
+	};
+	struct debugfs_client clients;
+	struct debugfs_client *curr_client;
+	char pid[16];
+
+	if (!debugfs_get_current_clients(&clients, NULL))
+		return;
+
+	/* samples of a family have to be together, hence two walks */
+	serve_family(buf, "gputop_client_memory_bytes", "gauge",
+		     "GPU memory allocated by a client");
+
+	list_for_each(curr_client, clients.head) {
+		struct perf_client_memory cmem = {};
+
+		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
+			continue;
+
+		perf_get_client_memory(&cmem, curr_client->pid, dev);
+
+		uint64_t values[] = {
+			cmem.reserved, cmem.contigous, cmem._virtual,
+			cmem.non_paged, cmem.total,
+		};
+
+		snprintf(pid, sizeof(pid), "%u", curr_client->pid);
+		for (size_t i = 0; i < ARRAY_SIZE(mem_types); i++)
+			serve_sample(buf, "gputop_client_memory_bytes", values[i],
+				     "pid", pid, "name", curr_client->name,
+				     "type", mem_types[i], NULL);
+	}
+
+	serve_family(buf, "gputop_client_vidmem_bytes", "gauge",
+		     "Video memory of a client, per type");
+
+	list_for_each(curr_client, clients.head) {
+		struct debugfs_vid_mem_client vm;
+
+		if (!strncmp(curr_client->name, prg_name, strlen(prg_name)))
+			continue;
+
+		if (debugfs_get_vid_mem(&vm, curr_client->pid) == -1)
+			break;
+
+		uint64_t values[] = {
+			vm.index, vm.vertex, vm.texture, vm.render_target, vm.depth,
+			vm.bitmap, vm.tile_status, vm.image, vm.mask, vm.scissor,
+			vm.hz, vm.i_cache, vm.tx_desc, vm.fence, vm.tfbheader,
+		};
+
+		snprintf(pid, sizeof(pid), "%u", curr_client->pid);
+		for (size_t i = 0; i < ARRAY_SIZE(vid_mem_types); i++)
+			serve_sample(buf, "gputop_client_vidmem_bytes", values[i],
+				     "pid", pid, "name", curr_client->name,
+				     "type", vid_mem_types[i], NULL);
+	}
+
+	debugfs_free_clients(&clients);
+}
+
+static void
+gtop_serve_clocks_governor(struct gtop_buf *buf)
+{
+	struct gtop_clocks_governor governor = {};
+	struct {
+		const char *core, *clock;
+		uint32_t hz;
+	} clocks[] = {
+		{ "0", "core", 0 }, { "0", "shader", 0 },
+		{ "1", "core", 0 }, { "1", "shader", 0 },
+	};
+
+	gtop_get_clocks_governor(&governor);
+	clocks[0].hz = governor.clock.gpu_core_0;
+	clocks[1].hz = governor.clock.shader_core_0;
+	clocks[2].hz = governor.clock.gpu_core_1;
+	clocks[3].hz = governor.clock.shader_core_1;
+
+	/* only what the driver reports */
+	serve_family(buf, "gputop_clock_hertz", "gauge", "GPU core and shader clocks");
+	for (size_t i = 0; i < ARRAY_SIZE(clocks); i++)
+		if (clocks[i].hz)
+			serve_sample(buf, "gputop_clock_hertz", clocks[i].hz,
+				     "core", clocks[i].core, "clock", clocks[i].clock,
+				     NULL);
+
+	if (!governor.governor.governor)
+		return;
+
+	serve_family(buf, "gputop_governor", "gauge",
+		     "Current GPU governor, 1 for the one in use");
+	for (size_t i = 0; i < ARRAY_SIZE(governor_names); i++)
+		serve_sample(buf, "gputop_governor",
+			     governor.governor.governor == i + 1,
+			     "governor", governor_names[i], NULL);
+}
+
+static void
+gtop_serve_gpu_state(struct gtop_buf *buf, struct vivante_gpu_state *st)
+{
+	char name[32];
+
+	serve_family(buf, "gputop_module_busy_ratio", "gauge",
+		     "Fraction of the samples a module has been busy in");
+	for (size_t i = 0; i < NUM_VIV_IDLE_MODULES; i++) {
+		gtop_module_short_name(name, sizeof(name), i);
+		serve_sample(buf, "gputop_module_busy_ratio",
+			     gtop_module_busy_percent(st, i) / 10000.0,
+			     "module", name, NULL);
+	}
+
+	serve_family(buf, "gputop_dma_state_ratio", "gauge",
+		     "Fraction of the samples a DMA engine has been in a state");
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+		struct dma_table *table = &dma_tables[t];
+		attach_gpu_state_to_dma_table(table, st);
+
+		for (int i = 0; i < table->data_size; i++)
+			serve_sample(buf, "gputop_dma_state_ratio",
+				     (double) table->data[i] / (double) samples,
+				     "engine", table->name,
+				     "state", table->data_names[i], NULL);
+	}
+}
+
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+static void
+gtop_serve_perf_pmus(struct gtop_buf *buf, uint64_t window_ns)
+{
+	unsigned int i, j;
+
+	if (!window_ns)
+		return;
+
+	gtop_start_pmus();
+
+	serve_family(buf, "gputop_ddr_bytes_per_second", "gauge",
+		     "DDR bandwidth over the last window");
+
+	for_each_pmu(perf_pmu_ddrs, i) {
+		for_each_pmu(perf_pmu_ddrs[i].events, j) {
+			int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
+			if (fd > 0) {
+				const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j);
+				uint64_t counter_val = perf_event_pmu_read(fd);
+
+				serve_sample(buf, "gputop_ddr_bytes_per_second",
+					     gtop_pmu_mbytes(event_name, counter_val) *
+					     1024.0 * 1024.0 * NSEC_PER_SEC / window_ns,
+					     "pmu", PMU_GET_TYPE_NAME(perf_pmu_ddrs, i),
+					     "event", event_name, NULL);
+				perf_event_pmu_reset(fd);
+			}
+		}
+	}
+}
+#endif
+
+static void
+gtop_trace_events_open(struct perf_device *dev)
+{
+	struct trace_chip chip;
+	char process[32];
+
+	gtop_trace_chip(dev, &chip);
+	snprintf(process, sizeof(process), "GPU GC%x", chip.model);
+
+	if (trace_event_open(&trace_events, trace_events_path, process) < 0) {
+		dprintf("Failed to create %s: %s\n", trace_events_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+gtop_trace_events_counters(const struct gtop_data *gtop_d, const char *cat,
+			   uint64_t ts)
+{
+	for (uint32_t c = 0; c < gtop_d->num_perf_counters; c++) {
+		uint64_t events = stats_mux_scale(gtop_d->events_per_sample[c],
+						  gtop_d->time_enabled,
+						  gtop_d->time_running);
+
+		trace_event_counter(&trace_events, ts, cat, gtop_d->desc[c].name,
+				    "per_second", stats_rate(events, RATE_SECOND,
+							     gtop_d->time_enabled, 0));
+	}
+}
+
+/*
+ * a sample of each track at the start of the window, the value holding until
+ * the next one
+ */
+static void
+gtop_trace_events_window(struct gtop *gtop)
+{
+	struct gtop_clocks_governor governor = {};
+	uint64_t ts = get_ns_time() - gtop->window_ns;
+	char name[64];
+
+	gtop_trace_events_counters(gtop->perf_data[VIV_PROF_COUNTER_PART1], "part1", ts);
+	gtop_trace_events_counters(gtop->perf_data[VIV_PROF_COUNTER_PART2], "part2", ts);
+
+	for (size_t i = 0; i < NUM_VIV_IDLE_MODULES; i++) {
+		gtop_module_short_name(name, sizeof(name), i);
+		trace_event_counter(&trace_events, ts, "occupancy", name, "percent",
+				    gtop_module_busy_percent(&gtop->st, i) / 100.0);
+	}
+
+	for (size_t t = 0; t < NUM_DMA_TABLES; t++) {
+		struct dma_table *table = &dma_tables[t];
+		attach_gpu_state_to_dma_table(table, &gtop->st);
+
+		for (int i = 0; i < table->data_size; i++) {
+			snprintf(name, sizeof(name), "%s %s", table->name,
+				 table->data_names[i]);
+			trace_event_counter(&trace_events, ts, "dma", name, "percent",
+					    100.0 * table->data[i] / samples);
+		}
+	}
+
+	/* only what the driver reports */
+	gtop_get_clocks_governor(&governor);
+	if (governor.clock.gpu_core_0)
+		trace_event_counter(&trace_events, ts, "clock", "core0", "hz",
+				    governor.clock.gpu_core_0);
+	if (governor.clock.shader_core_0)
+		trace_event_counter(&trace_events, ts, "clock", "shader0", "hz",
+				    governor.clock.shader_core_0);
+	if (governor.clock.gpu_core_1)
+		trace_event_counter(&trace_events, ts, "clock", "core1", "hz",
+				    governor.clock.gpu_core_1);
+	if (governor.clock.shader_core_1)
+		trace_event_counter(&trace_events, ts, "clock", "shader1", "hz",
+				    governor.clock.shader_core_1);
+
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+	/* reading the PMUs resets them, the exporter has them then */
+	if (!FLAG_IS_SET(flags, FLAG_SERVE) && gtop->window_ns) {
+		unsigned int i, j;
+
+		gtop_start_pmus();
+
+		for_each_pmu(perf_pmu_ddrs, i) {
+			for_each_pmu(perf_pmu_ddrs[i].events, j) {
+				int fd = PMU_GET_FD(perf_pmu_ddrs, i, j);
+				if (fd > 0) {
+					const char *event_name = PMU_GET_EVENT_NAME(perf_pmu_ddrs, i, j);
+					uint64_t counter_val = perf_event_pmu_read(fd);
+
+					snprintf(name, sizeof(name), "%s %s",
+						 PMU_GET_TYPE_NAME(perf_pmu_ddrs, i),
+						 event_name);
+					trace_event_counter(&trace_events, ts, "ddr", name,
+							    "mbytes_per_second",
+							    gtop_pmu_mbytes(event_name, counter_val) *
+							    NSEC_PER_SEC / gtop->window_ns);
+					perf_event_pmu_reset(fd);
+				}
+			}
+		}
+	}
+#endif
+
+	if (trace_event_flush(&trace_events, false) < 0) {
+		dprintf("Failed to write %s: %s\n", trace_events_path, strerror(errno));
+		sig_recv = 1;
+	}
+}
+
+/*
+ * render the last window once, scrapes get it until the next one
+ */
+static void
+gtop_serve_window(struct perf_device *dev, struct gtop *gtop)
+{
+	struct gtop_buf *buf = &server.body;
+	struct trace_chip chip;
+	char model[16], revision[16], driver[48];
+
+	gtop_trace_chip(dev, &chip);
+	snprintf(model, sizeof(model), "GC%x", chip.model);
+	snprintf(revision, sizeof(revision), "%x", chip.revision);
+	snprintf(driver, sizeof(driver), "%d.%d.%d.%d", chip.drv_major,
+		 chip.drv_minor, chip.drv_patch, chip.drv_build);
+
+	serve_family(buf, "gputop_info", "gauge", "GPU and driver, always 1");
+	serve_sample(buf, "gputop_info", 1, "model", model, "revision", revision,
+		     "driver", driver, NULL);
+
+	serve_family(buf, "gputop_window_seconds", "gauge",
+		     "Length of the last sampling window");
+	serve_sample(buf, "gputop_window_seconds",
+		     (double) gtop->window_ns / NSEC_PER_SEC, NULL);
+
+	serve_family(buf, "gputop_scrapes_total", "counter",
+		     "Scrapes answered so far");
+	serve_sample(buf, "gputop_scrapes_total", server.nr_scrapes, NULL);
+
+	gtop_serve_clocks_governor(buf);
+	gtop_serve_gpu_state(buf, &gtop->st);
+	gtop_serve_clients(buf, dev);
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+	gtop_serve_perf_pmus(buf, gtop->window_ns);
+#endif
+
+	if (buf->truncated)
+		dprintf("Metrics truncated, buffer could not be grown\n");
+
+	serve_publish(&server);
+}
+
+/*
+ * counter group out of the trace columns, the descriptors being recorded too
+ */
+static struct gtop_data *
+gtop_replay_data_create(const struct trace_reader *reader,
+			enum vivante_profiler_type_counter type)
+{
+	enum trace_group group = (type == VIV_PROF_COUNTER_PART1) ?
+		TRACE_GROUP_PART1 : TRACE_GROUP_PART2;
+	const struct trace_column *columns = reader->columns;
+	struct gtop_data *gtop_d;
+	uint32_t nr = 0;
+
+	for (uint32_t c = 0; c < reader->hdr.nr_columns; c++)
+		if (columns[c].group == group && columns[c].id < TRACE_ID_TIME_ENABLED &&
+		    columns[c].id >= nr)
+			nr = columns[c].id + 1;
+
+	gtop_d = gtop_data_create(type, nr, 0, NULL);
+
+	for (uint32_t c = 0; c < reader->hdr.nr_columns; c++)
+		if (columns[c].group == group && columns[c].id < nr)
+			gtop_counter_desc_set(&gtop_d->desc[columns[c].id],
+					      columns[c].desc);
+
+	return gtop_d;
+}
+
+static void
+gtop_replay_counter(struct gtop_data *gtop_d, uint32_t id, uint64_t value)
+{
+	if (id == TRACE_ID_TIME_ENABLED) {
+		gtop_d->time_enabled = value;
+	} else if (id == TRACE_ID_TIME_RUNNING) {
+		gtop_d->time_running = value;
+	} else if (id < gtop_d->num_perf_counters) {
+		/* the window is the sample for MIN/MAX/AVERAGE */
+		gtop_d->events_per_sample[id] = value;
+
+		if (value > gtop_d->events_per_sample_max[id])
+			gtop_d->events_per_sample_max[id] = value;
+		if (!gtop_d->nr_average_samples ||
+		    value < gtop_d->events_per_sample_min[id])
+			gtop_d->events_per_sample_min[id] = value;
+		gtop_d->events_per_sample_average[id] += value;
+	}
+}
+
+/*
+ * restore a window as if we had just sampled it
+ */
+static void
+gtop_replay_row(const struct trace_reader *reader, struct gtop *gtop, uint32_t row)
+{
+	memset(&gtop->st, 0, sizeof(gtop->st));
+
+	for (uint32_t c = 0; c < reader->hdr.nr_columns; c++) {
+		const struct trace_column *col = &reader->columns[c];
+		uint64_t value = trace_value(reader, c, row);
+
+		switch (col->group) {
+		case TRACE_GROUP_WINDOW:
+			if (col->id == TRACE_COL_WINDOW)
+				gtop->window_ns = value;
+			else if (col->id == TRACE_COL_SAMPLES)
+				samples = value ? value : 1;
+			break;
+		case TRACE_GROUP_PART1:
+			gtop_replay_counter(gtop->perf_data[VIV_PROF_COUNTER_PART1],
+					    col->id, value);
+			break;
+		case TRACE_GROUP_PART2:
+			gtop_replay_counter(gtop->perf_data[VIV_PROF_COUNTER_PART2],
+					    col->id, value);
+			break;
+		case TRACE_GROUP_OCCUPANCY:
+			/* samples column comes first */
+			if (col->id < NUM_VIV_IDLE_MODULES)
+				gtop->st.viv_idle_states[col->id] =
+					vivante_idle_module_names[col->id].inv ?
+					samples - value : value;
+			break;
+		case TRACE_GROUP_DMA: {
+			uint32_t t = col->id >> 16;
+			int i = col->id & 0xffff;
+
+			if (t < NUM_DMA_TABLES) {
+				struct dma_table *table = &dma_tables[t];
+				attach_gpu_state_to_dma_table(table, &gtop->st);
+
+				if (i < table->data_size)
+					table->data[i] = value;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	for (uint8_t i = VIV_PROF_COUNTER_PART1; i <= VIV_PROF_COUNTER_PART2; i++)
+		gtop->perf_data[i]->nr_average_samples++;
+}
+
+/*
+ * feed the pages from a recording instead of the device, paced as it has been
+ * recorded unless the output is machine readable
+ */
+static int
+gtop_replay(void)
+{
+	struct trace_reader reader;
+	struct gtop gtop = {};
+	uint64_t last_ns = 0;
+	uint64_t from, to, b;
+	int err = 0;
+
+	if (trace_reader_open(&reader, replay_path) < 0) {
+		dprintf("Failed to open trace %s: %s\n", replay_path, strerror(errno));
+		return -1;
+	}
+
+	if (!FLAG_IS_SET(flags, FLAG_MODE)) {
+		SET_FLAG(flags, FLAG_MODE);
+		SET_FLAG(flags, FLAG_MULTIPLEX);
+		mode = MODE_PERF_COUNTER_PART1;
+	}
+
+	if (!gtop_is_counter_page() && mode != MODE_PERF_DMA &&
+	    mode != MODE_PERF_OCCUPANCY) {
+		dprintf("Only counter, dma and occupancy modes can be replayed\n");
+		trace_reader_close(&reader);
+		return -1;
+	}
+
+	gtop.perf_data = calloc(VIV_PROF_COUNTER_PART2 + 1, sizeof(struct gtop_data *));
+	if (!gtop.perf_data) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+	gtop.perf_data[VIV_PROF_COUNTER_PART1] =
+		gtop_replay_data_create(&reader, VIV_PROF_COUNTER_PART1);
+	gtop.perf_data[VIV_PROF_COUNTER_PART2] =
+		gtop_replay_data_create(&reader, VIV_PROF_COUNTER_PART2);
+
+	gtop_rate_resolve(&gtop);
+
+	if (output.format != OUTPUT_TEXT) {
+		output_header(&output);
+		buf_write(&output_buf, STDOUT_FILENO);
+	}
+
+	from = trace_time_ns(&reader, &replay_from, 0);
+	to = trace_time_ns(&reader, &replay_to, UINT64_MAX);
+
+	/* go straight to the first block of the range */
+	for (b = trace_reader_seek(&reader, from);
+	     b < reader.nr_blocks && reader.index[b].first_ns <= to; b++) {
+		if ((err = trace_reader_block(&reader, b)) < 0)
+			break;
+
+		for (uint32_t r = 0; r < reader.block->nr_rows && !sig_recv; r++) {
+			uint64_t ts = trace_value(&reader, TRACE_COL_TIMESTAMP, r);
+
+			if (ts < from || ts > to)
+				continue;
+
+			gtop_replay_row(&reader, &gtop, r);
+			gtop_rate_update(&gtop);
+
+			if (output.format != OUTPUT_TEXT) {
+				gtop_output_window(NULL, &gtop, ts);
+				continue;
+			}
+
+			if (last_ns && ts > last_ns)
+				gtop_wait(0, NULL, 0, ts - last_ns);
+			last_ns = ts;
+
+			gtop_history_window(&gtop, ~0U);
+			gtop_display_interactive(NULL, gtop);
+		}
+
+		if (sig_recv)
+			break;
+	}
+
+	if (err < 0)
+		dprintf("Failed to read trace %s: %s\n", replay_path, strerror(errno));
+
+	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART1]);
+	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART2]);
+	free(gtop.perf_data);
+
+	trace_reader_close(&reader);
+	return err;
+}
+
+static void
+gtop_display_interactive_help(void)
+{
+	int dummy;
+
+	fprintf(stdout, "%s\n", clear_screen);
+
+#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
+	fprintf(stdout, " Arrows (<-|->) to navigate between pages         | Use 0-6 to switch directly\n");
+#else
+	fprintf(stdout, " Arrows (<-|->) to navigate between pages         | Use 0-5 to switch directly\n");
+#endif
+	fprintf(stdout, " Use SPACE to specify a context (for PART1|PART2) | Use p to pause display\n");
+	fprintf(stdout, " Use x to show application's GPU id contexts      | Use q<ESC> to quit\n");
+	fprintf(stdout, " Use r to change between TIME/MIN/AVERAGE/MAX values of counters\n");
+	fprintf(stdout, " Use m to multiplex PART1 and PART2 counters on the same page\n");
+	fprintf(stdout, " Use u to change between counter values per window/second/frame\n");
+	fprintf(stdout, " Use g to show the history of the page (occupancy, DMA, DDR, counters)\n");
+	fprintf(stdout, " Use o to change what clients are sorted by       | PgUp/PgDn to scroll them\n");
+
+	fprintf(stdout, "\n Type any key to resume...");
+	fflush(NULL);
+
+	if (!gtop_wait_input())
+		return;
+
+	ssize_t nr = read(STDIN_FILENO, &dummy, sizeof(int));
+	(void) nr;
+
+}
+
+/*
+ * a key press, stdin being readable
+ */
+static long long
+gtop_read_key(void)
+{
+	unsigned char seq[sizeof(long long)];
+	long long buf = 0;
+	size_t len = 0;
+	ssize_t nread;
+
+	/*
+	 * Over serial an escape sequence comes a byte at a time, wait a bit
+	 * for the rest of it rather than taking it as ESC.
+	 */
+	do {
+		nread = read(STDIN_FILENO, seq + len, sizeof(seq) - len);
+		if (nread <= 0)
+			break;
+		len += nread;
+	} while (seq[0] == KB_ESCAPE && len < 3 &&
+		 gtop_wait(LOOP_INPUT, NULL, 0, KB_SEQ_NSECS) > 0);
+
+	/* nothing more to read from, don't poll it anymore */
+	if (nread == 0 && !len)
+		loop.input_fd = -1;
+
+	/* Page Up/Down and the like end with a ~ */
+	if (len == 4 && seq[3] == '~')
+		len = 3;
+
+	memcpy(&buf, seq, len);
+
+	/* only escape sequences take more than a byte, see top.h as for
+	 * serial we've encoded the arrow keys with just one byte */
+	if (buf >> 8 && len != 3)
+		buf &= 0x000000ff;
+
+	/* keys may bring up prompts, or another page */
+	screen_invalidate(&screen);
+
+	return buf;
+}
+
+/*
+ * what the daemon has to sample for the page being displayed
+ */
+static uint32_t
+gtop_connect_groups(void)
+{
+	if (gtop_is_counter_page())
+		return SUB_GROUP(TRACE_GROUP_PART1) | SUB_GROUP(TRACE_GROUP_PART2);
+	if (mode == MODE_PERF_DMA)
+		return SUB_GROUP(TRACE_GROUP_DMA);
+
+	return SUB_GROUP(TRACE_GROUP_OCCUPANCY);
+}
+
+/*
+ * the keys that make sense without a device, returns -1 to quit and 1 when the
+ * subscription has to change
+ */
+static int
+gtop_connect_keyboard(void)
+{
+	uint8_t prev = mode;
+
+	switch (gtop_read_key()) {
+	case KEY_H:
+	case KEY_QUESTION_MARK:
+		gtop_display_interactive_help();
+		break;
+	case KB_KEY_P:
+		paused = !paused;
+		break;
+	case KB_ESCAPE:
+	case KEY_Q:
+		return -1;
+	case KB_UP:
+	case KB_RIGHT:
+	case KB_RIGHT_SERIAL:
+	case KB_UP_SERIAL:
+		if (++mode > MODE_PERF_OCCUPANCY)
+			mode = MODE_PERF_COUNTER_PART1;
+		break;
+	case KB_DOWN:
+	case KB_LEFT:
+	case KB_LEFT_SERIAL:
+	case KB_DOWN_SERIAL:
+		if (--mode < MODE_PERF_COUNTER_PART1)
+			mode = MODE_PERF_OCCUPANCY;
+		break;
+	case KEY_2:
+		mode = MODE_PERF_COUNTER_PART1;
+		break;
+	case KEY_3:
+		mode = MODE_PERF_COUNTER_PART2;
+		break;
+	case KEY_4:
+		mode = MODE_PERF_DMA;
+		break;
+	case KEY_5:
+		mode = MODE_PERF_OCCUPANCY;
+		break;
+	case KEY_R:
+		if (++samples_mode > SAMPLES_MAX)
+			samples_mode = 0;
+		break;
+	case KEY_U:
+		rate.rate++;
+		if (rate.rate == RATE_FRAME && !rate.frame_type && !rate.marker_path)
+			rate.rate++;
+		if (rate.rate >= RATE_NO)
+			rate.rate = RATE_WINDOW;
+		break;
+	case KEY_M:
+		if (FLAG_IS_SET(flags, FLAG_MULTIPLEX))
+			REMOVE_FLAG(flags, FLAG_MULTIPLEX);
+		else
+			SET_FLAG(flags, FLAG_MULTIPLEX);
+		break;
+	case KEY_G:
+		if (FLAG_IS_SET(flags, FLAG_HISTORY))
+			REMOVE_FLAG(flags, FLAG_HISTORY);
+		else
+			SET_FLAG(flags, FLAG_HISTORY);
+		break;
+	default:
+		break;
+	}
 
-	/* go back into canonical mode */
-	tty_init(&tty_old);
+	return mode != prev;
 }
 
+/*
+ * thin client, the pages are fed by the windows a daemon publishes, the same
+ * way --replay feeds them from a recording
+ */
 static int
-gtop_compute(struct perf_device *dev, struct gtop *gtop)
+gtop_connect(bool batch)
 {
-	int s;
-	struct timespec interval = {};
-	int err = 0;
+	struct trace_reader reader;
+	struct sub_window win;
+	struct gtop gtop = {};
+	bool have_window = false;
+	int fd, err = 0;
 
-	interval.tv_sec = 0;
-	interval.tv_nsec = (USEC_PER_SEC / samples);
+	if (!FLAG_IS_SET(flags, FLAG_MODE)) {
+		SET_FLAG(flags, FLAG_MODE);
+		SET_FLAG(flags, FLAG_MULTIPLEX);
+		mode = MODE_PERF_COUNTER_PART1;
+	}
 
+	if (!gtop_is_counter_page() && mode != MODE_PERF_DMA &&
+	    mode != MODE_PERF_OCCUPANCY) {
+		dprintf("Only counter, dma and occupancy modes are published\n");
+		return -1;
+	}
 
-	/* bail early in case we just display clients */
-	if (mode == MODE_PERF_SHOW_CLIENTS &&
-	    curr_page == MODE_PERF_SHOW_CLIENTS)
-		return 0;
+	fd = sub_connect(connect_path, gtop_connect_groups(), selected_ctx, &reader);
+	if (fd < 0) {
+		dprintf("Failed to connect to %s: %s\n", connect_path, strerror(errno));
+		return -1;
+	}
 
-	/* clear every time gpu state so we get % values correctly */
-	memset(&gtop->st, 0, sizeof(struct vivante_gpu_state));
+	gtop.perf_data = calloc(VIV_PROF_COUNTER_PART2 + 1, sizeof(struct gtop_data *));
+	if (!gtop.perf_data) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+	gtop.perf_data[VIV_PROF_COUNTER_PART1] =
+		gtop_replay_data_create(&reader, VIV_PROF_COUNTER_PART1);
+	gtop.perf_data[VIV_PROF_COUNTER_PART2] =
+		gtop_replay_data_create(&reader, VIV_PROF_COUNTER_PART2);
 
-	if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS))
-		samples = 1;
+	gtop_rate_resolve(&gtop);
 
-	/* in batch mode we just run it once */
-	for (s = 0; s < samples; s++) {
+	if (output.format != OUTPUT_TEXT) {
+		output_header(&output);
+		buf_write(&output_buf, STDOUT_FILENO);
+	}
 
-		if (FLAG_IS_SET(flags, FLAG_MODE)) {
-			switch (mode) {
-			case MODE_PERF_COUNTER_PART1:
-				err = gtop_compute_perf(dev, gtop->perf_data[VIV_PROF_COUNTER_PART1]);
-				break;
-			case MODE_PERF_COUNTER_PART2:
-				err = gtop_compute_perf(dev, gtop->perf_data[VIV_PROF_COUNTER_PART2]);
-				break;
-			case MODE_PERF_DMA:
-				err = gtop_compute_mode_dma(dev, &gtop->st);
-				break;
-			case MODE_PERF_OCCUPANCY:
-				err = gtop_compute_mode_occupancy(dev, &gtop->st);
-				break;
-			case MODE_PERF_VID_MEM_USAGE:
-			case MODE_PERF_SHOW_CLIENTS:
-#if defined HAVE_DDR_PERF && (defined __linux__  || defined __ANDROID__ || defined ANDROID)
-			case MODE_PERF_DDR:
-				break;
-#else
-				break;
-#endif
+	while (!sig_recv) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		int rc, ev;
 
-			default:
-				dprintf("Invalid mode specified\n");
-				exit(EXIT_FAILURE);
-			}
-		} else {
-			switch (curr_page) {
-			case PAGE_COUNTER_PART1:
-				err = gtop_compute_perf(dev, gtop->perf_data[VIV_PROF_COUNTER_PART1]);
-				break;
-			case PAGE_COUNTER_PART2:
-				err = gtop_compute_perf(dev, gtop->perf_data[VIV_PROF_COUNTER_PART2]);
-				break;
-			case PAGE_DMA:
-				err = gtop_compute_mode_dma(dev, &gtop->st);
-				break;
-			case PAGE_OCCUPANCY:
-				err = gtop_compute_mode_occupancy(dev, &gtop->st);
-				break;
-			case MODE_PERF_VID_MEM_USAGE:
-			case MODE_PERF_SHOW_CLIENTS:
-#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
-			case MODE_PERF_DDR:
+		ev = gtop_wait(batch ? 0 : LOOP_INPUT, &pfd, 1, -1);
+		if (ev < 0) {
+			err = -1;
+			break;
+		}
+
+		if (ev & LOOP_INPUT) {
+			rc = gtop_connect_keyboard();
+			if (rc < 0)
 				break;
-#else
+			if (rc > 0 && sub_request(fd, gtop_connect_groups(),
+						  selected_ctx) < 0) {
+				err = -1;
 				break;
-#endif
-			default:
-				dprintf("Invalid page view specified!\n");
-				exit(EXIT_FAILURE);
 			}
+			/* show the new page right away, with what we have */
+			if (have_window && !paused)
+				gtop_display_interactive(NULL, gtop);
 		}
 
-		if (err < 0) {
-			return err;
-		}
-
-		if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS))
-			return 0;
-
-		nanosleep(&interval, NULL);
-	}
-	
-	return 0;
-}
+		if (!pfd.revents)
+			continue;
 
-static void
-gtop_scale_counters(struct gtop *gtop, uint64_t diff)
-{
-	if (FLAG_IS_SET(flags, FLAG_MODE)) {
-		if (mode == MODE_PERF_COUNTER_PART1)
-			gtop_scale_counters_by(gtop->perf_data[VIV_PROF_COUNTER_PART1], diff);
-		if (mode == MODE_PERF_COUNTER_PART2)
-			gtop_scale_counters_by(gtop->perf_data[VIV_PROF_COUNTER_PART2], diff);
-	} else {
-		if (curr_page == PAGE_COUNTER_PART1)
-			gtop_scale_counters_by(gtop->perf_data[VIV_PROF_COUNTER_PART1], diff);
-		if (curr_page == PAGE_COUNTER_PART2)
-			gtop_scale_counters_by(gtop->perf_data[VIV_PROF_COUNTER_PART2], diff);
-	}
-}
+		if (sub_read_window(fd, &reader, &win) < 0) {
+			err = -1;
+			break;
+		}
 
+		/* a window sampled for somebody else's context */
+		if (win.ctx != selected_ctx)
+			continue;
 
-static void
-gtop_display_interactive_help(void)
-{
-	int dummy;
+		gtop_replay_row(&reader, &gtop, 0);
+		gtop_rate_update(&gtop);
+		have_window = true;
 
-	fprintf(stdout, "%s\n", clear_screen);
+		if (output.format == OUTPUT_TEXT)
+			gtop_history_window(&gtop, gtop_connect_groups());
 
-#if defined HAVE_DDR_PERF && (defined __linux__ || defined __ANDROID__ || defined ANDROID)
-	fprintf(stdout, " Arrows (<-|->) to navigate between pages         | Use 0-6 to switch directly\n");
-#else
-	fprintf(stdout, " Arrows (<-|->) to navigate between pages         | Use 0-5 to switch directly\n");
-#endif
-	fprintf(stdout, " Use SPACE to specify a context (for PART1|PART2) | Use p to pause display\n");
-	fprintf(stdout, " Use x to show application's GPU id contexts      | Use q<ESC> to quit\n");
-	fprintf(stdout, " Use r to change between TIME/MIN/AVERAGE/MAX values of counters\n");
+		if (output.format != OUTPUT_TEXT)
+			gtop_output_window(NULL, &gtop,
+					   trace_value(&reader, TRACE_COL_TIMESTAMP, 0));
+		else if (!paused)
+			gtop_display_interactive(NULL, gtop);
+	}
 
-	fprintf(stdout, "\n Type any key to resume...");
-	fflush(NULL);
+	if (err < 0 && !sig_recv)
+		dprintf("Lost the connection to %s\n", connect_path);
 
-	ssize_t nr = read(STDIN_FILENO, &dummy, sizeof(int));
-	(void) nr;
+	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART1]);
+	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART2]);
+	free(gtop.perf_data);
 
+	sub_disconnect(fd, &reader);
+	return err;
 }
 
 static int
 gtop_check_keyboard(struct perf_device *dev)
 {
-	int rc;
 	long long buf;
 
-	rc = get_input_char();
-	if (rc == 0) {
-		return 0;
-	}
-
-	memset(&buf, 0, sizeof(buf));
-	ssize_t nread = -1;
-
-	/*
-	 * Over serial reading input chars is problematic as we need 3-bytes.
-	 */
-	do {
-		nread = read(STDIN_FILENO, &buf, sizeof(buf));
-	} while (nread == -1 || nread == 2 || nread == 0);
-
-	/* mask the other bytes as buf will be overwritten when the third byte
-	 * is read, see top.h as for serial we've encoded the arrow keys with
-	 * just one byte */
-	if (buf >> 8 && nread != 3)
-		buf &= 0x000000ff;
+	buf = gtop_read_key();
 
-	/* please compiler */
-	(void) nread;
+	if (picker.type != PICKER_NONE)
+		return gtop_picker_key(dev, buf);
 
 	switch (buf) {
 	case KEY_H:
@@ -1787,21 +4902,9 @@ gtop_check_keyboard(struct perf_device *dev)
 		return -1;
 		break;
 	case KB_SPACE:
-		/* select ctx */
-		selected_ctx = gtop_get_ctx_from_keyboard(dev);
-		/* change the context so we can retrieve counters */
-		if (selected_ctx) {
-			perf_context_set(selected_ctx, dev);
-		} else {
-			/* if context not OK wipe out */
-			if (selected_client && selected_client->name) {
-				free(selected_client->name);
-				memset(selected_client, 0, sizeof(*selected_client));
-				free(selected_client);
-				selected_client = NULL;
-			}
-		}
-		break;
+		/* select ctx, picked while sampling goes on */
+		gtop_picker_open_context(dev);
+		return 1;
 	case KB_UP:
 	case KB_RIGHT:
 	case KB_RIGHT_SERIAL:
@@ -1813,19 +4916,7 @@ gtop_check_keyboard(struct perf_device *dev)
 		if (curr_page == PAGE_COUNTER_PART1 ||
 		    curr_page == PAGE_COUNTER_PART2) {
 
-			if (selected_client && selected_client->name) {
-				if (!gtop_check_ctx_is_valid(selected_ctx)) {
-
-					free(selected_client->name);
-					memset(selected_client, 0, sizeof(*selected_client));
-					free(selected_client);
-					selected_client = NULL;
-
-					selected_ctx = 0;
-					/* use our own context in this case */
-					perf_context_set(selected_ctx, dev);
-				}
-			} else {
+			if (!gtop_context_ready(dev)) {
 				gtop_wait_for_keyboard("* Context not selected or feature not available, set context first before viewing context related pages or switch to other view mode!\n", true);
 				if (curr_page == PAGE_COUNTER_PART1)
 					curr_page += 2;
@@ -1845,19 +4936,7 @@ gtop_check_keyboard(struct perf_device *dev)
 
 		if (curr_page == PAGE_COUNTER_PART1 ||
 		    curr_page == PAGE_COUNTER_PART2) {
-			if (selected_client && selected_client->name) {
-				if (!gtop_check_ctx_is_valid(selected_ctx)) {
-
-					free(selected_client->name);
-					memset(selected_client, 0, sizeof(*selected_client));
-					free(selected_client);
-					selected_client = NULL;
-
-					selected_ctx = 0;
-					/* use our own context in this case */
-					perf_context_set(selected_ctx, dev);
-				}
-			} else {
+			if (!gtop_context_ready(dev)) {
 				gtop_wait_for_keyboard("** Context not selected or feature not available, set context first before viewing context related pages or switch to other view mode!\n", true);
 				if (curr_page == PAGE_COUNTER_PART2)
 					curr_page -= 2;
@@ -1874,19 +4953,7 @@ gtop_check_keyboard(struct perf_device *dev)
 		curr_page = PAGE_VID_MEM_USAGE;
 		break;
 	case KEY_2:
-		if (selected_client && selected_client->name) {
-			if (!gtop_check_ctx_is_valid(selected_ctx)) {
-
-				free(selected_client->name);
-				memset(selected_client, 0, sizeof(*selected_client));
-				free(selected_client);
-				selected_client = NULL;
-
-				selected_ctx = 0;
-				/* use our own context in this case */
-				perf_context_set(selected_ctx, dev);
-			}
-		} else {
+		if (!gtop_context_ready(dev)) {
 			gtop_wait_for_keyboard("! Context not selected or feature not available, set context first before viewing context related pages or switch to other view mode!\n", true);
 			break;
 		}
@@ -1894,19 +4961,7 @@ gtop_check_keyboard(struct perf_device *dev)
 		curr_page = PAGE_COUNTER_PART1;
 		break;
 	case KEY_3:
-		if (selected_client && selected_client->name) {
-			if (!gtop_check_ctx_is_valid(selected_ctx)) {
-
-				free(selected_client->name);
-				memset(selected_client, 0, sizeof(*selected_client));
-				free(selected_client);
-				selected_client = NULL;
-
-				selected_ctx = 0;
-				/* use our own context in this case */
-				perf_context_set(selected_ctx, dev);
-			}
-		} else {
+		if (!gtop_context_ready(dev)) {
 			gtop_wait_for_keyboard("!! Context not selected or feature not available, set context first before viewing context related pages or switch to other view mode!\n", true);
 			break;
 		}
@@ -1930,11 +4985,48 @@ gtop_check_keyboard(struct perf_device *dev)
 			SET_FLAG(flags, FLAG_SHOW_CONTEXTS);
 		break;
 	case KEY_S:
-		gtop_get_no_samples_from_keyboard();
-		break;
+		gtop_picker_open_samples();
+		return 1;
 	case KEY_R:
 		samples_mode++;
 		break;
+	case KEY_U:
+		rate.rate++;
+		/* per frame needs somewhere to get the frames from */
+		if (rate.rate == RATE_FRAME && !rate.frame_type && !rate.marker_path)
+			rate.rate++;
+		if (rate.rate >= RATE_NO)
+			rate.rate = RATE_WINDOW;
+		break;
+	case KEY_M:
+		if (FLAG_IS_SET(flags, FLAG_MULTIPLEX))
+			REMOVE_FLAG(flags, FLAG_MULTIPLEX);
+		else
+			SET_FLAG(flags, FLAG_MULTIPLEX);
+		break;
+	case KEY_G:
+		if (FLAG_IS_SET(flags, FLAG_HISTORY))
+			REMOVE_FLAG(flags, FLAG_HISTORY);
+		else
+			SET_FLAG(flags, FLAG_HISTORY);
+		break;
+	case KEY_O:
+		clients_table.sort = (clients_table.sort + 1) % ARRAY_SIZE(client_sort_keys);
+		clients_table.first = 0;
+		break;
+	case KB_PGUP:
+		gtop_clients_scroll(-1);
+		break;
+	case KB_PGDN:
+		gtop_clients_scroll(1);
+		break;
+	case KB_HOME:
+		clients_table.first = 0;
+		break;
+	case KB_END:
+		/* the last page, once we know how many there are */
+		clients_table.first = SIZE_MAX;
+		break;
 	default:
 		break;
 	}
@@ -1966,6 +5058,46 @@ gtop_check_keyboard(struct perf_device *dev)
 }
 
 
+/*
+ * until the next window is due, answering scrapes and subscribers meanwhile.
+ * A key, or a resize, ends it early. Returns -1 to quit, 1 if the page only
+ * has to be drawn again.
+ */
+static int
+gtop_wait_window(struct perf_device *dev, bool batch)
+{
+	bool daemon = FLAG_IS_SET(flags, FLAG_DAEMON);
+	bool serve = FLAG_IS_SET(flags, FLAG_SERVE);
+	unsigned events = LOOP_TICK | (batch ? 0 : LOOP_INPUT);
+	int ev;
+
+	do {
+		struct pollfd pfds[daemon ? subscribers.nr_clients + 1 : SERVE_MAX_CLIENTS + 1];
+		size_t nr = 0;
+
+		if (daemon)
+			nr = sub_server_pollfds(&subscribers, pfds);
+		else if (serve)
+			nr = serve_pollfds(&server, pfds);
+
+		ev = gtop_wait(events, pfds, nr, -1);
+		if (ev < 0 || sig_recv)
+			return -1;
+
+		if (ev & LOOP_FDS) {
+			if (daemon)
+				sub_server_dispatch(&subscribers, pfds);
+			else
+				serve_dispatch(&server, pfds);
+		}
+
+		if (ev & LOOP_INPUT)
+			return gtop_check_keyboard(dev);
+	} while (!(ev & (LOOP_TICK | LOOP_RESIZE)));
+
+	return 0;
+}
+
 /*
  * retrieve PART1 and PART2
  */
@@ -1973,26 +5105,44 @@ static void
 gtop_retrieve_perf_counters(struct perf_device *dev, bool batch)
 {
 	struct gtop gtop = {};
+	int rc;
 
 	uint32_t num_perf_counters_part1;
 	uint32_t num_perf_counters_part2;
 
-	uint64_t begin_time, end_time, diff;
-
 	num_perf_counters_part1 = perf_get_num_counters(VIV_PROF_COUNTER_PART1, dev);
 	num_perf_counters_part2 = perf_get_num_counters(VIV_PROF_COUNTER_PART2, dev);
 
 	gtop.perf_data = calloc(2, sizeof(struct gtop_data));
 
 	gtop.perf_data[VIV_PROF_COUNTER_PART1] = 
-		gtop_data_create(VIV_PROF_COUNTER_PART1, num_perf_counters_part1, 0);
+		gtop_data_create(VIV_PROF_COUNTER_PART1, num_perf_counters_part1, 0, dev);
 	gtop.perf_data[VIV_PROF_COUNTER_PART2] =
-		gtop_data_create(VIV_PROF_COUNTER_PART2, num_perf_counters_part2, 0);
-
+		gtop_data_create(VIV_PROF_COUNTER_PART2, num_perf_counters_part2, 0, dev);
+
+	gtop_rate_resolve(&gtop);
+	gtop.idle_reg_addr = gtop_get_idle_reg_addr(dev);
+
+	if (FLAG_IS_SET(flags, FLAG_RECORD))
+		gtop_trace_open(dev, &gtop);
+	if (FLAG_IS_SET(flags, FLAG_DAEMON))
+		gtop_daemon_open(dev, &gtop);
+	if (FLAG_IS_SET(flags, FLAG_SHM))
+		gtop_shm_open(dev, &gtop);
+	if (FLAG_IS_SET(flags, FLAG_TRACE_EVENTS))
+		gtop_trace_events_open(dev);
+	if (FLAG_IS_SET(flags, FLAG_FLIGHT))
+		gtop_flight_open(dev, &gtop);
+
+	if (output.format != OUTPUT_TEXT) {
+		output_header(&output);
+		buf_write(&output_buf, STDOUT_FILENO);
+	} else if (!FLAG_IS_SET(flags, FLAG_SERVE) && !FLAG_IS_SET(flags, FLAG_DAEMON)) {
+		fprintf(stdout, "%s", clear_screen);
+	}
 
-	fprintf(stdout, "%s", clear_screen);
+	loop_tick(&loop, refresh.tv_sec * NSEC_PER_SEC + refresh.tv_nsec);
 
-	begin_time = get_ns_time();
 	while (1) {
 		if (sig_recv)
 			goto out;
@@ -2001,57 +5151,112 @@ gtop_retrieve_perf_counters(struct perf_device *dev, bool batch)
 			goto show_hw_counters;
 		}
 
+		if (FLAG_IS_SET(flags, FLAG_DAEMON))
+			gtop_daemon_next(dev);
+		else if (FLAG_IS_SET(flags, FLAG_FOLLOW))
+			gtop_follow(dev);
+
 		/* clear the samples before sampling */
 		for (uint8_t i = 1; i < 3; i++)
 			gtop_data_clear_samples(gtop.perf_data[i]);
 
 		/* retrieve the counters, or read registers */
 		gtop_compute(dev, &gtop);
+		gtop_rate_update(&gtop);
 
-show_hw_counters:
-		end_time = get_ns_time();
-		diff = end_time - begin_time;
+		if (output.format == OUTPUT_TEXT && !batch)
+			gtop_history_window(&gtop, gtop_plan_groups(&gtop));
 
-		if (!paused) {
-			gtop_scale_counters(&gtop, diff);
-		}
+		/* markers are consumed when filling it, fill it once */
+		if (gtop_trace_wanted())
+			gtop_trace_fill(dev, &gtop, ~0U);
 
-		/* figure out if we got anything from keyboard, or if we're
-		 * running batched */
-		if (batch) {
-			delay();
-		} else {
-			if (gtop_check_keyboard(dev) < 0)
-				goto out;
+		if (FLAG_IS_SET(flags, FLAG_RECORD))
+			gtop_trace_record();
+
+		if (FLAG_IS_SET(flags, FLAG_SHM))
+			shm_writer_publish(&shm_writer, trace_row);
+
+		if (FLAG_IS_SET(flags, FLAG_FLIGHT))
+			gtop_flight_window();
+
+		if (FLAG_IS_SET(flags, FLAG_TRACE_EVENTS))
+			gtop_trace_events_window(&gtop);
+
+		if (FLAG_IS_SET(flags, FLAG_SERVE))
+			gtop_serve_window(dev, &gtop);
+
+		if (FLAG_IS_SET(flags, FLAG_DAEMON) && daemon_groups) {
+			gtop_trace_fill(dev, &gtop, daemon_groups);
+			sub_server_publish(&subscribers, selected_ctx, trace_row);
 		}
 
+show_hw_counters:
+		/* until the next window, or a key when not batched */
+		rc = gtop_wait_window(dev, batch);
+		if (rc < 0)
+			goto out;
 
-		gtop_display_interactive(dev, gtop);
+		if (output.format != OUTPUT_TEXT)
+			gtop_output_window(dev, &gtop, get_realtime_ns());
+		else if (!FLAG_IS_SET(flags, FLAG_SERVE) && !FLAG_IS_SET(flags, FLAG_DAEMON))
+			gtop_display_interactive(dev, gtop);
 
 		if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_CONTEXTS))
 			goto out;
 
-		begin_time = end_time;
-
+		/* only the picker changed, the window goes on */
+		if (rc > 0)
+			goto show_hw_counters;
 	}
 
 out:
+	if (FLAG_IS_SET(flags, FLAG_RECORD))
+		gtop_trace_close();
+	if (FLAG_IS_SET(flags, FLAG_SHM))
+		shm_writer_close(&shm_writer);
+	if (FLAG_IS_SET(flags, FLAG_FLIGHT))
+		flight_close(&flight);
+	if (FLAG_IS_SET(flags, FLAG_TRACE_EVENTS) &&
+	    trace_event_close(&trace_events) < 0)
+		dprintf("Failed to write %s: %s\n", trace_events_path, strerror(errno));
+	if (FLAG_IS_SET(flags, FLAG_DAEMON))
+		sub_server_close(&subscribers);
+	free(trace_row);
+	trace_row = NULL;
+
 	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART1]);
 	gtop_data_destroy(gtop.perf_data[VIV_PROF_COUNTER_PART2]);
 
+	free(gtop.idle_words);
+	free(gtop.rotate.slot_events);
+	procs_free(&procs);
+
 	free(gtop.perf_data);
 }
 
+static void
+gtop_output_init(void)
+{
+	if (buf_init(&output_buf, OUTPUT_BUF_SIZE) < 0) {
+		dprintf("malloc?\n");
+		exit(EXIT_FAILURE);
+	}
+	output.buf = &output_buf;
+}
+
 static
 void help(void)
 {
 	dprintf("Usage:\n");
-	dprintf("  %s (GIT: %s, V: %s) [-m mode] [-c <ctx>] [-x]\n", prg_name, git_version, version);
+	dprintf("  %s (GIT: %s, V: %s) [-m mode] [-c <ctx>|-p <pid>|-n <name>] [-x]\n", prg_name, git_version, version);
+	dprintf("  %s report [--from <secs>] [--to <secs>] [--rows] [--merge] <trace>...\n", prg_name);
 	dprintf("\n");
 	dprintf("  -m <mode>\n");
 	dprintf("                mem         Show memory usage of clients attached to GPU\n");
 	dprintf("                counter_1   Show counters part 1\n");
 	dprintf("                counter_2   Show counters part 2\n");
+	dprintf("                counters    Show counters part 1 and part 2 (multiplexed)\n");
 	dprintf("                occupancy   Show occupancy (non-idle) states of modules\n");
 	dprintf("                dma         DMA engine states\n");
 	dprintf("                vidmem	    Additional video memory information\n");
@@ -2059,8 +5264,46 @@ void help(void)
 	dprintf("                ddr	    Show Kernel PMUs related to memory bandwidth\n");
 #endif
 	dprintf("  -c <ctx>      Specify context to track\n");
+	dprintf("  -p <pid>, -n <name>\n");
+	dprintf("                Track the newest context of a process, attached again\n");
+	dprintf("                when it gets a new one or, by name, when it restarts\n");
+	dprintf("  -M            Multiplex counters part 1 and part 2\n");
+	dprintf("  -u <unit>     Display counters per: window, sec, frame:<counter> or\n");
+	dprintf("                frame:<file> with the number of frames rendered\n");
 	dprintf("  -b            Show batch (instantaneous of requested mode)\n");
 	dprintf("  -f            Read counters in batch mode\n");
+	dprintf("  -F, --format <fmt>\n");
+	dprintf("                text, csv or jsonl, one record per window (implies -f)\n");
+	dprintf("  -d, --delay <msec>\n");
+	dprintf("                Refresh/window interval, defaults to %d msec\n",
+			DELAY_SECS * 1000 + DELAY_NSECS / 1000000);
+	dprintf("  --record <file>\n");
+	dprintf("                Record every window (counters, occupancy, DMA) to file\n");
+	dprintf("  --replay <file>\n");
+	dprintf("                Display a recording instead of reading the GPU\n");
+	dprintf("  --from <secs>, --to <secs>\n");
+	dprintf("                Replay only part of a recording, seconds since its start\n");
+	dprintf("                or since the Epoch when prefixed with @\n");
+	dprintf("  --serve unix:<path>|<host>:<port>\n");
+	dprintf("                Serve the latest window as Prometheus metrics\n");
+	dprintf("  --daemon <socket>\n");
+	dprintf("                Own the profiler, publish windows to subscribers\n");
+	dprintf("  --connect <socket>\n");
+	dprintf("                Display the windows of a daemon (counters, dma, occupancy)\n");
+	dprintf("  --shm <name>\n");
+	dprintf("                Publish every window in shared memory, see gputop_shm.h\n");
+	dprintf("  --trace-events <file>\n");
+	dprintf("                Write counter tracks for Perfetto or chrome://tracing\n");
+	dprintf("  --flight <file> [--flight-length <secs>] [--trigger <expr>]...\n");
+	dprintf("                Keep the last 60 seconds, dump them to <file>.<n> on\n");
+	dprintf("                SIGUSR1 or when an expression like 'occupancy.PE > 95%% for 2s'\n");
+	dprintf("                holds\n");
+	dprintf("  --history [--history-style blocks|braille|ascii]\n");
+	dprintf("                Draw the last windows of the page as sparklines\n");
+	dprintf("  --rotate      Read the counters of every context in turn, of the\n");
+	dprintf("                process given with -p/-n or of all, summed per process\n");
+	dprintf("  --sort total|res|cont|virt|non-pgd|pid\n");
+	dprintf("                What the clients are sorted by, total by default\n");
 	dprintf("  -x            Display contexts in memory viewing page\n");
 	dprintf("  -i		Ignore errors when opening a connection with the driver\n");
 	dprintf("  -v            Show version\n");
@@ -2081,9 +5324,34 @@ show_version(void)
 static void
 parse_args(int argc, char **argv)
 {
+	static const struct option long_options[] = {
+		{ "format",	required_argument,	NULL, 'F' },
+		{ "delay",	required_argument,	NULL, 'd' },
+		{ "record",	required_argument,	NULL, OPT_RECORD },
+		{ "replay",	required_argument,	NULL, OPT_REPLAY },
+		{ "from",	required_argument,	NULL, OPT_FROM },
+		{ "to",		required_argument,	NULL, OPT_TO },
+		{ "serve",	required_argument,	NULL, OPT_SERVE },
+		{ "daemon",	required_argument,	NULL, OPT_DAEMON },
+		{ "connect",	required_argument,	NULL, OPT_CONNECT },
+		{ "shm",	required_argument,	NULL, OPT_SHM },
+		{ "trace-events", required_argument,	NULL, OPT_TRACE_EVENTS },
+		{ "flight",	required_argument,	NULL, OPT_FLIGHT },
+		{ "flight-length", required_argument,	NULL, OPT_FLIGHT_LENGTH },
+		{ "trigger",	required_argument,	NULL, OPT_TRIGGER },
+		{ "history",	no_argument,		NULL, OPT_HISTORY },
+		{ "history-style", required_argument,	NULL, OPT_HISTORY_STYLE },
+		{ "sort",	required_argument,	NULL, OPT_SORT },
+		{ "rotate",	no_argument,		NULL, OPT_ROTATE },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "version",	no_argument,		NULL, 'v' },
+		{ NULL,		0,			NULL, 0 },
+	};
+	unsigned long msecs;
+	char *end;
 	int c;
 
-	while ((c = getopt(argc, argv, "m:hc:xbvfi")) != -1) {
+	while ((c = getopt_long(argc, argv, "m:hc:p:n:xbvfiMu:F:d:", long_options, NULL)) != -1) {
 		switch (c) {
 		case 'm':
 			SET_FLAG(flags, FLAG_MODE);
@@ -2094,6 +5362,9 @@ parse_args(int argc, char **argv)
 				mode = MODE_PERF_COUNTER_PART1;
 			} else if (!strncmp(optarg, "counter_2", strlen("counter_2"))) {
 				mode = MODE_PERF_COUNTER_PART2;
+			} else if (!strncmp(optarg, "counters", strlen("counters"))) {
+				mode = MODE_PERF_COUNTER_PART1;
+				SET_FLAG(flags, FLAG_MULTIPLEX);
 			} else if (!strncmp(optarg, "occupancy", strlen("occupancy"))) {
 				mode = MODE_PERF_OCCUPANCY;
 			} else if (!strncmp(optarg, "dma", strlen("dma"))) {
@@ -2116,6 +5387,19 @@ parse_args(int argc, char **argv)
 			SET_FLAG(flags, FLAG_CONTEXT);
 			selected_ctx = atoi(optarg);
 			break;
+		case 'p':
+			SET_FLAG(flags, FLAG_FOLLOW);
+			follow.pid = strtoul(optarg, &end, 10);
+			if (*end || !follow.pid) {
+				dprintf("Invalid PID %s\n", optarg);
+				help();
+			}
+			follow.name = NULL;
+			break;
+		case 'n':
+			SET_FLAG(flags, FLAG_FOLLOW);
+			follow.name = optarg;
+			break;
 		case 'b':
 			SET_FLAG(flags, FLAG_SHOW_BATCH_CONTEXTS);
 			break;
@@ -2128,6 +5412,131 @@ parse_args(int argc, char **argv)
 		case 'i':
 			SET_FLAG(flags, FLAG_IGNORE_START_ERRORS);
 			break;
+		case 'M':
+			SET_FLAG(flags, FLAG_MULTIPLEX);
+			break;
+		case 'u':
+			if (!strncmp(optarg, "window", strlen("window"))) {
+				rate.rate = RATE_WINDOW;
+			} else if (!strncmp(optarg, "sec", strlen("sec"))) {
+				rate.rate = RATE_SECOND;
+			} else if (!strncmp(optarg, "frame:", strlen("frame:"))) {
+				const char *src = optarg + strlen("frame:");
+
+				rate.rate = RATE_FRAME;
+				/* paths are marker files, otherwise a counter name */
+				if (*src == '/')
+					rate.marker_path = src;
+				else
+					rate.frame_name = src;
+			} else {
+				dprintf("Unknown unit %s\n", optarg);
+				help();
+			}
+			break;
+		case 'F':
+			if (output_parse_format(optarg, &output.format) < 0) {
+				dprintf("Unknown format %s\n", optarg);
+				help();
+			}
+			/* machine readable output makes sense only in batch mode */
+			if (output.format != OUTPUT_TEXT)
+				SET_FLAG(flags, FLAG_SHOW_BATCH_PERF);
+			break;
+		case 'd':
+			msecs = strtoul(optarg, &end, 10);
+			if (*end || msecs < DELAY_MIN_MSECS) {
+				dprintf("Invalid delay %s, minimum is %d msec\n",
+						optarg, DELAY_MIN_MSECS);
+				help();
+			}
+			refresh.tv_sec = msecs / 1000;
+			refresh.tv_nsec = (msecs % 1000) * 1000000;
+			break;
+		case OPT_RECORD:
+			SET_FLAG(flags, FLAG_RECORD);
+			record_path = optarg;
+			break;
+		case OPT_REPLAY:
+			replay_path = optarg;
+			break;
+		case OPT_SERVE:
+			SET_FLAG(flags, FLAG_SERVE);
+			/* no terminal, runs as a daemon */
+			SET_FLAG(flags, FLAG_SHOW_BATCH_PERF);
+			serve_address = optarg;
+			break;
+		case OPT_DAEMON:
+			SET_FLAG(flags, FLAG_DAEMON);
+			SET_FLAG(flags, FLAG_SHOW_BATCH_PERF);
+			daemon_path = optarg;
+			break;
+		case OPT_CONNECT:
+			connect_path = optarg;
+			break;
+		case OPT_SHM:
+			SET_FLAG(flags, FLAG_SHM);
+			shm_name = optarg;
+			break;
+		case OPT_TRACE_EVENTS:
+			SET_FLAG(flags, FLAG_TRACE_EVENTS);
+			trace_events_path = optarg;
+			break;
+		case OPT_FLIGHT:
+			SET_FLAG(flags, FLAG_FLIGHT);
+			flight_path = optarg;
+			break;
+		case OPT_FLIGHT_LENGTH: {
+			struct trace_time length;
+
+			if (trace_parse_time(optarg, &length) < 0 || length.absolute ||
+			    !length.ns) {
+				dprintf("Invalid length %s\n", optarg);
+				help();
+			}
+			flight_length_ns = length.ns;
+			break;
+		}
+		case OPT_TRIGGER:
+			if (nr_flight_triggers == FLIGHT_MAX_TRIGGERS) {
+				dprintf("At most %d triggers\n", FLIGHT_MAX_TRIGGERS);
+				help();
+			}
+			flight_triggers[nr_flight_triggers++] = optarg;
+			break;
+		case OPT_HISTORY:
+			SET_FLAG(flags, FLAG_HISTORY);
+			break;
+		case OPT_ROTATE:
+			SET_FLAG(flags, FLAG_ROTATE);
+			break;
+		case OPT_SORT:
+			for (clients_table.sort = 0;
+			     clients_table.sort < ARRAY_SIZE(client_sort_keys);
+			     clients_table.sort++) {
+				if (!strcmp(optarg, client_sort_keys[clients_table.sort].name))
+					break;
+			}
+			if (clients_table.sort == ARRAY_SIZE(client_sort_keys)) {
+				dprintf("Invalid sort key %s\n", optarg);
+				help();
+			}
+			break;
+		case OPT_HISTORY_STYLE:
+			history.style = history_style_parse(optarg);
+			if (history.style < 0) {
+				dprintf("Invalid history style %s\n", optarg);
+				help();
+			}
+			break;
+		case OPT_FROM:
+		case OPT_TO:
+			if (trace_parse_time(optarg, c == OPT_FROM ?
+					     &replay_from : &replay_to) < 0) {
+				dprintf("Invalid time %s\n", optarg);
+				help();
+			}
+			break;
 		case 'h':
 		default:
 			help();
@@ -2136,23 +5545,23 @@ parse_args(int argc, char **argv)
 }
 
 static void
-sigint_handler(int sig, siginfo_t *si, void *unused)
+sigflight_handler(int sig, siginfo_t *si, void *unused)
 {
 	(void) sig;
 	(void) si;
 	(void) unused;
 
-	sig_recv  = 1;
+	flight_requested = 1;
 }
 
 static void
-sigresize_handler(int sig, siginfo_t *si, void *unused)
+sigmarker_handler(int sig, siginfo_t *si, void *unused)
 {
 	(void) sig;
 	(void) si;
 	(void) unused;
 
-	resized ^= 1;
+	trace_marker = 1;
 }
 
 static void
@@ -2162,19 +5571,18 @@ install_sighandler(void)
 	sa.sa_flags = SA_SIGINFO;
 	sigemptyset(&sa.sa_mask);
 
-	sa.sa_sigaction = sigint_handler;
-
-	if (sigaction(SIGTERM, &sa, NULL) == -1)
-		exit(EXIT_FAILURE);
-	if (sigaction(SIGINT, &sa, NULL) == -1)
+	/* SIGINT, SIGTERM and SIGWINCH come through the loop */
+	if (loop_init(&loop, STDIN_FILENO) < 0)
 		exit(EXIT_FAILURE);
 
-	sa.sa_flags = SA_SIGINFO;
-	sigemptyset(&sa.sa_mask);
+	/* mark the next recorded window */
+	sa.sa_sigaction = sigmarker_handler;
+	if (sigaction(SIGUSR2, &sa, NULL) == -1)
+		exit(EXIT_FAILURE);
 
-	/* install resize signal handler */
-	sa.sa_sigaction = sigresize_handler;
-	if (sigaction(SIGWINCH, &sa, NULL) == -1)
+	/* dump the flight recorder */
+	sa.sa_sigaction = sigflight_handler;
+	if (sigaction(SIGUSR1, &sa, NULL) == -1)
 		exit(EXIT_FAILURE);
 
 }
@@ -2186,14 +5594,63 @@ int main(int argc, char *argv[])
 	bool batch = false;
 
 
+	/* offline, works only on recordings */
+	if (argc > 1 && !strcmp(argv[1], "report"))
+		return report_main(argc - 1, argv + 1);
+
 	memset(&gtop_info, 0, sizeof(struct gtop_hw_drv_info));
 	perf_version = perf_get_library_version();
 
 	parse_args(argc, argv);
 	install_sighandler();
 
+	if (output.format != OUTPUT_TEXT)
+		gtop_output_init();
+	gtop_screen_init();
+
+	if (replay_path) {
+		err = gtop_replay();
+		buf_free(&output_buf);
+		screen_free(&screen);
+		gtop_history_free();
+		free(clients_table.rows);
+		gtop_picker_close();
+		free(picker.entries);
+		loop_close(&loop);
+		debugfs_ctx_index_free(&ctx_index);
+		return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (nr_flight_triggers && !FLAG_IS_SET(flags, FLAG_FLIGHT)) {
+		fprintf(stderr, "--trigger needs --flight\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (FLAG_IS_SET(flags, FLAG_DAEMON) &&
+	    (FLAG_IS_SET(flags, FLAG_RECORD) || FLAG_IS_SET(flags, FLAG_SERVE) ||
+	     FLAG_IS_SET(flags, FLAG_SHM) || FLAG_IS_SET(flags, FLAG_TRACE_EVENTS) ||
+	     FLAG_IS_SET(flags, FLAG_FLIGHT))) {
+		fprintf(stderr, "--daemon can not be used with --record, --serve, --shm, "
+				"--trace-events or --flight\n");
+		exit(EXIT_FAILURE);
+	}
+
 	tty_init(&tty_old);
 
+	if (connect_path) {
+		err = gtop_connect(FLAG_IS_SET(flags, FLAG_SHOW_BATCH_PERF));
+		tty_reset(&tty_old);
+		buf_free(&output_buf);
+		screen_free(&screen);
+		gtop_history_free();
+		free(clients_table.rows);
+		gtop_picker_close();
+		free(picker.entries);
+		loop_close(&loop);
+		debugfs_ctx_index_free(&ctx_index);
+		return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	dev = perf_init(&vivante_ops);
 	if (!dev) {
 		fprintf(stderr, "perf_init()! failed\n");
@@ -2257,8 +5714,34 @@ int main(int argc, char *argv[])
 	if (FLAG_IS_SET(flags, FLAG_SHOW_BATCH_PERF))
 		batch = true;
 
+	if (FLAG_IS_SET(flags, FLAG_SERVE)) {
+		err = serve_open(&server, serve_address);
+		if (err < 0) {
+			if (err == -2)
+				fprintf(stderr, "Invalid address %s, use unix:<path> "
+						"or <host>:<port>\n", serve_address);
+			else
+				fprintf(stderr, "Failed to listen on %s: %s\n",
+						serve_address, strerror(errno));
+			tty_reset(&tty_old);
+			perf_exit(dev);
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	gtop_retrieve_perf_counters(dev, batch);
 
+	buf_free(&output_buf);
+	screen_free(&screen);
+	gtop_history_free();
+	free(clients_table.rows);
+	gtop_picker_close();
+	free(picker.entries);
+	loop_close(&loop);
+	debugfs_ctx_index_free(&ctx_index);
+	if (FLAG_IS_SET(flags, FLAG_SERVE))
+		serve_close(&server);
+
 	gtop_free_gtop_info(dev, &gtop_info);
 
    if (profiler_state.enabled)
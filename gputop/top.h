@@ -53,6 +53,9 @@
 
 #define KB_KEY_P	0x00000070
 
+/* how long the rest of an escape sequence takes to come, over serial */
+#define KB_SEQ_NSECS	(50 * 1000000LL)
+
 #define KEY_0		0x00000030
 #define KEY_1		0x00000031
 #define KEY_2		0x00000032
@@ -70,7 +73,12 @@
 
 #define KEY_X		0x00000078
 #define KEY_S		0x00000073
+#define KEY_M		0x0000006d
+#define KEY_U		0x00000075
+#define KEY_G		0x00000067
+#define KEY_O		0x0000006f
 
+/* these come with a trailing ~, which is dropped when read */
 #define KB_PGUP		0x00355B1B
 #define KB_PGDN		0x00365B1B
 
@@ -87,6 +95,32 @@
 #define DELAY_SECS	1
 #define DELAY_NSECS	0
 
+/* shortest refresh interval accepted by -d */
+#define DELAY_MIN_MSECS	10
+
+/* preallocated for a whole window of machine readable output */
+#define OUTPUT_BUF_SIZE	(64 * 1024)
+
+/* long options without a short one */
+enum long_opts {
+	OPT_RECORD = 0x100,
+	OPT_REPLAY,
+	OPT_FROM,
+	OPT_TO,
+	OPT_SERVE,
+	OPT_DAEMON,
+	OPT_CONNECT,
+	OPT_SHM,
+	OPT_TRACE_EVENTS,
+	OPT_FLIGHT,
+	OPT_FLIGHT_LENGTH,
+	OPT_TRIGGER,
+	OPT_HISTORY,
+	OPT_HISTORY_STYLE,
+	OPT_SORT,
+	OPT_ROTATE,
+};
+
 /* do note these are encoded for VSI */
 enum err_code {
         ERR_NO_ERROR = 0,
@@ -148,6 +182,16 @@ enum flags_type {
 	FLAG_SHOW_BATCH_CONTEXTS = 7,
 	FLAG_SHOW_BATCH_PERF = 8,
 	FLAG_IGNORE_START_ERRORS,
+	FLAG_MULTIPLEX,
+	FLAG_RECORD,
+	FLAG_SERVE,
+	FLAG_DAEMON,
+	FLAG_SHM,
+	FLAG_TRACE_EVENTS,
+	FLAG_FLIGHT,
+	FLAG_HISTORY,
+	FLAG_FOLLOW,
+	FLAG_ROTATE,
 };
 
 /* 
@@ -164,6 +208,30 @@ struct profiler_state {
 struct p_page {
 	uint8_t page_no;
 	const char *page_desc;
+	/* used for machine readable output */
+	const char *page_name;
+};
+
+/*
+ * Counter descriptors are resolved once per counter group when creating the
+ * group, rendering uses only these.
+ */
+#define COUNTER_NAME_LEN	64
+#define COUNTER_DESC_LEN	128
+#define COUNTER_DESC_WIDTH	50
+
+struct gtop_counter_desc {
+	/* lower-case, machine friendly name derived from the description */
+	char name[COUNTER_NAME_LEN];
+	/* description as retrieved from the library */
+	char desc[COUNTER_DESC_LEN];
+	/* what the counter counts: events, cycles or bytes */
+	const char *unit;
+
+	/* description truncated and padded to COUNTER_DESC_WIDTH */
+	char display[COUNTER_DESC_WIDTH + 1];
+	/* how many chars of display are not padding */
+	uint8_t width;
 };
 
 struct gtop_data {
@@ -173,6 +241,8 @@ struct gtop_data {
 	uint32_t num_perf_derived_counters;
 	uint64_t total_num_perf_counters;
 
+	struct gtop_counter_desc *desc;
+
 	uint32_t *counter_data;
 	uint32_t *counter_data_last;
 
@@ -180,14 +250,131 @@ struct gtop_data {
 
 	uint64_t *events_per_sample_max;
 	uint64_t *events_per_sample_min;
+	/* sum of the values read, averaged only when displayed */
 	uint64_t *events_per_sample_average;
+	uint64_t nr_average_samples;
 
 	bool *reset_after_read;
+
+	/* samples accumulated in the current window */
+	uint32_t nr_samples;
+
+	/*
+	 * time (ns) of the window and time the group was actually read,
+	 * they differ only when multiplexing PART1 and PART2
+	 */
+	uint64_t time_enabled;
+	uint64_t time_running;
+	/* when we last read the counters */
+	uint64_t last_read_ns;
+};
+
+/*
+ * Only one of the counter groups can be read at one time so when
+ * multiplexing we alternate between PART1 and PART2 in slots of samples.
+ */
+#define MUX_SLOTS	10
+
+struct gtop_mux {
+	/* group currently being read */
+	enum vivante_profiler_type_counter active;
+};
+
+/*
+ * Counters count for one context at a time. Rotating gives each context a slot
+ * of samples, as many as fit in the window, the next window going on with the
+ * ones left.
+ */
+struct gtop_rotate {
+	/* group being rotated, counters of the other one are not read */
+	enum vivante_profiler_type_counter type;
+	int slot_samples;
+
+	/* context of the current slot, NULL if none yet */
+	struct procs_ctx *curr;
+	/* what the group had gathered when the slot started */
+	uint64_t *slot_events;
+	uint64_t slot_running;
+};
+
+/*
+ * How counter values are normalized when displayed. Frames are either
+ * the events of one of the counters or read from a marker file holding the
+ * number of frames rendered so far.
+ */
+struct gtop_rate {
+	enum stats_rate rate;
+
+	/* counter used as frame counter, frame_type is 0 if not used */
+	const char *frame_name;
+	enum vivante_profiler_type_counter frame_type;
+	uint32_t frame_id;
+
+	/* or the marker file */
+	const char *marker_path;
+	uint64_t marker_last;
+
+	/* frames in the current window */
+	uint64_t frames;
+};
+
+/*
+ * The sampling plan: what needs to be read for every sample, as a flat array of
+ * readers already bound to where they accumulate. It is compiled whenever the
+ * page, mode or context changes so that the sampling loop just iterates over
+ * it.
+ */
+#define PLAN_MAX_STEPS	8
+
+typedef int (*gtop_plan_reader)(struct perf_device *dev, void *dst, int s);
+
+struct gtop_plan_step {
+	gtop_plan_reader read;
+	void *dst;
+};
+
+struct gtop_plan {
+	struct gtop_plan_step steps[PLAN_MAX_STEPS];
+	uint8_t nr_steps;
+
+	/* steps need the profiler running */
+	bool profiler;
+	/* counter groups are being multiplexed */
+	bool mux;
+	/* counters are read for each context in turn */
+	bool rotate;
+	/* raw idle states are gathered and need to be counted */
+	bool idle_states;
+
+	/* what the plan has been compiled for */
+	bool compiled;
+	uint8_t page;
+	uint32_t flags;
+	uint32_t ctx;
+	/* daemon only, what subscribers asked for */
+	uint32_t groups;
 };
 
 struct gtop {
 	struct vivante_gpu_state st;
 	struct gtop_data **perf_data;
+	struct gtop_mux mux;
+	struct gtop_rotate rotate;
+	struct gtop_plan plan;
+
+	/* register holding the idle cycles, depends on the chip model */
+	uint32_t idle_reg_addr;
+
+	/* how long (ns) the last window took */
+	uint64_t window_ns;
+
+	/*
+	 * raw VIVS_HI_IDLE_STATE values of the current window, the busy count
+	 * of each module is computed from these once the window ends
+	 */
+	uint32_t *idle_words;
+	uint32_t nr_idle_words;
+	uint32_t idle_words_size;
 };
 
 enum dma_table_type {
@@ -202,6 +389,8 @@ enum dma_table_type {
 struct dma_table {
 	enum dma_table_type type;
 	const char *title;
+	/* used for machine readable output */
+	const char *name;
 	int data_size;
 	const char **data_names;
 	uint32_t *data;
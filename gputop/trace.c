@@ -0,0 +1,483 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+#define ROUND_UP(x, a)	((((x) + (a) - 1) / (a)) * (a))
+
+static int
+trace_write_all(int fd, const void *data, size_t len)
+{
+	const char *p = data;
+
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int
+trace_writer_open(struct trace_writer *w, const char *path,
+		  const struct trace_chip *chip,
+		  const struct trace_column *columns, uint32_t nr_columns)
+{
+	struct trace_header *hdr = &w->hdr;
+	size_t row_size = nr_columns * sizeof(uint64_t);
+	size_t block_size = TRACE_BLOCK_SIZE;
+	struct timespec ts;
+	char *header;
+
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+
+	if (!nr_columns) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* make sure we have enough rows in a block with lots of columns */
+	if ((block_size - sizeof(struct trace_block)) / row_size < TRACE_MIN_ROWS)
+		block_size = ROUND_UP(sizeof(struct trace_block) +
+				      TRACE_MIN_ROWS * row_size, TRACE_ALIGN);
+
+	memcpy(hdr->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	hdr->version = TRACE_VERSION;
+	hdr->byte_order = TRACE_BYTE_ORDER;
+	hdr->header_size = ROUND_UP(sizeof(*hdr) + nr_columns * sizeof(*columns),
+				    TRACE_ALIGN);
+	hdr->block_size = block_size;
+	hdr->nr_columns = nr_columns;
+	hdr->rows_per_block = (block_size - sizeof(struct trace_block)) / row_size;
+	hdr->chip = *chip;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	hdr->start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	if (posix_memalign((void **) &w->block, TRACE_ALIGN, block_size)) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(w->block, 0, block_size);
+	w->block->magic = TRACE_BLOCK_MAGIC;
+	w->values = (uint64_t *) (w->block + 1);
+
+	header = calloc(1, hdr->header_size);
+	if (!header)
+		goto err;
+
+	memcpy(header, hdr, sizeof(*hdr));
+	memcpy(header + sizeof(*hdr), columns, nr_columns * sizeof(*columns));
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (w->fd < 0)
+		goto err;
+
+	if (trace_write_all(w->fd, header, hdr->header_size) < 0)
+		goto err;
+
+	free(header);
+	return 0;
+
+err:
+	free(header);
+	free(w->block);
+	w->block = NULL;
+	if (w->fd >= 0)
+		close(w->fd);
+	w->fd = -1;
+	return -1;
+}
+
+static int
+trace_writer_flush(struct trace_writer *w)
+{
+	struct trace_block *block = w->block;
+	struct trace_index_entry *entry;
+	uint64_t seq = block->seq;
+	int err;
+
+	if (w->nr_blocks == w->index_size) {
+		uint64_t size = w->index_size ? w->index_size * 2 : 1024;
+		entry = realloc(w->index, size * sizeof(*entry));
+		if (!entry) {
+			errno = ENOMEM;
+			return -1;
+		}
+		w->index = entry;
+		w->index_size = size;
+	}
+
+	entry = &w->index[w->nr_blocks++];
+	entry->first_ns = block->first_ns;
+	entry->last_ns = block->last_ns;
+	entry->nr_rows = block->nr_rows;
+	entry->reserved = 0;
+
+	err = trace_write_all(w->fd, block, w->hdr.block_size);
+
+	/* start clean, the last block might not be full */
+	memset(block, 0, w->hdr.block_size);
+	block->magic = TRACE_BLOCK_MAGIC;
+	block->seq = seq + 1;
+
+	return err;
+}
+
+int
+trace_writer_append(struct trace_writer *w, const uint64_t *row)
+{
+	struct trace_block *block = w->block;
+	uint32_t rows = w->hdr.rows_per_block;
+	uint32_t r = block->nr_rows;
+
+	for (uint32_t c = 0; c < w->hdr.nr_columns; c++)
+		w->values[(size_t) c * rows + r] = row[c];
+
+	if (r == 0)
+		block->first_ns = row[TRACE_COL_TIMESTAMP];
+	block->last_ns = row[TRACE_COL_TIMESTAMP];
+	block->nr_rows++;
+
+	if (block->nr_rows == rows)
+		return trace_writer_flush(w);
+
+	return 0;
+}
+
+int
+trace_writer_set_start(struct trace_writer *w, uint64_t start_ns)
+{
+	off_t offset = offsetof(struct trace_header, start_ns);
+
+	w->hdr.start_ns = start_ns;
+
+	if (pwrite(w->fd, &start_ns, sizeof(start_ns), offset) != sizeof(start_ns))
+		return -1;
+
+	return 0;
+}
+
+int
+trace_writer_close(struct trace_writer *w)
+{
+	int err = 0;
+
+	if (w->fd < 0)
+		return 0;
+
+	if (w->block->nr_rows)
+		err = trace_writer_flush(w);
+
+	if (!err) {
+		struct trace_footer footer = {
+			.magic = TRACE_INDEX_MAGIC,
+			.nr_blocks = w->nr_blocks,
+			.index_offset = w->hdr.header_size +
+				w->nr_blocks * w->hdr.block_size,
+		};
+
+		err = trace_write_all(w->fd, w->index,
+				      w->nr_blocks * sizeof(*w->index));
+		if (!err)
+			err = trace_write_all(w->fd, &footer, sizeof(footer));
+	}
+
+	if (close(w->fd) < 0)
+		err = -1;
+	w->fd = -1;
+
+	free(w->block);
+	w->block = NULL;
+	free(w->index);
+	w->index = NULL;
+
+	return err;
+}
+
+/*
+ * use the index from the footer if it's there and sane
+ */
+static bool
+trace_reader_map_index(struct trace_reader *r)
+{
+	const struct trace_header *hdr = &r->hdr;
+	struct trace_footer footer;
+	uint64_t end;
+
+	if (r->size < hdr->header_size + sizeof(footer))
+		return false;
+
+	memcpy(&footer, r->map + r->size - sizeof(footer), sizeof(footer));
+	if (footer.magic != TRACE_INDEX_MAGIC)
+		return false;
+
+	end = footer.index_offset + footer.nr_blocks * sizeof(struct trace_index_entry);
+	if (footer.index_offset != hdr->header_size + footer.nr_blocks * hdr->block_size ||
+	    end + sizeof(footer) != r->size)
+		return false;
+
+	r->index = (const struct trace_index_entry *) (r->map + footer.index_offset);
+	r->nr_blocks = footer.nr_blocks;
+	return true;
+}
+
+/*
+ * no index, build it out of the headers of the blocks
+ */
+static int
+trace_reader_rebuild_index(struct trace_reader *r)
+{
+	const struct trace_header *hdr = &r->hdr;
+	struct trace_index_entry *index;
+	uint64_t nr = (r->size - hdr->header_size) / hdr->block_size;
+	uint64_t b;
+
+	index = calloc(nr ? nr : 1, sizeof(*index));
+	if (!index)
+		return -1;
+
+	for (b = 0; b < nr; b++) {
+		const struct trace_block *block = (const struct trace_block *)
+			(r->map + hdr->header_size + b * hdr->block_size);
+
+		/* whatever comes after the last good block is garbage */
+		if (block->magic != TRACE_BLOCK_MAGIC ||
+		    block->nr_rows > hdr->rows_per_block)
+			break;
+
+		index[b].first_ns = block->first_ns;
+		index[b].last_ns = block->last_ns;
+		index[b].nr_rows = block->nr_rows;
+	}
+
+	r->index = index;
+	r->nr_blocks = b;
+	r->index_rebuilt = true;
+	return 0;
+}
+
+int
+trace_reader_open(struct trace_reader *r, const char *path)
+{
+	struct trace_header *hdr = &r->hdr;
+	struct stat st;
+	size_t row_size;
+	void *map;
+	int fd;
+
+	memset(r, 0, sizeof(*r));
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	r->map = map;
+	r->size = st.st_size;
+
+	memcpy(hdr, r->map, sizeof(*hdr));
+
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) ||
+	    hdr->version < 1 || hdr->version > TRACE_VERSION ||
+	    hdr->byte_order != TRACE_BYTE_ORDER)
+		goto err_format;
+
+	row_size = hdr->nr_columns * sizeof(uint64_t);
+	if (!hdr->nr_columns || hdr->nr_columns < TRACE_COL_STD_NO ||
+	    hdr->header_size < sizeof(*hdr) + hdr->nr_columns * sizeof(struct trace_column) ||
+	    hdr->header_size % TRACE_ALIGN || hdr->header_size > r->size ||
+	    hdr->block_size < sizeof(struct trace_block) + hdr->rows_per_block * row_size ||
+	    hdr->block_size % TRACE_ALIGN || !hdr->rows_per_block)
+		goto err_format;
+
+	r->columns = calloc(hdr->nr_columns, sizeof(struct trace_column));
+	if (!r->columns)
+		goto err;
+
+	memcpy(r->columns, r->map + sizeof(*hdr),
+	       hdr->nr_columns * sizeof(struct trace_column));
+	for (uint32_t c = 0; c < hdr->nr_columns; c++) {
+		r->columns[c].name[TRACE_NAME_LEN - 1] = '\0';
+		r->columns[c].desc[TRACE_DESC_LEN - 1] = '\0';
+	}
+
+	if (!trace_reader_map_index(r) && trace_reader_rebuild_index(r) < 0)
+		goto err;
+
+	return 0;
+
+err_format:
+	errno = EINVAL;
+err:
+	trace_reader_close(r);
+	return -1;
+}
+
+int
+trace_reader_block(struct trace_reader *r, uint64_t nr)
+{
+	const struct trace_block *block;
+
+	if (nr >= r->nr_blocks) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	block = (const struct trace_block *)
+		(r->map + r->hdr.header_size + nr * r->hdr.block_size);
+
+	if (block->magic != TRACE_BLOCK_MAGIC ||
+	    block->nr_rows > r->hdr.rows_per_block) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	r->block = block;
+	r->values = (const uint64_t *) (block + 1);
+	return 0;
+}
+
+uint64_t
+trace_reader_seek(const struct trace_reader *r, uint64_t ns)
+{
+	uint64_t lo = 0, hi = r->nr_blocks;
+
+	/* blocks are in time order, find the first one ending at or after ns */
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (r->index[mid].last_ns < ns)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+void
+trace_reader_close(struct trace_reader *r)
+{
+	if (r->map)
+		munmap((void *) r->map, r->size);
+	r->map = NULL;
+
+	if (r->index_rebuilt)
+		free((void *) r->index);
+	r->index = NULL;
+
+	free(r->columns);
+	r->columns = NULL;
+}
+
+int
+trace_parse_time(const char *str, struct trace_time *t)
+{
+	char *end;
+	double secs;
+
+	t->absolute = (*str == '@');
+	if (t->absolute)
+		str++;
+
+	errno = 0;
+	secs = strtod(str, &end);
+	if (errno || end == str || *end || secs < 0)
+		return -1;
+
+	t->ns = (uint64_t) (secs * 1000000000.0);
+	t->set = true;
+	return 0;
+}
+
+uint64_t
+trace_time_ns(const struct trace_reader *r, const struct trace_time *t,
+	      uint64_t def)
+{
+	if (!t->set)
+		return def;
+
+	return t->absolute ? t->ns : r->hdr.start_ns + t->ns;
+}
+
+const char *
+trace_group_name(uint32_t group)
+{
+	static const char *names[] = {
+		[TRACE_GROUP_WINDOW]	= "window",
+		[TRACE_GROUP_PART1]	= "part1",
+		[TRACE_GROUP_PART2]	= "part2",
+		[TRACE_GROUP_OCCUPANCY]	= "occupancy",
+		[TRACE_GROUP_DMA]	= "dma",
+		[TRACE_GROUP_MEMORY]	= "memory",
+	};
+
+	if (group >= sizeof(names) / sizeof(names[0]))
+		return "unknown";
+
+	return names[group];
+}
+
+int
+trace_find_column(const struct trace_header *hdr,
+		  const struct trace_column *columns,
+		  uint32_t group, uint32_t id)
+{
+	for (uint32_t c = 0; c < hdr->nr_columns; c++)
+		if (columns[c].group == group && columns[c].id == id)
+			return c;
+
+	return -1;
+}
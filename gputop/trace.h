@@ -0,0 +1,322 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_TRACE_H
+#define __GPUTOP_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Trace file layout, all integers in host byte order:
+ *
+ * 	struct trace_header
+ * 	struct trace_column		x nr_columns
+ * 	padding up to header_size
+ * 	block				x N, each block_size bytes
+ * 	struct trace_index_entry	x N
+ * 	struct trace_footer
+ *
+ * Blocks are column-major: after struct trace_block come rows_per_block
+ * values of the first column, then rows_per_block values of the second one
+ * and so on. Only the last block might have less than rows_per_block rows.
+ *
+ * The index is written when the recording ends, a trace without it (version
+ * 1, or the recording has been interrupted) has its index rebuilt out of the
+ * block headers.
+ */
+#define TRACE_MAGIC		"GTOPTRC"
+#define TRACE_VERSION		2
+#define TRACE_BYTE_ORDER	0x01020304
+
+#define TRACE_BLOCK_MAGIC	0x4b425447	/* GTBK */
+#define TRACE_INDEX_MAGIC	0x58495447	/* GTIX */
+
+/* header and blocks are aligned to this, blocks are a multiple of it */
+#define TRACE_ALIGN		4096
+#define TRACE_BLOCK_SIZE	(64 * 1024)
+/* a block holds at least as many rows, otherwise it is made bigger */
+#define TRACE_MIN_ROWS		16
+
+#define TRACE_NAME_LEN		64
+#define TRACE_DESC_LEN		128
+
+/* every trace starts with these columns */
+enum trace_std_column {
+	TRACE_COL_TIMESTAMP,	/* CLOCK_REALTIME, ns, end of the window */
+	TRACE_COL_FLAGS,	/* TRACE_FLAG_* */
+	TRACE_COL_WINDOW,	/* ns the window took */
+	TRACE_COL_SAMPLES,	/* samples taken in the window */
+	TRACE_COL_STD_NO,
+};
+
+#define TRACE_FLAG_MARKER	(1 << 0)
+
+/* what a column holds, id being the index inside the group */
+enum trace_group {
+	TRACE_GROUP_WINDOW,
+	/* raw events, time_enabled and time_running first */
+	TRACE_GROUP_PART1,
+	TRACE_GROUP_PART2,
+	/* busy samples of each module */
+	TRACE_GROUP_OCCUPANCY,
+	/* samples spent in each state, dma_table ids in the upper 16 bits */
+	TRACE_GROUP_DMA,
+	/* KiB allocated by all GPU clients, refreshed at most once a second */
+	TRACE_GROUP_MEMORY,
+};
+
+enum trace_memory {
+	TRACE_MEM_TOTAL,
+	TRACE_MEM_RESERVED,
+	TRACE_MEM_CONTIGUOUS,
+	TRACE_MEM_VIRTUAL,
+	TRACE_MEM_NON_PAGED,
+	TRACE_MEM_NO,
+};
+
+/* ids of the per group timing columns of TRACE_GROUP_PART{1,2} */
+#define TRACE_ID_TIME_ENABLED	0xfffffffe
+#define TRACE_ID_TIME_RUNNING	0xffffffff
+
+struct trace_column {
+	char name[TRACE_NAME_LEN];
+	char desc[TRACE_DESC_LEN];
+	uint32_t group;
+	uint32_t id;
+};
+
+struct trace_chip {
+	uint32_t model;
+	uint32_t revision;
+	/* 3D, 2D, VG */
+	uint32_t cores[3];
+
+	int32_t drv_major;
+	int32_t drv_minor;
+	int32_t drv_patch;
+	int32_t drv_build;
+};
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	uint32_t header_size;
+	uint32_t block_size;
+	uint32_t nr_columns;
+	uint32_t rows_per_block;
+
+	/* CLOCK_REALTIME when the recording started */
+	uint64_t start_ns;
+
+	struct trace_chip chip;
+};
+
+struct trace_block {
+	uint32_t magic;
+	uint32_t nr_rows;
+	uint64_t seq;
+
+	/* timestamps of the first and the last row */
+	uint64_t first_ns;
+	uint64_t last_ns;
+};
+
+struct trace_index_entry {
+	uint64_t first_ns;
+	uint64_t last_ns;
+	uint32_t nr_rows;
+	uint32_t reserved;
+};
+
+struct trace_footer {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t nr_blocks;
+	/* where the index starts */
+	uint64_t index_offset;
+};
+
+/**
+ * trace_writer:
+ *
+ * Rows are scattered into the current block which is written out with one
+ * write() once full.
+ */
+struct trace_writer {
+	int fd;
+	struct trace_header hdr;
+
+	/* current block, block_size bytes aligned to TRACE_ALIGN */
+	struct trace_block *block;
+	uint64_t *values;
+
+	/* blocks written so far */
+	struct trace_index_entry *index;
+	uint64_t nr_blocks;
+	uint64_t index_size;
+};
+
+/**
+ * trace_writer_open:
+ *
+ * Creates path and writes the header. Returns -1 and sets errno on failure.
+ */
+int
+trace_writer_open(struct trace_writer *w, const char *path,
+		  const struct trace_chip *chip,
+		  const struct trace_column *columns, uint32_t nr_columns);
+
+/**
+ * trace_writer_append:
+ *
+ * row has nr_columns values. Returns -1 if writing a full block failed.
+ */
+int
+trace_writer_append(struct trace_writer *w, const uint64_t *row);
+
+/**
+ * trace_writer_set_start:
+ *
+ * Rows written out of a buffer start before the writer got opened, have the
+ * trace start at start_ns instead.
+ */
+int
+trace_writer_set_start(struct trace_writer *w, uint64_t start_ns);
+
+/**
+ * trace_writer_close:
+ *
+ * Writes out what's left in the current block, then the index.
+ */
+int
+trace_writer_close(struct trace_writer *w);
+
+/**
+ * trace_reader:
+ *
+ * The whole trace is mapped, blocks are looked up with the index so that
+ * only the blocks of interest are ever touched.
+ */
+struct trace_reader {
+	const char *map;
+	size_t size;
+
+	struct trace_header hdr;
+	struct trace_column *columns;
+
+	const struct trace_index_entry *index;
+	uint64_t nr_blocks;
+	/* the index has been rebuilt, not mapped */
+	bool index_rebuilt;
+
+	/* current block */
+	const struct trace_block *block;
+	const uint64_t *values;
+};
+
+/**
+ * trace_reader_open:
+ *
+ * Returns -1 if path can't be read or is not a trace we understand.
+ */
+int
+trace_reader_open(struct trace_reader *r, const char *path);
+
+/**
+ * trace_reader_block:
+ *
+ * Makes block nr the current one. Returns -1 if the block is corrupted.
+ */
+int
+trace_reader_block(struct trace_reader *r, uint64_t nr);
+
+/**
+ * trace_reader_seek:
+ *
+ * Returns the first block holding rows at or after ns, or nr_blocks if there
+ * are none.
+ */
+uint64_t
+trace_reader_seek(const struct trace_reader *r, uint64_t ns);
+
+void
+trace_reader_close(struct trace_reader *r);
+
+static inline uint64_t
+trace_value(const struct trace_reader *r, uint32_t col, uint32_t row)
+{
+	return r->values[(size_t) col * r->hdr.rows_per_block + row];
+}
+
+/**
+ * trace_time:
+ *
+ * A point in time given on the command line: seconds (with decimals) since
+ * the start of the recording, or since the Epoch when prefixed with '@'.
+ */
+struct trace_time {
+	bool set;
+	bool absolute;
+	uint64_t ns;
+};
+
+/**
+ * trace_parse_time:
+ *
+ * Returns -1 if str is not a valid time.
+ */
+int
+trace_parse_time(const char *str, struct trace_time *t);
+
+/**
+ * trace_time_ns:
+ *
+ * t as CLOCK_REALTIME ns, def if t has not been set.
+ */
+uint64_t
+trace_time_ns(const struct trace_reader *r, const struct trace_time *t,
+	      uint64_t def);
+
+/**
+ * trace_group_name:
+ *
+ * Lower case name of a trace_group, as used in reports and expressions.
+ */
+const char *
+trace_group_name(uint32_t group);
+
+/**
+ * trace_find_column:
+ *
+ * Returns the index of the column with group and id, or -1.
+ */
+int
+trace_find_column(const struct trace_header *hdr,
+		  const struct trace_column *columns,
+		  uint32_t group, uint32_t id);
+
+#endif
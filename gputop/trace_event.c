@@ -0,0 +1,114 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "trace_event.h"
+
+static void
+trace_event_begin(struct trace_event_writer *w)
+{
+	buf_puts(&w->buf, w->items ? ",\n" : "\n");
+	w->items = true;
+}
+
+int
+trace_event_open(struct trace_event_writer *w, const char *path,
+		 const char *process)
+{
+	memset(w, 0, sizeof(*w));
+
+	if (buf_init(&w->buf, 2 * TRACE_EVENT_FLUSH) < 0)
+		return -1;
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0) {
+		buf_free(&w->buf);
+		return -1;
+	}
+
+	w->pid = getpid();
+
+	buf_putc(&w->buf, '[');
+
+	/* what the tracks are grouped under */
+	trace_event_begin(w);
+	buf_printf(&w->buf, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIu32
+		   ",\"args\":{\"name\":", w->pid);
+	output_json_str(&w->buf, process);
+	buf_puts(&w->buf, "}}");
+
+	return trace_event_flush(w, true);
+}
+
+void
+trace_event_counter(struct trace_event_writer *w, uint64_t ts_ns,
+		    const char *cat, const char *name, const char *unit,
+		    double value)
+{
+	char track[128];
+
+	snprintf(track, sizeof(track), "%s/%s", cat, name);
+
+	trace_event_begin(w);
+	buf_puts(&w->buf, "{\"name\":");
+	output_json_str(&w->buf, track);
+	buf_puts(&w->buf, ",\"cat\":");
+	output_json_str(&w->buf, cat);
+	/* microseconds, keeping the nanoseconds */
+	buf_printf(&w->buf, ",\"ph\":\"C\",\"ts\":%" PRIu64 ".%03" PRIu64
+		   ",\"pid\":%" PRIu32 ",\"args\":{",
+		   ts_ns / 1000, ts_ns % 1000, w->pid);
+	output_json_str(&w->buf, unit);
+	buf_printf(&w->buf, ":%.15g}}", value);
+}
+
+int
+trace_event_flush(struct trace_event_writer *w, bool force)
+{
+	if (!force && w->buf.len < TRACE_EVENT_FLUSH)
+		return 0;
+
+	return buf_write(&w->buf, w->fd) < 0 ? -1 : 0;
+}
+
+int
+trace_event_close(struct trace_event_writer *w)
+{
+	int err;
+
+	buf_puts(&w->buf, "\n]\n");
+	err = trace_event_flush(w, true);
+
+	if (close(w->fd) < 0)
+		err = -1;
+
+	buf_free(&w->buf);
+	return err;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GPUTOP_TRACE_EVENT_H
+#define __GPUTOP_TRACE_EVENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+/* events are written out in chunks of at least that much */
+#define TRACE_EVENT_FLUSH	(64 * 1024)
+
+/**
+ * trace_event_writer:
+ *
+ * Streams counter samples in the Chrome JSON trace event format, which both
+ * Perfetto and chrome://tracing load. Each counter is a track of its own,
+ * named after its category and name, with timestamps in CLOCK_MONOTONIC like
+ * the kernel traces of the same boards.
+ *
+ * The JSON array form is used: it doesn't need to be terminated, a capture
+ * cut short still loads.
+ */
+struct trace_event_writer {
+	int fd;
+	struct gtop_buf buf;
+	uint32_t pid;
+	/* if an event has been written already */
+	bool items;
+};
+
+/**
+ * trace_event_open:
+ *
+ * Create path, naming the process the tracks show up under. Returns -1 and
+ * sets errno on failure.
+ */
+int
+trace_event_open(struct trace_event_writer *w, const char *path,
+		 const char *process);
+
+/**
+ * trace_event_counter:
+ *
+ * value of the track cat/name from ts_ns on, unit naming the series.
+ */
+void
+trace_event_counter(struct trace_event_writer *w, uint64_t ts_ns,
+		    const char *cat, const char *name, const char *unit,
+		    double value);
+
+/**
+ * trace_event_flush:
+ *
+ * Write the events out once TRACE_EVENT_FLUSH of them are buffered, or right
+ * away if force is set. Returns -1 and sets errno on failure.
+ */
+int
+trace_event_flush(struct trace_event_writer *w, bool force);
+
+/**
+ * trace_event_close:
+ *
+ * Flush and terminate the array.
+ */
+int
+trace_event_close(struct trace_event_writer *w);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright NXP 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * fmt_bench: fmt.c against the stdio formatting pages used to go through.
+ *
+ * Build with -DENABLE_BENCH=ON and run as fmt_bench [iterations].
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "fmt.h"
+
+#define NSEC_PER_SEC	(1000000000ULL)
+
+static uint64_t
+bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * counter values look like this, from a few to billions of events
+ */
+static uint64_t
+bench_value(uint64_t i)
+{
+	uint64_t x = i * 0x9e3779b97f4a7c15ULL;
+
+	return (x >> 20) >> ((x & 31) + 8);
+}
+
+/* what the counters pages did before fmt.c */
+static void
+bench_format_number(char *num, size_t num_len, uint64_t sample)
+{
+	char tmp[100];
+	size_t len;
+
+	int groups, group_size;
+	size_t in_ptr, out_ptr;
+	int i, j;
+
+	snprintf(tmp, sizeof(tmp), "%llu", (unsigned long long) sample);
+	len = strlen(tmp);
+
+	groups = (len + 2) / 3;
+	group_size = len - (groups - 1) * 3;
+	in_ptr = out_ptr = 0;
+
+	num_len -= 1;
+
+	for (i = 0; i < groups && out_ptr < num_len; i++) {
+		for (j = 0; j < group_size && out_ptr < num_len; j++)
+			num[out_ptr++] = tmp[in_ptr++];
+		if (i != (groups - 1) && out_ptr < num_len)
+			num[out_ptr++] = ',';
+
+		group_size = 3;
+	}
+
+	num[out_ptr] = '\0';
+}
+
+static void
+bench_report(const char *name, uint64_t stdio_ns, uint64_t fmt_ns, uint64_t n)
+{
+	printf("%-10s stdio %7.2f ns  fmt %7.2f ns  x%.1f\n", name,
+	       (double) stdio_ns / n, (double) fmt_ns / n,
+	       fmt_ns ? (double) stdio_ns / fmt_ns : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t n = argc > 1 ? strtoull(argv[1], NULL, 0) : 2000000;
+	struct gtop_buf a, b;
+	uint64_t i, start, stdio_ns, fmt_ns;
+	char num[100];
+
+	if (!n || buf_init(&a, 1 << 16) < 0 || buf_init(&b, 1 << 16) < 0) {
+		fprintf(stderr, "usage: fmt_bench [iterations]\n");
+		return EXIT_FAILURE;
+	}
+
+	/* same output first */
+	for (i = 0; i < 100000; i++) {
+		uint64_t v = bench_value(i);
+
+		buf_reset(&a);
+		buf_reset(&b);
+
+		bench_format_number(num, sizeof(num), v);
+		buf_printf(&a, "%14s|%" PRIu64 "|%.2f", num, v, (double) (int64_t) (v % 20000) / 100.0);
+		fmt_buf_u64(&b, v, 14, true);
+		buf_putc(&b, '|');
+		fmt_buf_u64(&b, v, 0, false);
+		buf_putc(&b, '|');
+		fmt_buf_fixed2(&b, v % 20000, 0);
+
+		if (a.len != b.len || memcmp(a.data, b.data, a.len)) {
+			fprintf(stderr, "%.*s differs from %.*s\n",
+				(int) b.len, b.data, (int) a.len, a.data);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* counters: grouped and right aligned */
+	buf_reset(&a);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		bench_format_number(num, sizeof(num), bench_value(i));
+		buf_printf(&a, "%14.14s", num);
+		if (a.len > 60000)
+			buf_reset(&a);
+	}
+	stdio_ns = bench_ns() - start;
+
+	buf_reset(&b);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		fmt_buf_u64(&b, bench_value(i), 14, true);
+		if (b.len > 60000)
+			buf_reset(&b);
+	}
+	fmt_ns = bench_ns() - start;
+	bench_report("grouped", stdio_ns, fmt_ns, n);
+
+	/* clients and vidmem: plain and aligned */
+	buf_reset(&a);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		buf_printf(&a, "%10" PRIu64, bench_value(i));
+		if (a.len > 60000)
+			buf_reset(&a);
+	}
+	stdio_ns = bench_ns() - start;
+
+	buf_reset(&b);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		fmt_buf_u64(&b, bench_value(i), 10, false);
+		if (b.len > 60000)
+			buf_reset(&b);
+	}
+	fmt_ns = bench_ns() - start;
+	bench_report("plain", stdio_ns, fmt_ns, n);
+
+	/* occupancy and DMA: percentage of the samples */
+	buf_reset(&a);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		buf_printf(&a, "%6.2f", 100.0 * (double) (i % 1001) / 1000.0);
+		if (a.len > 60000)
+			buf_reset(&a);
+	}
+	stdio_ns = bench_ns() - start;
+
+	buf_reset(&b);
+	start = bench_ns();
+	for (i = 0; i < n; i++) {
+		fmt_buf_fixed2(&b, fmt_percent_of(i % 1001, 1000), 6);
+		if (b.len > 60000)
+			buf_reset(&b);
+	}
+	fmt_ns = bench_ns() - start;
+	bench_report("percent", stdio_ns, fmt_ns, n);
+
+	buf_free(&a);
+	buf_free(&b);
+
+	return EXIT_SUCCESS;
+}